@@ -0,0 +1,578 @@
+/* * * * * * * * *
+ * Benchmark driver: sweeps table types, initial sizes (or bucket sizes) and
+ * operation counts in-process, and writes one CSV of insert and lookup
+ * timings with 95% confidence intervals over repeated trials, the memory the
+ * table holds once built (see memacct.h), and hardware counter readings (see
+ * perfctr.h) per operation where available
+ *
+ * usage:
+ *   make bench
+ *   ./bench [-t type]... [-s sizes] [-n counts] [-l ratio] [-r trials]
+ *           [-w warmups] [-S seed] [-R] [-F rate] [-d ways] [-H pages]
+ *           > results.csv
+ *       -t type:   table type to benchmark, may be repeated (default: linear,
+ *                  cuckoo, xtndbln, xuckoo and xuckoon). linear-spec and
+ *                  xtndbln-spec run the compile time specialised tables of
+ *                  tables/spectbl.h in place of linear and xtndbln
+ *                  (xtndbln-spec only with SPEC_BUCKETSIZE keys per bucket)
+ *       -s sizes:  initial sizes to sweep, as "a,b,c" or "first:step:last"
+ *                  (default: the sizes the old gendata.sh scripts used)
+ *       -n counts: insert counts to sweep, same syntax
+ *                  (default: 1000:1000:100000)
+ *       -l ratio:  lookups per insert (default: 1 for linear, else 2)
+ *       -r trials: timed trials per configuration (default: 5)
+ *       -w warmups: untimed trials run first, to warm caches (default: 1)
+ *       -S seed:   seed for key generation (default: 1)
+ *       -R:        reserve room for all inserts before making them (see
+ *                  hash_table_reserve), timed as part of the inserts
+ *       -F rate:   keep a filter with false positive rate 'rate' in front of
+ *                  each table (see hash_table_add_filter; not for the -spec
+ *                  types), its memory counted with the table's
+ *       -d ways:   inner tables each key of a cuckoo, xuckoo or xuckoon table
+ *                  may be in, 2 to 4 (see new_hash_map_ways; default: 2).
+ *                  other types only take 2
+ *       -H pages:  back the large arrays of each table with "thp"
+ *                  (transparent) or "huge" (reserved) huge pages, or
+ *                  "default" (see hash_table_set_pages; linear, cuckoo,
+ *                  xtndbln, xuckoo and xuckoon only)
+ *
+ * Keys are drawn as cmdgen.c draws them: inserts uniformly from
+ * [0, 100 * ninserts], lookups half from the inserted keys and half fresh.
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "inthash.h"
+#include "hashtbl.h"
+#include "perfctr.h"
+#include "tables/spectbl.h"
+
+#define MAX_TYPES 8
+#define MAX_SWEEP 1024
+#define MAX_TRIALS 256
+
+// default sweeps, matching the old gendata.sh scripts
+#define DEFAULT_COUNTS "1000:1000:100000"
+#define DEFAULT_TRIALS 5
+#define DEFAULT_WARMUPS 1
+
+// keys per bucket of xtndbln-spec, fixed when it is compiled
+#define SPEC_BUCKETSIZE 4
+#define STR(x) #x
+#define XSTR(x) STR(x)
+
+// the specialised tables, keyed and hashed as the dispatched ones they mirror
+DEFINE_LINEAR_TABLE(speclinear, int64, h1, 1)
+DEFINE_XTNDBL_TABLE(specxtndbln, int64, h1, SPEC_BUCKETSIZE)
+
+// which specialised table, if any, a type name asks for
+typedef enum spec { NOSPEC, SPEC_LINEAR, SPEC_XTNDBLN } Spec;
+
+// two-sided 95% student t quantiles for 1..30 degrees of freedom
+static const double t95[] = {
+	12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+	2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+	2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+};
+
+// a list of integers to sweep over
+typedef struct sweep {
+	int n;
+	int values[MAX_SWEEP];
+} Sweep;
+
+// benchmark configuration from the command line
+typedef struct options {
+	char *types[MAX_TYPES];
+	int ntypes;
+	char *sizes;		// NULL for the per-type default
+	char *counts;
+	double ratio;		// lookups per insert, <= 0 for the per-type default
+	int trials;
+	int warmups;
+	int64 seed;
+	bool reserve;		// presize each table for its inserts
+	double filter;		// false positive rate of a filter before lookups, or 0
+	int ways;			// inner tables of the cuckoo types
+	PagePolicy pages;	// how to back each table's large arrays
+} Options;
+
+// timings of one trial, in nanoseconds, and counter readings
+typedef struct trial {
+	double insert_ns;
+	double lookup_ns;
+	PerfSample insert_perf;
+	PerfSample lookup_perf;
+	Memory memory;		// held by the table once all keys are inserted
+	int nkeys;			// distinct keys in the table at that point
+} Trial;
+
+// counter totals over the trials of one configuration
+typedef struct perf_totals {
+	int ntrials[PERF_NCOUNTERS];	// trials in which the counter was valid
+	double total[PERF_NCOUNTERS];	// events per op, summed over those trials
+} PerfTotals;
+
+// counters for the benchmarking thread, opened once
+static PerfCounters *counters;
+
+/*************************************************************************/
+
+void printusageexit(char *exe) {
+	fprintf(stderr, "usage: %s [-t type]... [-s sizes] [-n counts] "
+		"[-l ratio] [-r trials] [-w warmups] [-S seed] [-R] [-F rate] "
+		"[-d ways] [-H pages] > results.csv\n",
+		exe);
+	fprintf(stderr, " sizes and counts are \"a,b,c\" or \"first:step:last\"\n");
+	exit(1);
+}
+
+/* xorshift64* generator, so runs are repeatable and cheap */
+static int64 next_random(int64 *state) {
+	*state ^= *state >> 12;
+	*state ^= *state << 25;
+	*state ^= *state >> 27;
+	return *state * 2685821657736338717ULL;
+}
+
+/* Parse "a,b,c" or "first:step:last" into a sweep */
+static bool parse_sweep(const char *str, Sweep *sweep) {
+	int first, step, last;
+	sweep->n = 0;
+
+	if (sscanf(str, "%d:%d:%d", &first, &step, &last) == 3) {
+		if (step <= 0) {
+			return false;
+		}
+		for (; first <= last && sweep->n < MAX_SWEEP; first += step) {
+			sweep->values[sweep->n++] = first;
+		}
+		return sweep->n > 0;
+	}
+
+	while (*str && sweep->n < MAX_SWEEP) {
+		char *end;
+		long value = strtol(str, &end, 10);
+		if (end == str) {
+			return false;
+		}
+		sweep->values[sweep->n++] = (int)value;
+		str = (*end == ',') ? end + 1 : end;
+	}
+	return sweep->n > 0;
+}
+
+/* Initial sizes swept by default for each table type */
+static const char *default_sizes(TableType type) {
+	switch (type) {
+		case LINEAR:
+		case CUCKOO:
+		case LINEAR32:
+		case CUCKOO32:
+		case HOPSCOTCH:
+			return "2,3,5,7,9,11,13,15,17,19,21,23,25,27,29,31";
+		case XTNDBLN:
+		case LINHASH:
+			return "1:1:30";
+		case XUCKOON:
+			return "1:1:10";
+		default:
+			return "1";
+	}
+}
+
+/* Nanoseconds elapsed since 'start' */
+static double elapsed_ns(struct timespec *start) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - start->tv_sec) * 1e9 + (now.tv_nsec - start->tv_nsec);
+}
+
+/* The specialised table named 'str', and the type it mirrors */
+static Spec strtospec(const char *str, TableType *type) {
+	if (strcmp(str, "linear-spec") == 0) {
+		*type = LINEAR;
+		return SPEC_LINEAR;
+	}
+	if (strcmp(str, "xtndbln-spec") == 0) {
+		*type = XTNDBLN;
+		return SPEC_XTNDBLN;
+	}
+	return NOSPEC;
+}
+
+/* Define run_<name>_trial, which runs a trial as run_trial does on the
+ * specialised table 'name', calling its functions directly */
+#define DEFINE_SPEC_TRIAL(name)												\
+static Trial run_##name##_trial(int size, bool reserve, int64 *inserts,		\
+		int ninserts, int64 *lookups, int nlookups, bool *results) {		\
+	Trial trial;															\
+	struct timespec start;													\
+	name##_table *table = name##_new(size);									\
+	int i;																	\
+																			\
+	perf_counters_start(counters);											\
+	clock_gettime(CLOCK_MONOTONIC, &start);									\
+	if (reserve && !name##_reserve(table, ninserts)) {						\
+		fprintf(stderr, "could not reserve room for %d keys\n", ninserts);	\
+		exit(1);															\
+	}																		\
+	for (i = 0; i < ninserts; i++) {										\
+		results[i] = name##_insert(table, inserts[i]);						\
+	}																		\
+	trial.insert_ns = elapsed_ns(&start);									\
+	perf_counters_stop(counters, &trial.insert_perf);						\
+																			\
+	name##_memory(table, &trial.memory);									\
+	trial.nkeys = name##_nkeys(table);										\
+																			\
+	perf_counters_start(counters);											\
+	clock_gettime(CLOCK_MONOTONIC, &start);									\
+	for (i = 0; i < nlookups; i++) {										\
+		results[i] = name##_lookup(table, lookups[i]);						\
+	}																		\
+	trial.lookup_ns = elapsed_ns(&start);									\
+	perf_counters_stop(counters, &trial.lookup_perf);						\
+																			\
+	name##_free(table);														\
+	return trial;															\
+}
+
+DEFINE_SPEC_TRIAL(speclinear)
+DEFINE_SPEC_TRIAL(specxtndbln)
+
+/* Run one trial: build a table from 'inserts' (reserving room for them
+ * first if 'reserve', behind a filter of false positive rate 'filter' if not
+ * 0), then perform 'lookups'. cuckoo types have 'ways' inner tables, and
+ * the table's arrays are backed as 'pages' asks. if 'spec', the specialised
+ * table is built in place of one of type 'type' */
+static Trial run_trial(TableType type, Spec spec, int size, bool reserve,
+		double filter, int ways, PagePolicy pages, int64 *inserts,
+		int ninserts, int64 *lookups, int nlookups, bool *results) {
+	switch (spec) {
+		case SPEC_LINEAR:
+			return run_speclinear_trial(size, reserve, inserts, ninserts,
+				lookups, nlookups, results);
+		case SPEC_XTNDBLN:
+			return run_specxtndbln_trial(size, reserve, inserts, ninserts,
+				lookups, nlookups, results);
+		default:
+			break;
+	}
+
+	Trial trial;
+	struct timespec start;
+	HashTable *table = new_hash_map_ways(type, size, 0, ways);
+	if (!table) {
+		fprintf(stderr, "could not create a %s table of size %d with %d "
+			"ways\n", typetostr(type), size, ways);
+		exit(1);
+	}
+	if (filter && !hash_table_add_filter(table, filter)) {
+		fprintf(stderr, "could not add a filter of rate %g\n", filter);
+		exit(1);
+	}
+	if (pages != PAGES_DEFAULT && !hash_table_set_pages(table, pages)) {
+		fprintf(stderr, "could not back a %s table with %s pages\n",
+			typetostr(type), pagestostr(pages));
+		exit(1);
+	}
+
+	perf_counters_start(counters);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (reserve && !hash_table_reserve(table, ninserts)) {
+		fprintf(stderr, "could not reserve room for %d keys\n", ninserts);
+		exit(1);
+	}
+	hash_table_insert_batch(table, inserts, ninserts, results);
+	trial.insert_ns = elapsed_ns(&start);
+	perf_counters_stop(counters, &trial.insert_perf);
+
+	hash_table_memory(table, &trial.memory);
+	trial.nkeys = 0;
+	int i;
+	for (i = 0; i < ninserts; i++) {
+		trial.nkeys += results[i];
+	}
+
+	perf_counters_start(counters);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	hash_table_lookup_batch(table, lookups, nlookups, results);
+	trial.lookup_ns = elapsed_ns(&start);
+	perf_counters_stop(counters, &trial.lookup_perf);
+
+	free_hash_table(table);
+	return trial;
+}
+
+/* Draw keys for one trial as cmdgen.c does */
+static void generate_keys(int64 *state, int64 *inserts, int ninserts,
+		int64 *lookups, int nlookups) {
+	int64 max = 100 * (int64)ninserts + 1;
+	int i;
+	for (i = 0; i < ninserts; i++) {
+		inserts[i] = next_random(state) % max;
+	}
+	for (i = 0; i < nlookups; i++) {
+		if (next_random(state) % 2 && ninserts) {
+			lookups[i] = inserts[next_random(state) % ninserts];
+		} else {
+			lookups[i] = next_random(state) % max;
+		}
+	}
+}
+
+/* Mean and 95% confidence interval half-width of 'n' per-op values */
+static void summarise(double *values, int n, double *mean, double *ci) {
+	double sum = 0, sumsq = 0;
+	int i;
+	for (i = 0; i < n; i++) {
+		sum += values[i];
+	}
+	*mean = sum / n;
+	for (i = 0; i < n; i++) {
+		sumsq += (values[i] - *mean) * (values[i] - *mean);
+	}
+
+	if (n < 2) {
+		*ci = 0;
+		return;
+	}
+	double t = (n - 1 <= 30) ? t95[n - 2] : 1.96;
+	*ci = t * sqrt(sumsq / (n - 1)) / sqrt(n);
+}
+
+/* Add one trial's counts, per op, to 'totals' */
+static void add_perf(PerfTotals *totals, PerfSample *sample, int nops) {
+	int i;
+	for (i = 0; i < PERF_NCOUNTERS; i++) {
+		if (sample->valid[i] && nops) {
+			totals->ntrials[i]++;
+			totals->total[i] += (double)sample->value[i] / nops;
+		}
+	}
+}
+
+/* Print the mean of each counter per op, leaving unavailable ones empty */
+static void print_perf(PerfTotals *totals) {
+	int i;
+	for (i = 0; i < PERF_NCOUNTERS; i++) {
+		if (totals->ntrials[i]) {
+			printf(",%.3f", totals->total[i] / totals->ntrials[i]);
+		} else {
+			printf(",");
+		}
+	}
+}
+
+/* Print csv header columns for the counters of phase 'phase' */
+static void print_perf_header(const char *phase) {
+	int i;
+	for (i = 0; i < PERF_NCOUNTERS; i++) {
+		printf(",%s %s [/op]", phase, perf_counter_name(i));
+	}
+}
+
+static Options get_options(int argc, char **argv) {
+	Options options = { .ntypes = 0, .sizes = NULL, .counts = DEFAULT_COUNTS,
+		.ratio = 0, .trials = DEFAULT_TRIALS, .warmups = DEFAULT_WARMUPS,
+		.seed = 1, .reserve = false, .filter = 0, .ways = 2,
+		.pages = PAGES_DEFAULT };
+	int option;
+
+	while ((option = getopt(argc, argv, "t:s:n:l:r:w:S:RF:d:H:")) != -1) {
+		switch (option) {
+			case 't':
+				if (options.ntypes < MAX_TYPES) {
+					options.types[options.ntypes++] = optarg;
+				}
+				break;
+			case 's':
+				options.sizes = optarg;
+				break;
+			case 'n':
+				options.counts = optarg;
+				break;
+			case 'l':
+				options.ratio = atof(optarg);
+				break;
+			case 'r':
+				options.trials = atoi(optarg);
+				break;
+			case 'w':
+				options.warmups = atoi(optarg);
+				break;
+			case 'S':
+				options.seed = strtoull(optarg, NULL, 10);
+				break;
+			case 'R':
+				options.reserve = true;
+				break;
+			case 'F':
+				options.filter = atof(optarg);
+				break;
+			case 'd':
+				options.ways = atoi(optarg);
+				break;
+			case 'H':
+				options.pages = strtopages(optarg);
+				break;
+			default:
+				printusageexit(argv[0]);
+		}
+	}
+
+	if (options.ntypes == 0) {
+		char *all[] = {"linear", "cuckoo", "xtndbln", "xuckoo", "xuckoon"};
+		for (options.ntypes = 0; options.ntypes < 5; options.ntypes++) {
+			options.types[options.ntypes] = all[options.ntypes];
+		}
+	}
+	if (options.trials < 1 || options.trials > MAX_TRIALS
+			|| options.warmups < 0
+			|| options.filter < 0 || options.filter >= 1
+			|| options.ways < 2 || options.ways > 4
+			|| options.pages == NOPAGES) {
+		printusageexit(argv[0]);
+	}
+	if (options.seed == 0) {
+		options.seed = 1; // xorshift never leaves zero
+	}
+	return options;
+}
+
+/*************************************************************************/
+
+int main(int argc, char **argv) {
+	Options options = get_options(argc, argv);
+
+	Sweep counts, sizes;
+	if (!parse_sweep(options.counts, &counts)) {
+		printusageexit(argv[0]);
+	}
+
+	counters = new_perf_counters();
+
+	printf("table,initial size,reserved,filter rate,ways,pages,inserts [keys],"
+		"lookups [keys],trials,"
+		"insert mean [ns/op],insert ci95 [ns/op],"
+		"lookup mean [ns/op],lookup ci95 [ns/op],"
+		"memory [bytes],peak memory [bytes],memory per key [bytes]");
+	print_perf_header("insert");
+	print_perf_header("lookup");
+	printf("\n");
+
+	double insert_ns[MAX_TRIALS], lookup_ns[MAX_TRIALS];
+	int t, s, c, r;
+	for (t = 0; t < options.ntypes; t++) {
+		TableType type = strtotype(options.types[t]);
+		Spec spec = strtospec(options.types[t], &type);
+		if (type == NOTYPE) {
+			fprintf(stderr, "%s: unsupported table type '%s'\n", argv[0],
+				options.types[t]);
+			exit(1);
+		}
+		const char *size_list = options.sizes ? options.sizes
+			: (spec == SPEC_XTNDBLN) ? XSTR(SPEC_BUCKETSIZE)
+			: default_sizes(type);
+		if (!parse_sweep(size_list, &sizes)) {
+			printusageexit(argv[0]);
+		}
+		if (spec != NOSPEC && options.filter) {
+			fprintf(stderr, "%s: %s cannot be given a filter\n", argv[0],
+				options.types[t]);
+			exit(1);
+		}
+		if (spec != NOSPEC && options.ways != 2) {
+			fprintf(stderr, "%s: %s only has 2 ways\n", argv[0],
+				options.types[t]);
+			exit(1);
+		}
+		if (spec != NOSPEC && options.pages != PAGES_DEFAULT) {
+			fprintf(stderr, "%s: %s cannot be given huge pages\n", argv[0],
+				options.types[t]);
+			exit(1);
+		}
+		for (s = 0; spec == SPEC_XTNDBLN && s < sizes.n; s++) {
+			if (sizes.values[s] != SPEC_BUCKETSIZE) {
+				fprintf(stderr, "%s: xtndbln-spec is compiled with %d keys "
+					"per bucket\n", argv[0], SPEC_BUCKETSIZE);
+				exit(1);
+			}
+		}
+		double ratio = (options.ratio > 0) ? options.ratio
+			: (type == LINEAR ? 1 : 2);
+
+		for (c = 0; c < counts.n; c++) {
+			int ninserts = counts.values[c];
+			int nlookups = (int)(ninserts * ratio);
+			int64 *inserts = malloc(sizeof(int64) * (ninserts + 1));
+			int64 *lookups = malloc(sizeof(int64) * (nlookups + 1));
+			bool *results = malloc(sizeof(bool) *
+				((ninserts > nlookups ? ninserts : nlookups) + 1));
+
+			for (s = 0; s < sizes.n; s++) {
+				int size = sizes.values[s];
+				int64 state = options.seed;
+
+				// untimed trials first, to warm caches and the allocator
+				for (r = 0; r < options.warmups; r++) {
+					generate_keys(&state, inserts, ninserts, lookups, nlookups);
+					run_trial(type, spec, size, options.reserve,
+						options.filter, options.ways, options.pages, inserts,
+						ninserts, lookups, nlookups, results);
+				}
+
+				PerfTotals insert_perf = {{0}}, lookup_perf = {{0}};
+				double bytes = 0, peak = 0, per_key = 0;
+				for (r = 0; r < options.trials; r++) {
+					generate_keys(&state, inserts, ninserts, lookups, nlookups);
+					Trial trial = run_trial(type, spec, size, options.reserve,
+						options.filter, options.ways, options.pages, inserts,
+						ninserts, lookups, nlookups, results);
+					insert_ns[r] = ninserts ? trial.insert_ns / ninserts : 0;
+					lookup_ns[r] = nlookups ? trial.lookup_ns / nlookups : 0;
+					add_perf(&insert_perf, &trial.insert_perf, ninserts);
+					add_perf(&lookup_perf, &trial.lookup_perf, nlookups);
+					bytes += trial.memory.bytes;
+					peak += trial.memory.peak;
+					per_key += trial.nkeys
+						? (double)trial.memory.bytes / trial.nkeys : 0;
+				}
+
+				double imean, ici, lmean, lci;
+				summarise(insert_ns, options.trials, &imean, &ici);
+				summarise(lookup_ns, options.trials, &lmean, &lci);
+				printf("%s,%d,%d,%g,%d,%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.0f,"
+					"%.0f,%.3f", options.types[t], size, options.reserve,
+					options.filter, options.ways, pagestostr(options.pages),
+					ninserts, nlookups,
+					options.trials, imean, ici, lmean, lci, bytes / options.trials,
+					peak / options.trials, per_key / options.trials);
+				print_perf(&insert_perf);
+				print_perf(&lookup_perf);
+				printf("\n");
+			}
+
+			free(inserts);
+			free(lookups);
+			free(results);
+		}
+	}
+
+	free_perf_counters(counters);
+	return 0;
+}
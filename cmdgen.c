@@ -1,17 +1,46 @@
 /* * * * * * * * *
  * Utility program that generates random input and lookup commands for
  * the hash table interpreter program
- * 
+ *
  * usage:
  *   make cmdgen
- *   ./cmdgen ninserts nlookups > commandfilename
+ *   ./cmdgen [options] ninserts nlookups [no-print] > commandfilename
  *       ninserts: number of insert commands to generate
  *       nlookups: number of lookup commands to generate
  *       commandfilename: name of file to store commands in
  *
+ *   output options:
+ *       -b: write commands in the binary stream format (see cmdstream.h)
+ *       -B: as -b, with each run of inserts or lookups written as a batch
+ *
+ *   key distributions (-d):
+ *       uniform:    keys uniform over [0, 100 * ninserts] (default)
+ *       zipf:       hot keys; key ranks follow a zipf law with exponent -z
+ *                   (default 0.99) over ninserts distinct keys
+ *       sequential: monotonically increasing ids 1, 2, 3, ...
+ *       strided:    ids spaced -k apart (default 1024)
+ *       collide:    keys whose hash values agree in their lowest -c bits
+ *                   (default 8), so they collide in every table whose size
+ *                   is a power of two up to 2^c (other sizes address by
+ *                   h % size, which these keys do not fix). -H picks the
+ *                   hash: 1, 2 or 12 for both. keys are built by inverting
+ *                   the hash (see hash_preimage), so there are only about
+ *                   2^(31-c) of them, or 2^(31-2c) for both hashes
+ *
+ *   workloads (-w):
+ *       phased:  all inserts, then all lookups (default)
+ *       mixed:   inserts and lookups randomly interleaved, in the ratio
+ *                ninserts:nlookups
+ *       churn:   the working set moves: lookups that hit only target the
+ *                last -W (default ninserts / 10) keys inserted
+ *
+ *   other options:
+ *       -p: fraction of lookups that target an inserted key (default 0.5)
+ *       -S: seed for the random number generator (default: the time)
+ *
  * created for COMP20007 Design of Algorithms - Assignment 2, 2017
  * by Shreyash Patodia and Matt Farrugia
- * 
+ *
  * modifications by ...
  * 14/05/17
  * Ben Tomlin
@@ -21,28 +50,372 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
+#include <getopt.h>
 
 #include "inthash.h"
+#include "cmdstream.h"
+
+/* Output formats */
+#define TEXT 0
+#define BINARY 1
+#define BATCHED 2
+
+/* Key distributions */
+#define UNIFORM 0
+#define ZIPF 1
+#define SEQUENTIAL 2
+#define STRIDED 3
+#define COLLIDE 4
+
+/* Workloads */
+#define PHASED 0
+#define MIXED 1
+#define CHURN 2
+
+/* Largest run of keys buffered before being written as a batch */
+#define MAX_BATCH 65536
+
+/* Generator settings from the command line */
+typedef struct options {
+	int format;
+	int distribution;
+	int workload;
+	double skew;		/* zipf exponent */
+	int64 stride;		/* gap between strided keys */
+	int bits;			/* low hash bits shared by colliding keys */
+	int hashes;			/* 1, 2 or 12: hash function(s) to collide under */
+	int window;			/* churn working set size, 0 for ninserts / 10 */
+	double hit_rate;	/* fraction of lookups for inserted keys */
+	int64 seed;
+} Options;
+
+/* State for drawing fresh keys from a distribution */
+typedef struct generator {
+	int distribution;
+	int64 max;			/* uniform keys are drawn from [0, max) */
+	int64 next;			/* next sequential / strided key, or collide value */
+	int64 stride;
+	int64 mask;			/* low hash bits which must be zero, for collide */
+	int hashes;
+	int64 seed;			/* scatters zipf ranks over the key space */
+
+	/* zipf rejection-inversion sampler constants */
+	double n, s, hx1, hn, cut;
+} Generator;
+
+/* Pending run of same-operation commands, for batched output */
+typedef struct emitter {
+	int format;
+	char op;
+	uint32_t n;
+	int64 keys[MAX_BATCH];
+} Emitter;
+
+/*************************************************************************/
+
+/* xoshiro256** state, seeded with splitmix64 */
+static uint64_t rng[4];
+
+static uint64_t splitmix64(uint64_t *x) {
+	uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+static void seed_random(uint64_t seed) {
+	int i;
+	for (i = 0; i < 4; i++) {
+		rng[i] = splitmix64(&seed);
+	}
+}
+
+static uint64_t rotl(uint64_t x, int k) {
+	return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t next_random(void) {
+	uint64_t result = rotl(rng[1] * 5, 7) * 9;
+	uint64_t t = rng[1] << 17;
+	rng[2] ^= rng[0];
+	rng[3] ^= rng[1];
+	rng[1] ^= rng[2];
+	rng[0] ^= rng[3];
+	rng[2] ^= t;
+	rng[3] = rotl(rng[3], 45);
+	return result;
+}
+
+/* Uniform double in [0, 1) */
+static double random_unit(void) {
+	return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Uniform integer in [0, n) */
+static uint64_t random_below(uint64_t n) {
+	return n ? next_random() % n : 0;
+}
+
+/*************************************************************************/
+
+/* Helpers for the zipf sampler (Hormann & Derflinger rejection-inversion),
+ * numerically stable around s = 1 */
+static double zipf_helper1(double x) {
+	return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0/3 - 0.25*x));
+}
+
+static double zipf_helper2(double x) {
+	return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x/3 * (1 + 0.25*x));
+}
+
+static double zipf_h(Generator *g, double x) {
+	return exp(-g->s * log(x));
+}
+
+static double zipf_hintegral(Generator *g, double x) {
+	double logx = log(x);
+	return zipf_helper2((1 - g->s) * logx) * logx;
+}
+
+static double zipf_hintegral_inv(Generator *g, double x) {
+	double t = x * (1 - g->s);
+	if (t < -1) {
+		t = -1;
+	}
+	return exp(zipf_helper1(t) * x);
+}
+
+/* Draw a rank in [1, n], rank k with probability proportional to 1/k^s */
+static int64 zipf_rank(Generator *g) {
+	while (true) {
+		double u = g->hn + random_unit() * (g->hx1 - g->hn);
+		double x = zipf_hintegral_inv(g, u);
+		double k = floor(x + 0.5);
+		if (k < 1) {
+			k = 1;
+		} else if (k > g->n) {
+			k = g->n;
+		}
+		if (k - x <= g->cut || u >= zipf_hintegral(g, k + 0.5) - zipf_h(g, k)) {
+			return (int64)k;
+		}
+	}
+}
+
+/*************************************************************************/
+
+static void init_generator(Generator *g, Options *options, int ninserts) {
+	g->distribution = options->distribution;
+	g->max = 100 * (int64)ninserts + 1;
+	g->next = 1;
+	g->stride = options->stride;
+	g->mask = ((int64)1 << options->bits) - 1;
+	g->hashes = options->hashes;
+	g->seed = options->seed;
+
+	g->n = ninserts > 0 ? ninserts : 1;
+	g->s = options->skew;
+	g->hx1 = zipf_hintegral(g, 1.5) - 1;
+	g->hn = zipf_hintegral(g, g->n + 0.5);
+	g->cut = 2 - zipf_hintegral_inv(g, zipf_hintegral(g, 2.5) - zipf_h(g, 2));
+}
+
+/* The next key whose hash values have all the masked bits clear, for the
+ * chosen hashes: the key the first hash maps to the next value with those
+ * bits clear, as long as the second does too (if both are chosen) */
+static int64 next_colliding_key(Generator *g) {
+	int first = (g->hashes == 2) ? 2 : 1;
+	int64 key;
+	while (true) {
+		int64 value = g->next++ * (g->mask + 1);
+		if (!hash_preimage(first, value, &key)) {
+			fprintf(stderr, "cmdgen: ran out of keys colliding in their "
+				"lowest %d bits\n", __builtin_popcountll(g->mask));
+			exit(1);
+		}
+		if (g->hashes != 12 || !(h2(key) & g->mask)) {
+			return key;
+		}
+	}
+}
+
+/* Draw a key from the distribution. Fresh for sequential, strided and
+ * collide; for uniform and zipf it may repeat an earlier key */
+static int64 next_key(Generator *g) {
+	int64 key, rank;
+	switch (g->distribution) {
+		case ZIPF:
+			/* scatter ranks over the key space so hot keys aren't adjacent */
+			rank = zipf_rank(g) ^ g->seed;
+			return splitmix64((uint64_t *)&rank) % g->max;
+		case SEQUENTIAL:
+			return g->next++;
+		case STRIDED:
+			key = g->next * g->stride;
+			g->next++;
+			return key;
+		case COLLIDE:
+			return next_colliding_key(g);
+		default:
+			return random_below(g->max);
+	}
+}
+
+/*************************************************************************/
+
+/* Write any pending batch */
+static void flush(Emitter *e) {
+	if (e->n) {
+		char op = (e->op == 'i') ? CMD_BATCH_INSERT : CMD_BATCH_LOOKUP;
+		write_binary_batch(stdout, op, e->keys, e->n);
+		e->n = 0;
+	}
+}
+
+/* Write one command in the chosen output format */
+static void emit(Emitter *e, char op, int64 key, bool has_key) {
+	if (e->format == BATCHED && has_key) {
+		if (e->n && (e->op != op || e->n == MAX_BATCH)) {
+			flush(e);
+		}
+		e->op = op;
+		e->keys[e->n++] = key;
+		return;
+	}
+
+	flush(e);
+	if (e->format == TEXT) {
+		if (has_key) {
+			printf("%c %llu\n", op, key);
+		} else {
+			printf("%c\n", op);
+		}
+	} else {
+		write_binary_command(stdout, op, key);
+	}
+}
+
+/* Pick a lookup key: an inserted key from [first, ninserted) with
+ * probability 'hit_rate', otherwise a fresh draw from the distribution */
+static int64 lookup_key(Generator *g, double hit_rate, int64 *inserted,
+		int first, int ninserted) {
+	if (ninserted > first && random_unit() < hit_rate) {
+		/* zipf hits should favour the hot keys, so redraw by rank */
+		if (g->distribution == ZIPF) {
+			return next_key(g);
+		}
+		return inserted[first + random_below(ninserted - first)];
+	}
+	return next_key(g);
+}
 
 /*************************************************************************/
 
 void printusageexit(char *exe) {
 	/* Print usage information: */
-	fprintf(stderr, "usage: %s ninserts nlookups > commandfilename\n", exe);
+	fprintf(stderr, "usage: %s [options] ninserts nlookups [no-print] "
+		"> commandfilename\n", exe);
 	fprintf(stderr, " ninserts: number of insert commands to generate\n");
 	fprintf(stderr, " nlookups: number of lookup commands to generate\n");
 	fprintf(stderr, " no-print: just print commands\n");
 	fprintf(stderr, " commandfilename: name of file to store commands in\n");
+	fprintf(stderr, "options:\n");
+	fprintf(stderr, " -b: write binary records instead of text\n");
+	fprintf(stderr, " -B: write binary, runs of inserts/lookups as batches\n");
+	fprintf(stderr, " -d uniform|zipf|sequential|strided|collide: "
+		"key distribution\n");
+	fprintf(stderr, " -w phased|mixed|churn: order of inserts and lookups\n");
+	fprintf(stderr, " -z skew: zipf exponent (default 0.99)\n");
+	fprintf(stderr, " -k stride: gap between strided keys (default 1024)\n");
+	fprintf(stderr, " -c bits: hash bits shared by colliding keys "
+		"(default 8)\n");
+	fprintf(stderr, " -H 1|2|12: hash function(s) to collide under "
+		"(default 1)\n");
+	fprintf(stderr, " -W window: churn working set (default ninserts/10)\n");
+	fprintf(stderr, " -p rate: fraction of lookups for inserted keys "
+		"(default 0.5)\n");
+	fprintf(stderr, " -S seed: random seed (default: the time)\n");
 
 	/* and exit, as promised :) */
 	exit(1);
 }
 
+/* Look 'str' up in 'names', exiting with usage information if absent */
+static int choose(char *str, const char **names, int nnames, char *exe) {
+	int i;
+	for (i = 0; i < nnames; i++) {
+		if (strcmp(str, names[i]) == 0) {
+			return i;
+		}
+	}
+	printusageexit(exe);
+	return -1;
+}
+
 /*************************************************************************/
 
 int main(int argc, char **argv) {
-	int i;
+	const char *distributions[] = {"uniform", "zipf", "sequential", "strided",
+		"collide"};
+	const char *workloads[] = {"phased", "mixed", "churn"};
+
+	/* Get command line flags. */
+	Options options = { .format = TEXT, .distribution = UNIFORM,
+		.workload = PHASED, .skew = 0.99, .stride = 1024, .bits = 8,
+		.hashes = 1, .window = 0, .hit_rate = 0.5, .seed = time(NULL) };
+	int option;
+	while ((option = getopt(argc, argv, "bBd:w:z:k:c:H:W:p:S:")) != -1) {
+		switch (option) {
+			case 'b':
+				options.format = BINARY;
+				break;
+			case 'B':
+				options.format = BATCHED;
+				break;
+			case 'd':
+				options.distribution = choose(optarg, distributions, 5, argv[0]);
+				break;
+			case 'w':
+				options.workload = choose(optarg, workloads, 3, argv[0]);
+				break;
+			case 'z':
+				options.skew = atof(optarg);
+				break;
+			case 'k':
+				options.stride = strtoull(optarg, NULL, 10);
+				break;
+			case 'c':
+				options.bits = atoi(optarg);
+				break;
+			case 'H':
+				options.hashes = atoi(optarg);
+				break;
+			case 'W':
+				options.window = atoi(optarg);
+				break;
+			case 'p':
+				options.hit_rate = atof(optarg);
+				break;
+			case 'S':
+				options.seed = strtoull(optarg, NULL, 10);
+				break;
+			default:
+				printusageexit(argv[0]);
+		}
+	}
+	argc -= optind - 1;
+	argv += optind - 1;
+
+	/* Validate flags */
+	if (options.skew <= 0 || options.stride == 0 || options.bits < 0
+			|| options.bits > 30 || (options.hashes != 1
+			&& options.hashes != 2 && options.hashes != 12)) {
+		printusageexit(argv[0]);
+	}
 
 	/* Get command line arguments. */
 	if (argc < 3) {
@@ -50,48 +423,69 @@ int main(int argc, char **argv) {
 	}
 	int ninserts  = atoi(argv[1]);
 	int nlookups = atoi(argv[2]);
-    int NO_PRINT = atoi(argv[3]);
+	int NO_PRINT = (argc > 3) ? atoi(argv[3]) : 0;
+	if (ninserts < 0 || nlookups < 0) {
+		printusageexit(argv[0]);
+	}
+
+	int window = options.window > 0 ? options.window : ninserts / 10;
+	if (window < 1) {
+		window = 1;
+	}
 
 	/* Seed the random number generator. */
-	srand(time(NULL));
+	seed_random(options.seed);
 
-	/* Decide on some random numbers for insertion. */
-	int max = 100 * ninserts + 1;
-	int64 *inserts = malloc(sizeof (int64) * ninserts);
-	for (i = 0; i < ninserts; i++) {
-		inserts[i] = rand() % max;
-	}
+	Generator generator;
+	init_generator(&generator, &options, ninserts);
 
-	/* Print insertion commands for these numbers. */
-	for (i = 0; i < ninserts; i++) {
-        printf("i %llu\n", inserts[i]);
-	}
+	Emitter *emitter = malloc(sizeof *emitter);
+	emitter->format = options.format;
+	emitter->n = 0;
+
+	/* Keys inserted so far, for lookups that should succeed */
+	int64 *inserted = malloc(sizeof (int64) * (ninserts ? ninserts : 1));
+	int ninserted = 0, nlooked = 0;
 
+	/* Generate commands until both counts are used up */
+	while (ninserted < ninserts || nlooked < nlookups) {
 
-	/* Print lookup commands. Some will succeed, others will fail. */
-	for (i = 0; i < nlookups; i++) {
-		
-		/* Flip a coin to decide whether to use an existing key or a new one. */
-		int64 lookup;
-		if (rand() % 2) {
-			/* Use a random existing key */
-			lookup = inserts[rand() % ninserts];
-		
+		/* Decide whether the next command is an insert or a lookup */
+		bool insert;
+		if (options.workload == PHASED) {
+			insert = (ninserted < ninserts);
 		} else {
-			/* Generate a new random key */
-			lookup = rand() % max;
+			/* Interleave randomly, keeping to the requested totals */
+			int64 left = (ninserts - ninserted) + (nlookups - nlooked);
+			insert = random_below(left) < (uint64_t)(ninserts - ninserted);
 		}
 
-        printf("l %llu\n", lookup);
+		if (insert) {
+			inserted[ninserted] = next_key(&generator);
+			emit(emitter, 'i', inserted[ninserted], true);
+			ninserted++;
+		} else {
+			/* Under churn, only the most recent keys are still hot */
+			int first = 0;
+			if (options.workload == CHURN && ninserted > window) {
+				first = ninserted - window;
+			}
+			emit(emitter, 'l', lookup_key(&generator, options.hit_rate,
+				inserted, first, ninserted), true);
+			nlooked++;
+		}
 	}
 
 	/* Finish with commands to print the table, print statistics, and quit. */
 
 	if(!NO_PRINT) {
-        printf("p\n");
-        printf("s\n");
-    }
-	printf("q\n"); 
+		emit(emitter, 'p', 0, false);
+		emit(emitter, 's', 0, false);
+	}
+	emit(emitter, 'q', 0, false);
+	flush(emitter);
 
+	free(inserted);
+	free(emitter);
 	return 0;
 }
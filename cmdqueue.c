@@ -0,0 +1,85 @@
+/* * * * * * * * *
+ * Module providing a ring buffer of parsed commands, used to hand commands
+ * from a reader thread to the thread executing them against a table
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "cmdqueue.h"
+
+// a single-reader, single-executor ring of command blocks. blocks
+// [head, tail) are filled and waiting to be executed, the rest are free.
+// head and tail only ever grow, and index the ring modulo QUEUE_NBLOCKS
+struct command_queue {
+	CommandBlock *blocks;		// the ring of blocks
+	unsigned long head;			// next block to execute
+	unsigned long tail;			// next block to fill
+	pthread_mutex_t lock;		// protects head and tail
+	pthread_cond_t filled;		// signalled when a block is pushed
+	pthread_cond_t emptied;		// signalled when a block is released
+};
+
+CommandQueue *new_command_queue(void) {
+	CommandQueue *queue = malloc(sizeof *queue);
+	assert(queue);
+	queue->blocks = malloc(sizeof *queue->blocks * QUEUE_NBLOCKS);
+	assert(queue->blocks);
+
+	queue->head = 0;
+	queue->tail = 0;
+	pthread_mutex_init(&queue->lock, NULL);
+	pthread_cond_init(&queue->filled, NULL);
+	pthread_cond_init(&queue->emptied, NULL);
+	return queue;
+}
+
+void free_command_queue(CommandQueue *queue) {
+	pthread_mutex_destroy(&queue->lock);
+	pthread_cond_destroy(&queue->filled);
+	pthread_cond_destroy(&queue->emptied);
+	free(queue->blocks);
+	free(queue);
+}
+
+CommandBlock *queue_reserve(CommandQueue *queue) {
+	pthread_mutex_lock(&queue->lock);
+	while (queue->tail - queue->head == QUEUE_NBLOCKS) {
+		pthread_cond_wait(&queue->emptied, &queue->lock);
+	}
+	CommandBlock *block = &queue->blocks[queue->tail % QUEUE_NBLOCKS];
+	pthread_mutex_unlock(&queue->lock);
+
+	block->ncommands = 0;
+	return block;
+}
+
+void queue_push(CommandQueue *queue) {
+	pthread_mutex_lock(&queue->lock);
+	queue->tail++;
+	pthread_cond_signal(&queue->filled);
+	pthread_mutex_unlock(&queue->lock);
+}
+
+CommandBlock *queue_pop(CommandQueue *queue) {
+	pthread_mutex_lock(&queue->lock);
+	while (queue->head == queue->tail) {
+		pthread_cond_wait(&queue->filled, &queue->lock);
+	}
+	CommandBlock *block = &queue->blocks[queue->head % QUEUE_NBLOCKS];
+	pthread_mutex_unlock(&queue->lock);
+	return block;
+}
+
+void queue_release(CommandQueue *queue) {
+	pthread_mutex_lock(&queue->lock);
+	queue->head++;
+	pthread_cond_signal(&queue->emptied);
+	pthread_mutex_unlock(&queue->lock);
+}
@@ -0,0 +1,54 @@
+/* * * * * * * * *
+ * Module providing a ring buffer of parsed commands, used to hand commands
+ * from a reader thread to the thread executing them against a table
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#ifndef CMDQUEUE_H
+#define CMDQUEUE_H
+
+#include "inthash.h"
+
+// commands are handed over in blocks of this many, so that the reader and
+// executor only synchronise once per block rather than once per command
+#define QUEUE_BLOCK_LEN 4096
+
+// number of blocks in the ring. the reader can be this many blocks ahead
+#define QUEUE_NBLOCKS 8
+
+// a command as parsed by the reader
+typedef struct command {
+	char op;	// operation character
+	int argc;	// number of tokens parsed (see get_command() in main.c)
+	int64 key;	// key, if argc is 2
+} Command;
+
+// a block of consecutive commands
+typedef struct command_block {
+	int ncommands;						// how many commands are in use
+	Command commands[QUEUE_BLOCK_LEN];	// the commands, in input order
+} CommandBlock;
+
+typedef struct command_queue CommandQueue;
+
+// create an empty queue
+CommandQueue *new_command_queue(void);
+
+// free all memory associated with 'queue'
+void free_command_queue(CommandQueue *queue);
+
+// reader side: wait for a free block to fill, then hand it back (filled)
+// with queue_push. blocks are returned in ring order
+CommandBlock *queue_reserve(CommandQueue *queue);
+void queue_push(CommandQueue *queue);
+
+// executor side: wait for the next filled block, then hand it back (done
+// with) with queue_release
+CommandBlock *queue_pop(CommandQueue *queue);
+void queue_release(CommandQueue *queue);
+
+#endif
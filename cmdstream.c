@@ -0,0 +1,294 @@
+/* * * * * * * * *
+ * Module for reading and writing the binary command stream format used to
+ * replay large numbers of operations through the hash table interpreter,
+ * and for reading command files (text or binary) through a memory map
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#define _DEFAULT_SOURCE		// for madvise
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cmdstream.h"
+
+// how many bytes of the input to buffer at a time
+#define STREAM_BUFFER_LEN 65536
+
+// bytes in a batch header (operation byte and key count)
+#define BATCH_HEADER_LEN 5
+
+// a command stream parses commands out of a buffer, which either holds the
+// whole file (mapped into memory) or is refilled from a FILE as it is used up.
+// it also remembers how far through a batch it is
+struct command_stream {
+	FILE *in;				// file commands are read from, NULL if mapped
+	unsigned char *buffer;	// bytes read (or mapped) but not yet parsed
+	size_t start;			// first unparsed byte in the buffer
+	size_t end;				// one past the last byte in the buffer
+	bool binary;			// binary records, or text lines
+	char batch_op;			// operation of the current batch ('i' or 'l')
+	uint32_t batch_left;	// keys left to read in the current batch
+};
+
+void put_le64(unsigned char *buf, int64 value) {
+	int i;
+	for (i = 0; i < 8; i++) {
+		buf[i] = (unsigned char)(value >> (8 * i));
+	}
+}
+
+int64 get_le64(const unsigned char *buf) {
+	int64 value = 0;
+	int i;
+	for (i = 7; i >= 0; i--) {
+		value = (value << 8) | buf[i];
+	}
+	return value;
+}
+
+void put_le32(unsigned char *buf, uint32_t value) {
+	int i;
+	for (i = 0; i < 4; i++) {
+		buf[i] = (unsigned char)(value >> (8 * i));
+	}
+}
+
+uint32_t get_le32(const unsigned char *buf) {
+	return (uint32_t)buf[0] | (uint32_t)buf[1] << 8 |
+		(uint32_t)buf[2] << 16 | (uint32_t)buf[3] << 24;
+}
+
+void write_binary_command(FILE *out, char op, int64 key) {
+	unsigned char record[CMD_RECORD_LEN];
+	record[0] = (unsigned char)op;
+	put_le64(record + 1, key);
+	fwrite(record, 1, CMD_RECORD_LEN, out);
+}
+
+void write_binary_batch(FILE *out, char op, const int64 *keys, uint32_t nkeys) {
+	unsigned char header[BATCH_HEADER_LEN], key[8];
+	header[0] = (unsigned char)op;
+	put_le32(header + 1, nkeys);
+	fwrite(header, 1, BATCH_HEADER_LEN, out);
+
+	uint32_t i;
+	for (i = 0; i < nkeys; i++) {
+		put_le64(key, keys[i]);
+		fwrite(key, 1, 8, out);
+	}
+}
+
+CommandStream *new_command_stream(FILE *in) {
+	CommandStream *stream = malloc(sizeof *stream);
+	assert(stream);
+	stream->buffer = malloc(STREAM_BUFFER_LEN);
+	assert(stream->buffer);
+
+	stream->in = in;
+	stream->start = 0;
+	stream->end = 0;
+	stream->binary = true;
+	stream->batch_op = 0;
+	stream->batch_left = 0;
+	return stream;
+}
+
+CommandStream *map_command_stream(const char *path, bool binary) {
+	/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+	 * DESC: Open a command file and map it read-only into memory, so that
+	 *       commands are parsed straight out of the page cache with no
+	 *       copying into line buffers.
+	 *
+	 * INPT: const char *path
+	 *          Command file to map
+	 *
+	 *       bool binary
+	 *          True if the file is in the binary format, false for text
+	 *
+	 * OTPT: CommandStream*
+	 *          A stream over the whole file, or NULL if it could not be
+	 *          opened or mapped.
+	 *
+	 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) < 0) {
+		close(fd);
+		return NULL;
+	}
+
+	// an empty file can't be mapped, but is a valid (empty) stream
+	unsigned char *map = NULL;
+	if (info.st_size > 0) {
+		map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED) {
+			close(fd);
+			return NULL;
+		}
+
+		// commands are read front to back, so ask for aggressive read-ahead
+		madvise(map, info.st_size, MADV_SEQUENTIAL);
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	close(fd);
+
+	CommandStream *stream = malloc(sizeof *stream);
+	assert(stream);
+	stream->in = NULL;
+	stream->buffer = map;
+	stream->start = 0;
+	stream->end = info.st_size;
+	stream->binary = binary;
+	stream->batch_op = 0;
+	stream->batch_left = 0;
+	return stream;
+}
+
+void free_command_stream(CommandStream *stream) {
+	if (stream->in) {
+		free(stream->buffer);
+	} else if (stream->buffer) {
+		munmap(stream->buffer, stream->end);
+	}
+	free(stream);
+}
+
+// make sure at least 'n' unparsed bytes are buffered, reading more from the
+// file if needed. returns false if the stream ends first
+static bool fill_stream(CommandStream *stream, size_t n) {
+	if (stream->end - stream->start >= n) {
+		return true;
+	}
+
+	// a mapped stream already holds the whole file
+	if (!stream->in) {
+		return false;
+	}
+
+	// move the leftover bytes to the front, then top the buffer up
+	size_t left = stream->end - stream->start;
+	memmove(stream->buffer, stream->buffer + stream->start, left);
+	stream->start = 0;
+	stream->end = left;
+	stream->end += fread(stream->buffer + left, 1, STREAM_BUFFER_LEN - left,
+		stream->in);
+
+	return stream->end >= n;
+}
+
+// read the next binary record (or batch key) from 'stream'
+static int next_binary_command(CommandStream *stream, char *operation,
+		int64 *key) {
+
+	// inside a batch, every key is a command of its own
+	if (stream->batch_left > 0) {
+		if (!fill_stream(stream, 8)) {
+			*operation = CMD_QUIT;
+			return 1;
+		}
+		*operation = stream->batch_op;
+		*key = get_le64(stream->buffer + stream->start);
+		stream->start += 8;
+		stream->batch_left--;
+		return 2;
+	}
+
+	if (!fill_stream(stream, 1)) {
+		*operation = CMD_QUIT;
+		return 1;
+	}
+
+	char op = stream->buffer[stream->start];
+	if (op == CMD_BATCH_INSERT || op == CMD_BATCH_LOOKUP) {
+		if (!fill_stream(stream, BATCH_HEADER_LEN)) {
+			*operation = CMD_QUIT;
+			return 1;
+		}
+		stream->batch_op = (op == CMD_BATCH_INSERT) ? 'i' : 'l';
+		stream->batch_left = get_le32(stream->buffer + stream->start + 1);
+		stream->start += BATCH_HEADER_LEN;
+
+		// an empty batch is just skipped
+		return next_binary_command(stream, operation, key);
+	}
+
+	if (!fill_stream(stream, CMD_RECORD_LEN)) {
+		*operation = CMD_QUIT;
+		return 1;
+	}
+	*operation = op;
+	*key = get_le64(stream->buffer + stream->start + 1);
+	stream->start += CMD_RECORD_LEN;
+	return (op == 'i' || op == 'l') ? 2 : 1;
+}
+
+// parse the next text line of a mapped stream, the same way the interpreter's
+// sscanf("%c %llu") does: an operation character, then optional whitespace and
+// an optionally signed decimal key. a negative key wraps around, as with %llu
+static int next_text_command(CommandStream *stream, char *operation,
+		int64 *key) {
+	const unsigned char *p = stream->buffer + stream->start;
+	const unsigned char *end = stream->buffer + stream->end;
+
+	if (p == end) {
+		*operation = CMD_QUIT;
+		return 1;
+	}
+
+	// find the end of this line, and move the stream past it
+	const unsigned char *eol = memchr(p, '\n', end - p);
+	if (!eol) {
+		eol = end;
+	}
+	stream->start = (eol - stream->buffer) + (eol < end);
+
+	// a blank line holds no command
+	if (p == eol) {
+		return 0;
+	}
+	*operation = *p++;
+
+	while (p < eol && (*p == ' ' || *p == '\t' || *p == '\r')) {
+		p++;
+	}
+
+	bool negative = false;
+	if (p < eol && (*p == '-' || *p == '+')) {
+		negative = (*p++ == '-');
+	}
+
+	// no digits means no key
+	if (p == eol || *p < '0' || *p > '9') {
+		return 1;
+	}
+
+	int64 value = 0;
+	while (p < eol && *p >= '0' && *p <= '9') {
+		value = value * 10 + (*p++ - '0');
+	}
+	*key = negative ? -value : value;
+	return 2;
+}
+
+int command_stream_next(CommandStream *stream, char *operation, int64 *key) {
+	if (stream->binary) {
+		return next_binary_command(stream, operation, key);
+	}
+	return next_text_command(stream, operation, key);
+}
@@ -0,0 +1,84 @@
+/* * * * * * * * *
+ * Module for reading and writing the binary command stream format used to
+ * replay large numbers of operations through the hash table interpreter,
+ * and for reading command files (text or binary) through a memory map
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * The stream is a sequence of records. A record is an operation byte, using
+ * the same letters as the text interpreter ('i', 'l', 'p', 's', 'n', 'd',
+ * 'q'), followed by a 64-bit little-endian key:
+ *
+ *      [op:1][key:8]
+ *
+ * Operations without a key still carry 8 (ignored) key bytes, so every
+ * record is CMD_RECORD_LEN bytes long.
+ *
+ * Runs of inserts or lookups can instead be written as a length-prefixed
+ * batch: an upper case 'I' or 'L', a 32-bit little-endian key count n, then
+ * n 64-bit little-endian keys:
+ *
+ *      [op:1][n:4][key:8]*n
+ *
+ * A batch reads back as n separate 'i' or 'l' commands.
+ *
+ * Mapped text files hold one command per line, exactly as typed into the
+ * interpreter ("i 42", "l 7", "q", ...).
+ */
+
+#ifndef CMDSTREAM_H
+#define CMDSTREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "inthash.h"
+
+// bytes in a single (non-batch) record
+#define CMD_RECORD_LEN 9
+
+// operation bytes which start a batch of inserts / lookups
+#define CMD_BATCH_INSERT 'I'
+#define CMD_BATCH_LOOKUP 'L'
+
+// operation reported once the end of a stream is reached
+#define CMD_QUIT 'q'
+
+typedef struct command_stream CommandStream;
+
+// encode / decode little-endian integers at 'buf'
+void put_le64(unsigned char *buf, int64 value);
+int64 get_le64(const unsigned char *buf);
+void put_le32(unsigned char *buf, uint32_t value);
+uint32_t get_le32(const unsigned char *buf);
+
+// write a single record for operation 'op' (and 'key') to 'out'
+void write_binary_command(FILE *out, char op, int64 key);
+
+// write a batch of 'nkeys' keys to 'out'. 'op' is CMD_BATCH_INSERT or
+// CMD_BATCH_LOOKUP
+void write_binary_batch(FILE *out, char op, const int64 *keys, uint32_t nkeys);
+
+// start reading binary commands from 'in'
+CommandStream *new_command_stream(FILE *in);
+
+// memory-map the command file at 'path' and read commands from it in place,
+// in the binary format if 'binary', else as text lines. returns NULL (with
+// errno set) if the file cannot be opened or mapped
+CommandStream *map_command_stream(const char *path, bool binary);
+
+// free all memory associated with 'stream', unmapping its file if it was
+// mapped (a stream read from a FILE does not close the file)
+void free_command_stream(CommandStream *stream);
+
+// read the next command from 'stream' into *operation and *key, with batches
+// expanded into their individual commands. returns the number of tokens read,
+// as the text interpreter does: 0 for a blank line, 2 for a command with a
+// key, 1 otherwise. at the end of the stream (or a truncated record) CMD_QUIT
+// is returned
+int command_stream_next(CommandStream *stream, char *operation, int64 *key);
+
+#endif
@@ -0,0 +1,235 @@
+/* * * * * * * * *
+ * Module for a compact approximate membership filter (a bloom filter) kept
+ * in front of a table, so that most lookups of keys that are not in the
+ * table are answered without probing it
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#include <stdint.h>
+#include <math.h>
+#include <assert.h>
+
+#include "filter.h"
+
+#define BLOCK_WORDS 8					// 64 bit words per block (a cache line)
+#define BLOCK_BITS (64 * BLOCK_WORDS)
+#define BLOCK_BYTES (8 * BLOCK_WORDS)
+#define MAX_PROBES 16					// bits set per key, at most
+#define LN2 0.69314718055994530942
+
+// one bloom filter, sized for 'capacity' keys
+typedef struct layer {
+	void *raw;			// the allocation 'blocks' is aligned within
+	uint64_t *blocks;	// nblocks blocks of BLOCK_WORDS words
+	uint64_t nblocks;
+	int nprobes;		// bits set per key
+	size_t capacity;	// keys this layer was sized for
+	size_t nkeys;		// keys added to this layer
+} Layer;
+
+struct filter {
+	Layer layers[FILTER_MAX_LAYERS];
+	int nlayers;		// the newest layer is the one added to
+	double fprate;		// false positive rate over all layers
+	long rejected;		// lookups answered false
+	Memory memory;
+};
+
+// the filter's own hash of a key: a full 64 bit mix, independent of h1 and h2
+// (the 'fmix64' finaliser of MurmurHash3)
+static uint64_t filter_hash(int64 key) {
+	uint64_t h = key;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+// the false positive rate of 'capacity' keys in 'nblocks' blocks, setting
+// 'nprobes' bits each. keys are not spread evenly over the blocks (the number
+// in a block is poisson distributed), and fuller blocks answer true more
+// often, so this is higher than for an unblocked filter of the same size
+static double blocked_fprate(uint64_t nblocks, size_t capacity, int nprobes) {
+	double mean = (double)capacity / nblocks;
+	double chance = exp(-mean), fprate = 0;
+	long j, last = (long)(mean + 12 * sqrt(mean) + 20);
+	for (j = 0; j <= last; j++) {
+		// with j keys in it, a block has this fraction of its bits set
+		double set = 1 - pow(1 - 1.0 / BLOCK_BITS, (double)nprobes * j);
+		fprate += chance * pow(set, nprobes);
+		chance *= mean / (j + 1);
+	}
+	return fprate;
+}
+
+// start a layer of room for 'capacity' keys at false positive rate 'fprate'
+static void init_layer(Filter *filter, Layer *layer, size_t capacity,
+		double fprate) {
+	// the optimal bloom filter has -ln(p) / ln(2)^2 bits and -log2(p) probes
+	// per key. each layer is a whole number of blocks, and blocking costs a
+	// few more of them to keep to 'fprate'
+	double bits = capacity * -log(fprate) / (LN2 * LN2);
+	layer->nblocks = (uint64_t)ceil(bits / BLOCK_BITS);
+	if (layer->nblocks < 1) {
+		layer->nblocks = 1;
+	}
+	layer->nprobes = (int)ceil(-log2(fprate));
+	if (layer->nprobes > MAX_PROBES) {
+		layer->nprobes = MAX_PROBES;
+	}
+	while (blocked_fprate(layer->nblocks, capacity, layer->nprobes) > fprate) {
+		layer->nblocks += layer->nblocks / 16 + 1;
+	}
+	layer->capacity = capacity;
+	layer->nkeys = 0;
+
+	// line the blocks up with cache lines, so each key touches only one
+	layer->raw = memory_calloc(&filter->memory,
+		layer->nblocks * BLOCK_BYTES + BLOCK_BYTES, 1);
+	assert(layer->raw);
+	uintptr_t start = ((uintptr_t)layer->raw + BLOCK_BYTES - 1)
+		& ~(uintptr_t)(BLOCK_BYTES - 1);
+	layer->blocks = (uint64_t *)start;
+}
+
+// the false positive rate of the 'i'th layer: halving with each layer, so
+// the rates over all layers add up to at most the filter's
+static double layer_fprate(Filter *filter, int i) {
+	return filter->fprate / 2 / (double)((uint64_t)1 << i);
+}
+
+// add a layer with room for 'capacity' keys, returning false if there are
+// FILTER_MAX_LAYERS already
+static bool add_layer(Filter *filter, size_t capacity) {
+	if (filter->nlayers == FILTER_MAX_LAYERS) {
+		return false;
+	}
+	int i = filter->nlayers++;
+	init_layer(filter, &filter->layers[i], capacity, layer_fprate(filter, i));
+	return true;
+}
+
+Filter *new_filter(double fprate, size_t nkeys) {
+	if (!(fprate > 0 && fprate < 1)) {
+		return NULL;
+	}
+	Memory memory;
+	memory_init(&memory);
+	Filter *filter = memory_malloc(&memory, sizeof *filter);
+	assert(filter);
+	filter->memory = memory;
+	filter->nlayers = 0;
+	filter->fprate = fprate;
+	filter->rejected = 0;
+	add_layer(filter, nkeys > FILTER_MIN_KEYS ? nkeys : FILTER_MIN_KEYS);
+	return filter;
+}
+
+void free_filter(Filter *filter) {
+	assert(filter != NULL);
+	int i;
+	for (i = 0; i < filter->nlayers; i++) {
+		memory_free(&filter->memory, filter->layers[i].raw);
+	}
+	memory_free(&filter->memory, filter);
+}
+
+// the block of 'layer' holding the bits of a key with hash 'hash'. the top
+// 32 bits of the hash pick it, without a division
+static uint64_t *find_block(Layer *layer, uint64_t hash) {
+	uint64_t i = ((hash >> 32) * layer->nblocks) >> 32;
+	return layer->blocks + i * BLOCK_WORDS;
+}
+
+// the bits of a key within its block: each is the top 9 bits of its hash,
+// multiplied by an odd constant once more for each bit
+#define PROBE_MULTIPLIER 0x9e3779b97f4a7c15ULL
+#define NEXT_BIT(probe) (((probe) *= PROBE_MULTIPLIER) >> (64 - 9))
+
+void filter_add(Filter *filter, int64 key) {
+	assert(filter != NULL);
+
+	// a full layer is followed by a larger one
+	Layer *layer = &filter->layers[filter->nlayers - 1];
+	if (layer->nkeys >= layer->capacity
+			&& add_layer(filter, layer->capacity * FILTER_GROWTH)) {
+		layer = &filter->layers[filter->nlayers - 1];
+	}
+
+	uint64_t hash = filter_hash(key);
+	uint64_t *block = find_block(layer, hash);
+	uint64_t probe = hash, bit;
+	int i;
+	for (i = 0; i < layer->nprobes; i++) {
+		bit = NEXT_BIT(probe);
+		block[bit / 64] |= (uint64_t)1 << (bit % 64);
+	}
+	layer->nkeys++;
+}
+
+bool filter_lookup(Filter *filter, int64 key) {
+	assert(filter != NULL);
+
+	// the newest layer holds the most keys, so check it first
+	uint64_t hash = filter_hash(key);
+	int l, i;
+	for (l = filter->nlayers - 1; l >= 0; l--) {
+		Layer *layer = &filter->layers[l];
+		uint64_t *block = find_block(layer, hash);
+		uint64_t probe = hash, bit;
+		for (i = 0; i < layer->nprobes; i++) {
+			bit = NEXT_BIT(probe);
+			if (!(block[bit / 64] & ((uint64_t)1 << (bit % 64)))) {
+				break;
+			}
+		}
+		if (i == layer->nprobes) {
+			return true;
+		}
+	}
+	filter->rejected++;
+	return false;
+}
+
+void filter_reserve(Filter *filter, size_t nkeys) {
+	assert(filter != NULL);
+
+	// keys go into the newest layer: count the room left there
+	size_t held = 0, room;
+	int i;
+	for (i = 0; i < filter->nlayers; i++) {
+		held += filter->layers[i].nkeys;
+	}
+	Layer *layer = &filter->layers[filter->nlayers - 1];
+	room = layer->capacity - (layer->nkeys < layer->capacity
+		? layer->nkeys : layer->capacity);
+	if (nkeys <= held + room) {
+		return;
+	}
+
+	// an empty filter can start over with one layer of the right size
+	if (held == 0) {
+		memory_free(&filter->memory, layer->raw);
+		filter->nlayers = 0;
+		add_layer(filter, nkeys);
+		return;
+	}
+	size_t more = nkeys - held;
+	add_layer(filter, more > FILTER_MIN_KEYS ? more : FILTER_MIN_KEYS);
+}
+
+long filter_rejected(Filter *filter) {
+	assert(filter != NULL);
+	return filter->rejected;
+}
+
+void filter_memory(Filter *filter, Memory *memory) {
+	assert(filter != NULL);
+	*memory = filter->memory;
+}
@@ -0,0 +1,64 @@
+/* * * * * * * * *
+ * Module for a compact approximate membership filter (a bloom filter) kept
+ * in front of a table, so that most lookups of keys that are not in the
+ * table are answered without probing it
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * The filter is made of 64 byte blocks, one cache line each, and all of the
+ * bits set for a key are in one block (a blocked bloom filter), so checking a
+ * key reads one line per layer. A bloom filter cannot forget a key, and
+ * cannot be rebuilt without the keys, so it only grows: once the newest layer
+ * holds the keys it was sized for, a layer FILTER_GROWTH times larger is
+ * added with half the false positive rate, keeping the expected rate over
+ * all layers below the one asked for (a scalable bloom filter). Reserving
+ * room for the keys up front keeps to one layer, which is smaller and faster
+ * to check.
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "inthash.h"
+#include "memacct.h"
+
+// keys the first layer is sized for, unless reserved for more
+#define FILTER_MIN_KEYS 1024
+// how much larger each layer is than the one before
+#define FILTER_GROWTH 4
+// layers beyond this are not added; the last one fills up instead
+#define FILTER_MAX_LAYERS 16
+
+typedef struct filter Filter;
+
+// a filter, empty, with a false positive rate of at most 'fprate' (between 0
+// and 1, exclusive) and room for 'nkeys' keys before it adds a layer.
+// returns NULL if 'fprate' is out of range
+Filter *new_filter(double fprate, size_t nkeys);
+
+// free all memory associated with 'filter'
+void free_filter(Filter *filter);
+
+// add 'key' to 'filter'
+void filter_add(Filter *filter, int64 key);
+
+// false if 'key' was certainly never added to 'filter', true if it may
+// have been
+bool filter_lookup(Filter *filter, int64 key);
+
+// make room for 'nkeys' keys in total, so that adding them keeps to one
+// layer (if 'filter' is still empty) or adds at most one more
+void filter_reserve(Filter *filter, size_t nkeys);
+
+// the number of lookups 'filter' has answered false
+long filter_rejected(Filter *filter);
+
+// copy the heap memory currently and at most held by 'filter' into 'memory'
+void filter_memory(Filter *filter, Memory *memory);
+
+#endif
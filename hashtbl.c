@@ -21,12 +21,17 @@
 #include <assert.h>
 
 #include "hashtbl.h"
+#include "snapshot.h"
+#include "filter.h"
 
 #include "tables/linear.h"	// provided
 #include "tables/xtndbl1.h"	// provided
 #include "tables/cuckoo.h"	// create for part 1
 #include "tables/xtndbln.h" // create for part 2
 #include "tables/xuckoo.h"	// create for part 3
+#include "tables/narrow.h"	// 32-bit key variants
+#include "tables/amq.h"		// cuckoo and quotient filters
+#include "tables/hopscotch.h"
 // !! bonus part is implemented with xuckoo.c/xuckoo.h which was written 
 // to be generalized for bucketsize !!
 
@@ -37,6 +42,10 @@
 // "2" or "xtndbln"	->	XTNDBLN
 // "3" or "xuckoo"	->	XUCKOO
 // "xuckoon"        ->  XUCKOON
+// "linear32", "cuckoo32", "xtndbln32" -> LINEAR32, CUCKOO32, XTNDBLN32
+// "cuckoofilter", "quotientfilter" -> CUCKOOFILTER, QUOTIENTFILTER
+// "hopscotch"		->	HOPSCOTCH
+// "linhash"		->	LINHASH
 TableType strtotype(char *str) {
 	if (strcmp("linear",  str) == 0) {
 		return LINEAR;
@@ -56,19 +65,96 @@ TableType strtotype(char *str) {
     if (strcmp("xuckoon",  str) == 0) {
 		return XUCKOON;
     }
+	if (strcmp("linear32", str) == 0) {
+		return LINEAR32;
+	}
+	if (strcmp("cuckoo32", str) == 0) {
+		return CUCKOO32;
+	}
+	if (strcmp("xtndbln32", str) == 0) {
+		return XTNDBLN32;
+	}
+	if (strcmp("cuckoofilter", str) == 0) {
+		return CUCKOOFILTER;
+	}
+	if (strcmp("quotientfilter", str) == 0) {
+		return QUOTIENTFILTER;
+	}
+	if (strcmp("hopscotch", str) == 0) {
+		return HOPSCOTCH;
+	}
+	if (strcmp("linhash", str) == 0) {
+		return LINHASH;
+	}
 	return NOTYPE;
 }
 
+// converts from a TableType constant to the name strtotype accepts for it
+const char *typetostr(TableType type) {
+	switch (type) {
+		case LINEAR:
+			return "linear";
+		case XTNDBL1:
+			return "xtndbl1";
+		case CUCKOO:
+			return "cuckoo";
+		case XTNDBLN:
+			return "xtndbln";
+		case XUCKOO:
+			return "xuckoo";
+		case XUCKOON:
+			return "xuckoon";
+		case LINEAR32:
+			return "linear32";
+		case CUCKOO32:
+			return "cuckoo32";
+		case XTNDBLN32:
+			return "xtndbln32";
+		case CUCKOOFILTER:
+			return "cuckoofilter";
+		case QUOTIENTFILTER:
+			return "quotientfilter";
+		case HOPSCOTCH:
+			return "hopscotch";
+		case LINHASH:
+			return "linhash";
+		default:
+			return "unknown";
+	}
+}
+
 // a HashTable is a wrapper for an actual table structure of some type,
 // and it also remembers is own type
 struct table {
 	TableType type;	// what type of hash table is this?
 	void *table;	// the hash table itself
+	Snapshot *snapshot;	// or, the mapped snapshot of one (read only)
+	int valuesize;		// bytes of value stored with each key (0: a set)
+	Filter *filter;		// checked before each lookup, or NULL
 };
 
 // initialise a hash table of type 'type' with initial size 'size',
 // and return its pointer
 HashTable *new_hash_table(TableType type, int size) {
+	return new_hash_map(type, size, 0);
+}
+
+// initialise a hash table of type 'type' with initial size 'size', storing
+// 'valuesize' bytes of value with each key, and return its pointer
+HashTable *new_hash_map(TableType type, int size, int valuesize) {
+	return new_hash_map_ways(type, size, valuesize, 2);
+}
+
+// initialise a hash table as new_hash_map, with 'ways' inner tables if it is
+// a cuckoo type
+HashTable *new_hash_map_ways(TableType type, int size, int valuesize,
+		int ways) {
+	assert(valuesize >= 0);
+
+	// only the cuckoo types have a choice of how many tables a key may be in
+	if (ways != 2 && type != CUCKOO && type != XUCKOO && type != XUCKOON) {
+		return NULL;
+	}
 	
 	// allocate space for the table wrapper
 	HashTable *table = malloc(sizeof *table);
@@ -76,40 +162,166 @@ HashTable *new_hash_table(TableType type, int size) {
 
 	// store the table type, so we know which functions to call later
 	table->type = type;
+	table->snapshot = NULL;
+	table->valuesize = valuesize;
+	table->filter = NULL;
 
 	// create and store the table itself
 	switch (type) {
 		case LINEAR:
-			table->table = new_linear_hash_table(size);
+			table->table = new_linear_hash_map(size, valuesize);
 			break;
 		case XTNDBL1:
+			// one key per bucket with no room for values: sets only
+			if (valuesize) {
+				free(table);
+				return NULL;
+			}
 			table->table = new_xtndbl1_hash_table();
 			break;
 		case CUCKOO:
-			table->table = new_cuckoo_hash_table(size);
+			table->table = new_cuckoo_dary_hash_map(size, valuesize, ways);
 			break;
 		case XTNDBLN:
-			table->table = new_xtndbln_hash_table(size);
+			table->table = new_xtndbln_hash_map(size, valuesize);
 			break;
 		case XUCKOO:
-			table->table = new_xuckoo_hash_table();
+			table->table = new_xuckoo_dary_hash_map(1, valuesize, ways);
 			break;
         case XUCKOON:
-            table->table = new_xuckoo_hash_table_with_bucketsize(size);
+            table->table = new_xuckoo_dary_hash_map(size, valuesize, ways);
             break;
+		case LINEAR32:
+		case CUCKOO32:
+		case XTNDBLN32:
+			// 32-bit keys only: sets only
+			if (valuesize) {
+				free(table);
+				return NULL;
+			}
+			if (type == LINEAR32) {
+				table->table = new_linear32_hash_table(size);
+			} else if (type == CUCKOO32) {
+				table->table = new_cuckoo32_hash_table(size);
+			} else {
+				table->table = new_xtndbln32_hash_table();
+			}
+			break;
+		case CUCKOOFILTER:
+		case QUOTIENTFILTER:
+			// fingerprints only: sets only
+			if (valuesize) {
+				free(table);
+				return NULL;
+			}
+			if (type == CUCKOOFILTER) {
+				table->table = new_cuckoo_filter(size);
+			} else {
+				table->table = new_quotient_filter(size);
+			}
+			break;
+		case HOPSCOTCH:
+			table->table = new_hopscotch_hash_map(size, valuesize);
+			break;
+		case LINHASH:
+			table->table = new_linhash_hash_map(size, valuesize);
+			break;
 		default:
 			// no such table type? error. release memory and return NULL
 			free(table);
 			return NULL;
 	}
 
+	// the table itself may refuse, e.g. too many ways
+	if (!table->table) {
+		free(table);
+		return NULL;
+	}
+
 	return table;
 }
 
+// map the snapshot saved at 'path' (by hash_table_save) as a read only table,
+// and return its pointer
+HashTable *hash_table_open_mmap(const char *path) {
+	Snapshot *snapshot = open_snapshot(path);
+	if (!snapshot) {
+		return NULL;
+	}
+
+	HashTable *table = malloc(sizeof *table);
+	assert(table);
+	table->type = snapshot_type(snapshot);
+	table->table = NULL;
+	table->snapshot = snapshot;
+	table->valuesize = 0;
+	table->filter = NULL;
+	return table;
+}
+
+// write 'table' to a snapshot file at 'path'
+bool hash_table_save(HashTable *table, const char *path) {
+	assert(table != NULL);
+
+	// a mapped table is already a snapshot, and snapshots hold no values
+	if (table->snapshot || table->valuesize) {
+		return false;
+	}
+
+	// snapshots hold int64 keys, laid out as the int64 tables lay them out
+	// (and filters hold no keys at all). hopscotch keys may sit past a free
+	// slot, and linhash chains hold more than a bucket, so neither fits
+	if (table->type == LINEAR32 || table->type == CUCKOO32
+			|| table->type == XTNDBLN32 || table->type == CUCKOOFILTER
+			|| table->type == QUOTIENTFILTER || table->type == HOPSCOTCH
+			|| table->type == LINHASH) {
+		return false;
+	}
+
+	SnapshotWriter *writer = new_snapshot_writer(path, table->type);
+	if (!writer) {
+		return false;
+	}
+
+	// each type knows how its keys are laid out
+	switch (table->type) {
+		case LINEAR:
+			linear_hash_table_save(table->table, writer);
+			break;
+		case XTNDBL1:
+			xtndbl1_hash_table_save(table->table, writer);
+			break;
+		case CUCKOO:
+			cuckoo_hash_table_save(table->table, writer);
+			break;
+		case XTNDBLN:
+			xtndbln_hash_table_save(table->table, writer);
+			break;
+		case XUCKOO:
+		case XUCKOON:
+			xuckoo_hash_table_save(table->table, writer);
+			break;
+		default:
+			break;
+	}
+	return finish_snapshot_writer(writer);
+}
+
 // free all memory associated with 'table'
 void free_hash_table(HashTable *table) {
 	assert(table != NULL);
 
+	// a mapped table is only unmapped
+	if (table->snapshot) {
+		close_snapshot(table->snapshot);
+		free(table);
+		return;
+	}
+
+	if (table->filter) {
+		free_filter(table->filter);
+	}
+
 	// free the actual table, using the relevant free function for its type
 	switch (table->type) {
 		case LINEAR:
@@ -130,6 +342,27 @@ void free_hash_table(HashTable *table) {
         case XUCKOON:
             free_xuckoo_hash_table(table->table);
             break;
+		case LINEAR32:
+			free_linear32_hash_table(table->table);
+			break;
+		case CUCKOO32:
+			free_cuckoo32_hash_table(table->table);
+			break;
+		case XTNDBLN32:
+			free_xtndbln32_hash_table(table->table);
+			break;
+		case CUCKOOFILTER:
+			free_cuckoo_filter(table->table);
+			break;
+		case QUOTIENTFILTER:
+			free_quotient_filter(table->table);
+			break;
+		case HOPSCOTCH:
+			free_hopscotch_hash_table(table->table);
+			break;
+		case LINHASH:
+			free_linhash_hash_table(table->table);
+			break;
 		default:
 			break;
 	}
@@ -138,11 +371,15 @@ void free_hash_table(HashTable *table) {
 	free(table);
 }
 
-// insert 'key' into 'table', if it's not in there already
-// returns true if insertion succeeds, false if it was already in there
-bool hash_table_insert(HashTable *table, int64 key) {
+// insert 'key' into 'table' itself, leaving its filter alone
+static bool insert(HashTable *table, int64 key) {
 	assert(table != NULL);
 
+	// mapped tables are read only
+	if (table->snapshot) {
+		return false;
+	}
+
 	// forward the call onto the relevant insert function
 	switch (table->type) {
 		case LINEAR:
@@ -157,16 +394,60 @@ bool hash_table_insert(HashTable *table, int64 key) {
 			return xuckoo_hash_table_insert(table->table, key);
         case XUCKOON:
             return xuckoo_hash_table_insert(table->table, key);
+		case LINEAR32:
+			return linear32_hash_table_insert(table->table, key);
+		case CUCKOO32:
+			return cuckoo32_hash_table_insert(table->table, key);
+		case XTNDBLN32:
+			return xtndbln32_hash_table_insert(table->table, key);
+		case CUCKOOFILTER:
+			return cuckoo_filter_insert(table->table, key);
+		case QUOTIENTFILTER:
+			return quotient_filter_insert(table->table, key);
+		case HOPSCOTCH:
+			return hopscotch_hash_table_insert(table->table, key);
+		case LINHASH:
+			return linhash_hash_table_insert(table->table, key);
 		default:
 			return false;
 	}
 }
 
+// keep the filter of 'table' (if any) in step with an insert of 'key' that
+// returned 'inserted'. a cuckoo or xuckoo table that cannot grow returns false
+// having stored 'key' and dropped another key instead, so a key the filter
+// does not report yet is added even then: a duplicate is in the filter
+// already (and adding it again would use up the layer's room), and a key the
+// table does not hold costs only a false positive
+static void filter_inserted(HashTable *table, int64 key, bool inserted) {
+	if (table->filter
+			&& (inserted || !filter_lookup(table->filter, key))) {
+		filter_add(table->filter, key);
+	}
+}
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool hash_table_insert(HashTable *table, int64 key) {
+	bool inserted = insert(table, key);
+	filter_inserted(table, key, inserted);
+	return inserted;
+}
+
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool hash_table_lookup(HashTable *table, int64 key) {
 	assert(table != NULL);
 
+	// a key the filter has never seen is not in the table
+	if (table->filter && !filter_lookup(table->filter, key)) {
+		return false;
+	}
+
+	if (table->snapshot) {
+		return snapshot_lookup(table->snapshot, key);
+	}
+
 	// forward the call onto the relevant lookup function
 	switch (table->type) {
 		case LINEAR:
@@ -181,15 +462,427 @@ bool hash_table_lookup(HashTable *table, int64 key) {
 			return xuckoo_hash_table_lookup(table->table, key);
         case XUCKOON:
             return xuckoo_hash_table_lookup(table->table, key);
+		case LINEAR32:
+			return linear32_hash_table_lookup(table->table, key);
+		case CUCKOO32:
+			return cuckoo32_hash_table_lookup(table->table, key);
+		case XTNDBLN32:
+			return xtndbln32_hash_table_lookup(table->table, key);
+		case CUCKOOFILTER:
+			return cuckoo_filter_lookup(table->table, key);
+		case QUOTIENTFILTER:
+			return quotient_filter_lookup(table->table, key);
+		case HOPSCOTCH:
+			return hopscotch_hash_table_lookup(table->table, key);
+		case LINHASH:
+			return linhash_hash_table_lookup(table->table, key);
+		default:
+			return false;
+	}
+}
+
+// insert 'key' with 'value' into 'table' itself, overwriting the value of a
+// key already in there only if 'replace'
+static bool put_value(HashTable *table, int64 key, const void *value,
+		bool replace) {
+	assert(table != NULL);
+
+	// mapped tables are read only
+	if (table->snapshot) {
+		return false;
+	}
+
+	// forward the call onto the relevant put function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_put(table->table, key, value, replace);
+		case XTNDBL1:
+			return xtndbl1_hash_table_insert(table->table, key);
+		case CUCKOO:
+			return cuckoo_hash_table_put(table->table, key, value, replace);
+		case XTNDBLN:
+			return xtndbln_hash_table_put(table->table, key, value, replace);
+		case XUCKOO:
+		case XUCKOON:
+			return xuckoo_hash_table_put(table->table, key, value, replace);
+		case LINEAR32:
+			return linear32_hash_table_insert(table->table, key);
+		case CUCKOO32:
+			return cuckoo32_hash_table_insert(table->table, key);
+		case XTNDBLN32:
+			return xtndbln32_hash_table_insert(table->table, key);
+		case CUCKOOFILTER:
+			return cuckoo_filter_insert(table->table, key);
+		case QUOTIENTFILTER:
+			return quotient_filter_insert(table->table, key);
+		case HOPSCOTCH:
+			return hopscotch_hash_table_put(table->table, key, value,
+				replace);
+		case LINHASH:
+			return linhash_hash_table_put(table->table, key, value, replace);
+		default:
+			return false;
+	}
+}
+
+// insert 'key' with 'value' into 'table', and its filter if it is new
+static bool put(HashTable *table, int64 key, const void *value,
+		bool replace) {
+	bool inserted = put_value(table, key, value, replace);
+	filter_inserted(table, key, inserted);
+	return inserted;
+}
+
+// insert 'key' with 'value', if 'key' is not in there already
+bool hash_table_put(HashTable *table, int64 key, const void *value) {
+	return put(table, key, value, false);
+}
+
+// insert 'key' with 'value', or overwrite the value 'key' already has
+bool hash_table_upsert(HashTable *table, int64 key, const void *value) {
+	return put(table, key, value, true);
+}
+
+// lookup 'key' in 'table', copying its value into 'value'
+bool hash_table_get(HashTable *table, int64 key, void *value) {
+	assert(table != NULL);
+
+	if (table->filter && !filter_lookup(table->filter, key)) {
+		return false;
+	}
+
+	// snapshots (and sets) hold keys only
+	if (table->snapshot) {
+		return snapshot_lookup(table->snapshot, key);
+	}
+
+	// forward the call onto the relevant get function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_get(table->table, key, value);
+		case XTNDBL1:
+			return xtndbl1_hash_table_lookup(table->table, key);
+		case CUCKOO:
+			return cuckoo_hash_table_get(table->table, key, value);
+		case XTNDBLN:
+			return xtndbln_hash_table_get(table->table, key, value);
+		case XUCKOO:
+		case XUCKOON:
+			return xuckoo_hash_table_get(table->table, key, value);
+		case LINEAR32:
+			return linear32_hash_table_lookup(table->table, key);
+		case CUCKOO32:
+			return cuckoo32_hash_table_lookup(table->table, key);
+		case XTNDBLN32:
+			return xtndbln32_hash_table_lookup(table->table, key);
+		case CUCKOOFILTER:
+			return cuckoo_filter_lookup(table->table, key);
+		case QUOTIENTFILTER:
+			return quotient_filter_lookup(table->table, key);
+		case HOPSCOTCH:
+			return hopscotch_hash_table_get(table->table, key, value);
+		case LINHASH:
+			return linhash_hash_table_get(table->table, key, value);
+		default:
+			return false;
+	}
+}
+
+// bytes of value stored with each key
+int hash_table_value_size(HashTable *table) {
+	assert(table != NULL);
+	return table->valuesize;
+}
+
+// keep a filter of false positive rate 'fprate' in front of empty 'table'
+bool hash_table_add_filter(HashTable *table, double fprate) {
+	assert(table != NULL);
+
+	// the filter must see every key, so it cannot come after any
+	HashTableStats stats;
+	hash_table_get_stats(table, &stats);
+	if (table->snapshot || table->filter || stats.nkeys != 0) {
+		return false;
+	}
+	table->filter = new_filter(fprate, FILTER_MIN_KEYS);
+	return table->filter != NULL;
+}
+
+// grow 'table' up front to hold 'nkeys' keys in total
+// returns false if the table would grow too large
+bool hash_table_reserve(HashTable *table, size_t nkeys) {
+	assert(table != NULL);
+
+	// mapped tables cannot grow
+	if (table->snapshot) {
+		return false;
+	}
+
+	if (table->filter) {
+		filter_reserve(table->filter, nkeys);
+	}
+
+	// forward the call onto the relevant reserve function
+	switch (table->type) {
+		case LINEAR:
+			return linear_hash_table_reserve(table->table, nkeys);
+		case XTNDBL1:
+			return xtndbl1_hash_table_reserve(table->table, nkeys);
+		case CUCKOO:
+			return cuckoo_hash_table_reserve(table->table, nkeys);
+		case XTNDBLN:
+			return xtndbln_hash_table_reserve(table->table, nkeys);
+		case XUCKOO:
+		case XUCKOON:
+			return xuckoo_hash_table_reserve(table->table, nkeys);
+		case LINEAR32:
+			return linear32_hash_table_reserve(table->table, nkeys);
+		case CUCKOO32:
+			return cuckoo32_hash_table_reserve(table->table, nkeys);
+		case XTNDBLN32:
+			return xtndbln32_hash_table_reserve(table->table, nkeys);
+		case CUCKOOFILTER:
+			return cuckoo_filter_reserve(table->table, nkeys);
+		case QUOTIENTFILTER:
+			return quotient_filter_reserve(table->table, nkeys);
+		case HOPSCOTCH:
+			return hopscotch_hash_table_reserve(table->table, nkeys);
+		case LINHASH:
+			return linhash_hash_table_reserve(table->table, nkeys);
+		default:
+			return false;
+	}
+}
+
+// back the large arrays of 'table' as 'policy' asks
+// returns false if this type of table does not support it
+bool hash_table_set_pages(HashTable *table, PagePolicy policy) {
+	assert(table != NULL);
+
+	// a mapped table's arrays are the snapshot file's pages
+	if (table->snapshot) {
+		return false;
+	}
+
+	switch (table->type) {
+		case LINEAR:
+			linear_hash_table_set_pages(table->table, policy);
+			return true;
+		case CUCKOO:
+			cuckoo_hash_table_set_pages(table->table, policy);
+			return true;
+		case XTNDBLN:
+			xtndbln_hash_table_set_pages(table->table, policy);
+			return true;
+		case XUCKOO:
+		case XUCKOON:
+			xuckoo_hash_table_set_pages(table->table, policy);
+			return true;
 		default:
 			return false;
 	}
 }
 
+// insert each of the 'n' keys in 'keys' into 'table', in order, storing
+// whether each insertion succeeded in 'results'
+// the type is only switched on once per batch, rather than once per key
+void hash_table_insert_batch(HashTable *table, const int64 *keys, int n,
+		bool *results) {
+	assert(table != NULL);
+	int i;
+
+	// mapped tables are read only
+	if (table->snapshot) {
+		for (i = 0; i < n; i++) {
+			results[i] = false;
+		}
+		return;
+	}
+
+	switch (table->type) {
+		case LINEAR:
+			for (i = 0; i < n; i++) {
+				results[i] = linear_hash_table_insert(table->table, keys[i]);
+			}
+			break;
+		case XTNDBL1:
+			for (i = 0; i < n; i++) {
+				results[i] = xtndbl1_hash_table_insert(table->table, keys[i]);
+			}
+			break;
+		case CUCKOO:
+			for (i = 0; i < n; i++) {
+				results[i] = cuckoo_hash_table_insert(table->table, keys[i]);
+			}
+			break;
+		case XTNDBLN:
+			for (i = 0; i < n; i++) {
+				results[i] = xtndbln_hash_table_insert(table->table, keys[i]);
+			}
+			break;
+		case XUCKOO:
+		case XUCKOON:
+			for (i = 0; i < n; i++) {
+				results[i] = xuckoo_hash_table_insert(table->table, keys[i]);
+			}
+			break;
+		case LINEAR32:
+			for (i = 0; i < n; i++) {
+				results[i] = linear32_hash_table_insert(table->table, keys[i]);
+			}
+			break;
+		case CUCKOO32:
+			for (i = 0; i < n; i++) {
+				results[i] = cuckoo32_hash_table_insert(table->table, keys[i]);
+			}
+			break;
+		case XTNDBLN32:
+			for (i = 0; i < n; i++) {
+				results[i] = xtndbln32_hash_table_insert(table->table, keys[i]);
+			}
+			break;
+		case CUCKOOFILTER:
+			for (i = 0; i < n; i++) {
+				results[i] = cuckoo_filter_insert(table->table, keys[i]);
+			}
+			break;
+		case QUOTIENTFILTER:
+			for (i = 0; i < n; i++) {
+				results[i] = quotient_filter_insert(table->table, keys[i]);
+			}
+			break;
+		case HOPSCOTCH:
+			for (i = 0; i < n; i++) {
+				results[i] = hopscotch_hash_table_insert(table->table, keys[i]);
+			}
+			break;
+		case LINHASH:
+			for (i = 0; i < n; i++) {
+				results[i] = linhash_hash_table_insert(table->table, keys[i]);
+			}
+			break;
+		default:
+			for (i = 0; i < n; i++) {
+				results[i] = false;
+			}
+			break;
+	}
+
+	for (i = 0; table->filter && i < n; i++) {
+		filter_inserted(table, keys[i], results[i]);
+	}
+}
+
+// lookup each of the 'n' keys in 'keys', storing whether each was found
+// in 'results'
+void hash_table_lookup_batch(HashTable *table, const int64 *keys, int n,
+		bool *results) {
+	assert(table != NULL);
+	int i;
+
+	if (table->snapshot) {
+		for (i = 0; i < n; i++) {
+			results[i] = snapshot_lookup(table->snapshot, keys[i]);
+		}
+		return;
+	}
+
+	// only probe the table for the keys the filter lets through
+	for (i = 0; i < n; i++) {
+		results[i] = !table->filter || filter_lookup(table->filter, keys[i]);
+	}
+
+	switch (table->type) {
+		case LINEAR:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& linear_hash_table_lookup(table->table, keys[i]);
+			}
+			break;
+		case XTNDBL1:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& xtndbl1_hash_table_lookup(table->table, keys[i]);
+			}
+			break;
+		case CUCKOO:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& cuckoo_hash_table_lookup(table->table, keys[i]);
+			}
+			break;
+		case XTNDBLN:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& xtndbln_hash_table_lookup(table->table, keys[i]);
+			}
+			break;
+		case XUCKOO:
+		case XUCKOON:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& xuckoo_hash_table_lookup(table->table, keys[i]);
+			}
+			break;
+		case LINEAR32:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& linear32_hash_table_lookup(table->table, keys[i]);
+			}
+			break;
+		case CUCKOO32:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& cuckoo32_hash_table_lookup(table->table, keys[i]);
+			}
+			break;
+		case XTNDBLN32:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& xtndbln32_hash_table_lookup(table->table, keys[i]);
+			}
+			break;
+		case CUCKOOFILTER:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& cuckoo_filter_lookup(table->table, keys[i]);
+			}
+			break;
+		case QUOTIENTFILTER:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& quotient_filter_lookup(table->table, keys[i]);
+			}
+			break;
+		case HOPSCOTCH:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& hopscotch_hash_table_lookup(table->table, keys[i]);
+			}
+			break;
+		case LINHASH:
+			for (i = 0; i < n; i++) {
+				results[i] = results[i]
+					&& linhash_hash_table_lookup(table->table, keys[i]);
+			}
+			break;
+		default:
+			for (i = 0; i < n; i++) {
+				results[i] = false;
+			}
+			break;
+	}
+}
+
 // print the contents of 'table' to stdout
 void hash_table_print(HashTable *table) {
 	assert(table != NULL);
 
+	if (table->snapshot) {
+		snapshot_print(table->snapshot);
+		return;
+	}
+
 	// call the relevant print function
 	switch (table->type) {
 		case LINEAR:
@@ -210,88 +903,210 @@ void hash_table_print(HashTable *table) {
         case XUCKOON:
             xuckoo_hash_table_print(table->table);
             break;
+		case LINEAR32:
+			linear32_hash_table_print(table->table);
+			break;
+		case CUCKOO32:
+			cuckoo32_hash_table_print(table->table);
+			break;
+		case XTNDBLN32:
+			xtndbln32_hash_table_print(table->table);
+			break;
+		case CUCKOOFILTER:
+			cuckoo_filter_print(table->table);
+			break;
+		case QUOTIENTFILTER:
+			quotient_filter_print(table->table);
+			break;
+		case HOPSCOTCH:
+			hopscotch_hash_table_print(table->table);
+			break;
+		case LINHASH:
+			linhash_hash_table_print(table->table);
+			break;
 		default:
 			break;
 	}
 }
 
-// print some statistics about 'table' to stdout
-void hash_table_stats(HashTable *table) {
+// fill 'stats' with the statistics 'table' tracks, leaving the rest UNTRACKED
+void hash_table_get_stats(HashTable *table, HashTableStats *stats) {
 	assert(table != NULL);
 
-	// call the relevant print stats function
+	init_hash_table_stats(stats);
+	stats->type = typetostr(table->type);
+
+	if (table->snapshot) {
+		snapshot_get_stats(table->snapshot, stats);
+		finish_hash_table_stats(stats);
+		return;
+	}
+
+	// call the relevant get stats function
 	switch (table->type) {
 		case LINEAR:
-			linear_hash_table_stats(table->table);
+			linear_hash_table_get_stats(table->table, stats);
 			break;
 		case XTNDBL1:
-			xtndbl1_hash_table_stats(table->table);
+			xtndbl1_hash_table_get_stats(table->table, stats);
 			break;
 		case CUCKOO:
-			cuckoo_hash_table_stats(table->table);
+			cuckoo_hash_table_get_stats(table->table, stats);
 			break;
 		case XTNDBLN:
-			xtndbln_hash_table_stats(table->table);
+			xtndbln_hash_table_get_stats(table->table, stats);
 			break;
 		case XUCKOO:
-			xuckoo_hash_table_stats(table->table);
+		case XUCKOON:
+			xuckoo_hash_table_get_stats(table->table, stats);
+			break;
+		case LINEAR32:
+			linear32_hash_table_get_stats(table->table, stats);
+			break;
+		case CUCKOO32:
+			cuckoo32_hash_table_get_stats(table->table, stats);
+			break;
+		case XTNDBLN32:
+			xtndbln32_hash_table_get_stats(table->table, stats);
+			break;
+		case CUCKOOFILTER:
+			cuckoo_filter_get_stats(table->table, stats);
+			break;
+		case QUOTIENTFILTER:
+			quotient_filter_get_stats(table->table, stats);
+			break;
+		case HOPSCOTCH:
+			hopscotch_hash_table_get_stats(table->table, stats);
+			break;
+		case LINHASH:
+			linhash_hash_table_get_stats(table->table, stats);
 			break;
-        case XUCKOON:
-            xuckoo_hash_table_stats(table->table);
-            break;
 		default:
 			break;
 	}
+
+	// the filter's memory is held for the table
+	if (table->filter) {
+		Memory memory;
+		filter_memory(table->filter, &memory);
+		stats->filtered = filter_rejected(table->filter);
+		if (stats->memory != UNTRACKED) {
+			stats->memory += memory.bytes;
+			stats->peak_memory += memory.peak;
+		}
+	}
+
+	finish_hash_table_stats(stats);
 }
 
-// print some statistics about 'table' to stdout in csv format
-void hash_table_csv_stats(HashTable *table) {
+// print some statistics about 'table' to stdout
+void hash_table_stats(HashTable *table) {
 	assert(table != NULL);
 
-	// call the relevant print stats function
+	// the provided tables keep their own format, the rest use the common one
+	HashTableStats stats;
+	if (table->snapshot) {
+		hash_table_get_stats(table, &stats);
+		fprint_stats_text(stdout, &stats);
+		return;
+	}
 	switch (table->type) {
-        case LINEAR:
-			linear_hash_table_csv_stats(table->table);
+		case LINEAR:
+			linear_hash_table_stats(table->table);
 			break;
-        case XTNDBLN:
-			xtndbln_hash_table_csv_stats(table->table);
-            break;
-        case XUCKOO:
-            xuckoo_hash_table_csv_stats(table->table);
-            break;
-        case XUCKOON:
-            xuckoo_hash_table_csv_stats(table->table);
-            break;
-        case CUCKOO:
-            cuckoo_hash_table_csv_stats(table->table);
-            break;
-        default:
+		case XTNDBL1:
+			xtndbl1_hash_table_stats(table->table);
+			break;
+		default:
+			hash_table_get_stats(table, &stats);
+			fprint_stats_text(stdout, &stats);
 			break;
 	}
 }
 
+// print some statistics about 'table' to stdout in csv format
+void hash_table_csv_stats(HashTable *table) {
+	HashTableStats stats;
+	hash_table_get_stats(table, &stats);
+	fprint_stats_csv(stdout, &stats);
+}
+
 // print csv header for table statistics in csv format
 void hash_table_csv_stats_header(HashTable *table) {
 	assert(table != NULL);
+	fprint_stats_csv_header(stdout);
+}
 
-	// call the relevant print stats function
+// print the histograms of hash_table_get_stats to stdout as csv, one row per
+// non-empty bin
+void hash_table_csv_histograms(HashTable *table) {
+	HashTableStats stats;
+	hash_table_get_stats(table, &stats);
+	fprint_histograms_csv_header(stdout);
+	fprint_histograms_csv(stdout, &stats);
+}
+
+// print some statistics about 'table' to stdout as a json object
+void hash_table_json_stats(HashTable *table) {
+	HashTableStats stats;
+	hash_table_get_stats(table, &stats);
+	fprint_stats_json(stdout, &stats);
+}
+
+// copy the memory currently and at most held by 'table' into 'memory'
+void hash_table_memory(HashTable *table, Memory *memory) {
+	assert(table != NULL);
+
+	// a mapped table holds no heap memory of its own (the page cache holds it)
+	memory_init(memory);
+	if (table->snapshot) {
+		return;
+	}
 	switch (table->type) {
-        case LINEAR:
-			linear_hash_table_csv_stats_header(table->table);
+		case LINEAR:
+			linear_hash_table_memory(table->table, memory);
 			break;
-        case XTNDBLN:
-			xtndbln_hash_table_csv_stats_header(table->table);
-            break;
-        case XUCKOO:
-            xuckoo_hash_table_csv_stats_header(table->table);
-            break;
-        case XUCKOON:
-            xuckoo_hash_table_csv_stats_header(table->table);
-            break;
-        case CUCKOO:
-            cuckoo_hash_table_csv_stats_header(table->table);
-            break;
-        default:
+		case XTNDBL1:
+			xtndbl1_hash_table_memory(table->table, memory);
+			break;
+		case CUCKOO:
+			cuckoo_hash_table_memory(table->table, memory);
+			break;
+		case XTNDBLN:
+			xtndbln_hash_table_memory(table->table, memory);
+			break;
+		case XUCKOO:
+		case XUCKOON:
+			xuckoo_hash_table_memory(table->table, memory);
+			break;
+		case LINEAR32:
+			linear32_hash_table_memory(table->table, memory);
+			break;
+		case CUCKOO32:
+			cuckoo32_hash_table_memory(table->table, memory);
 			break;
+		case XTNDBLN32:
+			xtndbln32_hash_table_memory(table->table, memory);
+			break;
+		case CUCKOOFILTER:
+			cuckoo_filter_memory(table->table, memory);
+			break;
+		case QUOTIENTFILTER:
+			quotient_filter_memory(table->table, memory);
+			break;
+		case HOPSCOTCH:
+			hopscotch_hash_table_memory(table->table, memory);
+			break;
+		case LINHASH:
+			linhash_hash_table_memory(table->table, memory);
+			break;
+		default:
+			break;
+	}
+
+	if (table->filter) {
+		Memory filter;
+		filter_memory(table->filter, &filter);
+		memory_add(memory, &filter);
 	}
 }
@@ -21,11 +21,15 @@
 
 #include <stdbool.h>
 #include "inthash.h"
+#include "memacct.h"
+#include "tblstats.h"
 
 // enumerated type containing constants for the various types of hash table
 // supported
 typedef enum type {
-	NOTYPE = -1, LINEAR, XTNDBL1, CUCKOO, XTNDBLN, XUCKOO, XUCKOON
+	NOTYPE = -1, LINEAR, XTNDBL1, CUCKOO, XTNDBLN, XUCKOO, XUCKOON,
+	LINEAR32, CUCKOO32, XTNDBLN32, CUCKOOFILTER, QUOTIENTFILTER,
+	HOPSCOTCH, LINHASH
 } TableType;
 
 // converts from a string representation to a TableType constant:
@@ -35,14 +39,52 @@ typedef enum type {
 // "2" or "xtndbln"	->	XTNDBLN
 // "3" or "xuckoo"	->	XUCKOO
 // "xuckoon"        ->  XUCKOON
+// "linear32"		->	LINEAR32	(linear, cuckoo and xtndbln holding 32-bit
+// "cuckoo32"		->	CUCKOO32	keys, see tables/narrow.h. keys that do not
+// "xtndbln32"		->	XTNDBLN32	fit are never inserted, nor found)
+// "cuckoofilter"	->	CUCKOOFILTER	(fingerprints, see tables/amq.h:
+// "quotientfilter"	->	QUOTIENTFILTER	absent keys are sometimes found)
+// "hopscotch"		->	HOPSCOTCH
+// "linhash"		->	LINHASH	(linear hashing, see tables/xtndbln.h)
 TableType strtotype(char *str);
 
+// converts from a TableType constant to its name, as accepted by strtotype
+const char *typetostr(TableType type);
+
 typedef struct table HashTable;
 
 // initialise a hash table of type 'type' with initial size 'size',
-// and return its pointer
+// and return its pointer. xtndbln32 tables ignore 'size', always holding
+// XTNDBLN32_BUCKETSIZE keys per bucket. for the filters 'size' is the
+// buckets (cuckoofilter) or slots (quotientfilter) of the first layer
 HashTable *new_hash_table(TableType type, int size);
 
+// initialise a hash table of type 'type' with initial size 'size' that maps
+// each key to a value of 'valuesize' bytes (copied in and out by put, upsert
+// and get), and return its pointer. with 'valuesize' 0 this is new_hash_table.
+// returns NULL for xtndbl1, the 32-bit key tables and the filters, which
+// only hold keys
+HashTable *new_hash_map(TableType type, int size, int valuesize);
+
+// as new_hash_map, but a key of a cuckoo, xuckoo or xuckoon table may be in
+// any of 'ways' inner tables (2 to 4, d-ary cuckoo hashing) instead of two.
+// more ways fill the table further before it grows, but each lookup checks
+// more slots. returns NULL if 'ways' is out of range, or not 2 for the other
+// types
+HashTable *new_hash_map_ways(TableType type, int size, int valuesize,
+	int ways);
+
+// map a snapshot saved by hash_table_save as a read only table, without
+// rebuilding it. lookups work as on the saved table, inserts and reserves
+// fail. returns NULL if 'path' is not a valid snapshot
+HashTable *hash_table_open_mmap(const char *path);
+
+// save 'table' to a snapshot file at 'path' (see snapshot.h), which can be
+// mapped by hash_table_open_mmap. returns false if it could not be written,
+// or 'table' holds values, 32-bit keys or fingerprints (snapshots hold int64
+// keys only)
+bool hash_table_save(HashTable *table, const char *path);
+
 // free all memory associated with 'table'
 void free_hash_table(HashTable *table);
 
@@ -54,13 +96,75 @@ bool hash_table_insert(HashTable *table, int64 key);
 // returns true if found, false if not
 bool hash_table_lookup(HashTable *table, int64 key);
 
+// insert 'key' with 'value' (zeros if NULL) into 'table', if 'key' is not in
+// there already. returns true if inserted, false if it was already in there
+bool hash_table_put(HashTable *table, int64 key, const void *value);
+
+// as hash_table_put, but if 'key' is already in 'table' its value is
+// overwritten with 'value' (zeros if NULL). returns true if 'key' was new
+bool hash_table_upsert(HashTable *table, int64 key, const void *value);
+
+// lookup 'key' in 'table', copying its value into 'value' (unless NULL)
+// returns true if found, false if not
+bool hash_table_get(HashTable *table, int64 key, void *value);
+
+// the number of bytes of value 'table' stores with each key (0 for sets)
+int hash_table_value_size(HashTable *table);
+
+// keep a bloom filter (see filter.h) with a false positive rate of 'fprate'
+// in front of 'table', added to by every insert, and checked by every lookup
+// before the table is probed, so most lookups of absent keys do not probe
+// it. only an empty table can be given a filter (it cannot learn the keys
+// already inserted): returns false if 'table' is not empty, is mapped, or
+// 'fprate' is not between 0 and 1
+bool hash_table_add_filter(HashTable *table, double fprate);
+
+// grow 'table' up front to hold 'nkeys' keys in total, so that inserting them
+// does not have to double, upsize or split it step by step. the table is
+// never shrunk (its filter, if any, is grown too). returns false if the
+// table would grow too large
+bool hash_table_reserve(HashTable *table, size_t nkeys);
+
+// back the large arrays of 'table' (slots of linear and cuckoo tables, the
+// directories of extendible and xuckoo tables) as 'policy' asks, moving them
+// now and keeping to it as they grow. huge pages cut TLB misses on random
+// probes once a table is hundreds of MB. returns false for other types and
+// mapped tables
+bool hash_table_set_pages(HashTable *table, PagePolicy policy);
+
+// insert each of the 'n' keys in 'keys' into 'table', in order, storing
+// whether each insertion succeeded in 'results' (as hash_table_insert would)
+void hash_table_insert_batch(HashTable *table, const int64 *keys, int n,
+	bool *results);
+
+// lookup each of the 'n' keys in 'keys', storing whether each was found
+// in 'results' (as hash_table_lookup would)
+void hash_table_lookup_batch(HashTable *table, const int64 *keys, int n,
+	bool *results);
+
 // print the contents of 'table' to stdout
 void hash_table_print(HashTable *table);
 
+// fill 'stats' with the statistics 'table' tracks (see tblstats.h), leaving
+// the rest UNTRACKED. the same fields are filled for every table type
+void hash_table_get_stats(HashTable *table, HashTableStats *stats);
+
 // print some statistics about 'table' to stdout
 void hash_table_stats(HashTable *table);
 
+// print the statistics of hash_table_get_stats as a csv row / header / a
+// single line json object, to stdout
 void hash_table_csv_stats(HashTable *table);
 
 void hash_table_csv_stats_header(HashTable *table);
+
+void hash_table_json_stats(HashTable *table);
+
+// print the histograms of hash_table_get_stats (probe lengths, kick chains,
+// splits, ...) to stdout as csv, with a header
+void hash_table_csv_histograms(HashTable *table);
+
+// copy the heap memory currently and at most held by 'table' (allocator
+// overhead included) into 'memory'
+void hash_table_memory(HashTable *table, Memory *memory);
 #endif
@@ -0,0 +1,78 @@
+/* * * * * * * * *
+ * Module for counting how often each value of some per-operation quantity
+ * (probe length, kicks, splits, ...) occurs, so that the shape of its
+ * distribution, not just its mean, can be reported
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#include <assert.h>
+
+#include "histogram.h"
+
+// which bin of 'histogram' holds 'value'
+static int bin_of(const Histogram *histogram, long value) {
+	int bin;
+	if (histogram->width != HIST_LOG2) {
+		long i = value / histogram->width;
+		bin = (i < HIST_BINS) ? (int)i : HIST_BINS - 1;
+	} else {
+		// one more than the position of the highest set bit
+		for (bin = 0; value && bin < HIST_BINS - 1; bin++) {
+			value >>= 1;
+		}
+	}
+	return bin;
+}
+
+void init_histogram(Histogram *histogram, const char *name, int width) {
+	int i;
+	histogram->name = name;
+	histogram->width = width;
+	for (i = 0; i < HIST_BINS; i++) {
+		histogram->bins[i] = 0;
+	}
+	histogram->n = 0;
+	histogram->max = 0;
+	histogram->sum = 0;
+}
+
+void histogram_add(Histogram *histogram, long value) {
+	if (value < 0) {
+		value = 0;
+	}
+	histogram->bins[bin_of(histogram, value)]++;
+	histogram->n++;
+	histogram->sum += value;
+	if (value > histogram->max) {
+		histogram->max = value;
+	}
+}
+
+void histogram_merge(Histogram *into, const Histogram *from) {
+	assert(into->width == from->width);
+	int i;
+	for (i = 0; i < HIST_BINS; i++) {
+		into->bins[i] += from->bins[i];
+	}
+	into->n += from->n;
+	into->sum += from->sum;
+	if (from->max > into->max) {
+		into->max = from->max;
+	}
+}
+
+bool histogram_bin_range(const Histogram *histogram, int bin, long *low,
+		long *high) {
+	if (histogram->width != HIST_LOG2) {
+		*low = (long)bin * histogram->width;
+		*high = *low + histogram->width - 1;
+	} else {
+		*low = bin ? 1L << (bin - 1) : 0;
+		*high = bin ? (1L << bin) - 1 : 0;
+	}
+	return bin < HIST_BINS - 1;
+}
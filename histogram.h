@@ -0,0 +1,50 @@
+/* * * * * * * * *
+ * Module for counting how often each value of some per-operation quantity
+ * (probe length, kicks, splits, ...) occurs, so that the shape of its
+ * distribution, not just its mean, can be reported
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * Values are non-negative and counted in HIST_BINS bins. With a bin width of
+ * w > 0 bin i holds [i*w, (i+1)*w). With width 0 bins are powers of two: bin 0
+ * holds 0 and bin i holds [2^(i-1), 2^i). Either way the last bin also holds
+ * every larger value.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdbool.h>
+
+#define HIST_BINS 32
+
+// bin width selecting power of two bins
+#define HIST_LOG2 0
+
+typedef struct histogram {
+	const char *name;		// what is being counted, eg. "insert probes"
+	int width;				// width of each bin, or HIST_LOG2
+	long bins[HIST_BINS];	// how many values fell in each bin
+	long n;					// how many values have been added
+	long max;				// largest value added
+	double sum;				// sum of all values added
+} Histogram;
+
+// start an empty histogram named 'name' with bins 'width' wide (or HIST_LOG2)
+void init_histogram(Histogram *histogram, const char *name, int width);
+
+// count one occurence of 'value' (negative values are counted as 0)
+void histogram_add(Histogram *histogram, long value);
+
+// add the counts of 'from' to 'into'. both must have the same bin width
+void histogram_merge(Histogram *into, const Histogram *from);
+
+// the smallest and largest value bin 'bin' holds. returns false if the bin is
+// open ended (the last bin), in which case 'high' is not set
+bool histogram_bin_range(const Histogram *histogram, int bin, long *low,
+	long *high);
+
+#endif
@@ -8,6 +8,7 @@
  * as determined by #define constant p_i
  */
 
+#include <stddef.h>
 #include "inthash.h"
 
 // constants for first hash function
@@ -27,6 +28,14 @@
 // allocated memory.
 #define p2 2147483563
 
+// constants for third and fourth hash functions
+#define A3 790325621
+#define B3 862535295
+#define p3 2147483587
+#define A4 647644593
+#define B4 962135211
+#define p4 2147483579
+
 // first available hash function
 int h1(int64 k) {
 	return (A1 * k + B1) % p1;
@@ -36,3 +45,69 @@ int h1(int64 k) {
 int h2(int64 k) {
 	return (A2 * k + B2) % p2;
 }
+
+// third available hash function
+int h3(int64 k) {
+	return (A3 * k + B3) % p3;
+}
+
+// fourth available hash function
+int h4(int64 k) {
+	return (A4 * k + B4) % p4;
+}
+
+// hash function 'n', or NULL if there is none
+int (*hash_function(int n))(int64 k) {
+	switch (n) {
+		case 1: return h1;
+		case 2: return h2;
+		case 3: return h3;
+		case 4: return h4;
+		default: return NULL;
+	}
+}
+
+// the number of hash function 'hash', or 0 if it is none of them
+int hash_number(int (*hash)(int64 k)) {
+	int n;
+	for (n = 1; n <= NHASHES; n++) {
+		if (hash_function(n) == hash) {
+			return n;
+		}
+	}
+	return 0;
+}
+
+// the constants of each hash function, as (A, B, p)
+static const int64_t hash_constants[NHASHES][3] = {
+	{A1, B1, p1}, {A2, B2, p2}, {A3, B3, p3}, {A4, B4, p4}
+};
+
+bool hash_preimage(int n, int64 value, int64 *key) {
+	if (n < 1 || n > NHASHES) {
+		return false;
+	}
+	int64_t a = hash_constants[n - 1][0];
+	int64_t b = hash_constants[n - 1][1];
+	int64_t p = hash_constants[n - 1][2];
+	if (value >= (int64)p) {
+		return false;
+	}
+
+	// the inverse of A modulo p, by the extended euclidean algorithm
+	int64_t r = p, newr = a % p, s = 0, news = 1;
+	while (newr != 0) {
+		int64_t q = r / newr, t;
+		t = r - q * newr; r = newr; newr = t;
+		t = s - q * news; s = news; news = t;
+	}
+	if (r != 1) {
+		return false;
+	}
+	int64_t inverse = (s % p + p) % p;
+
+	// both factors are below p < 2^31, so the product fits
+	int64_t shifted = (((int64_t)value - b) % p + p) % p;
+	*key = (int64)(shifted * inverse % p);
+	return true;
+}
@@ -9,6 +9,7 @@
 #ifndef INTHASH_H
 #define INTHASH_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 // the maximum allowable table size; 2^27 = ~134 million entries
@@ -36,4 +37,22 @@ int h1(int64 k);
 // second available hash function
 int h2(int64 k);
 
+// third and fourth available hash functions, for tables with more than two
+int h3(int64 k);
+int h4(int64 k);
+
+// the number of hash functions above
+#define NHASHES 4
+
+// hash function 'n' (1 for h1, ..., NHASHES for h4), or NULL if there is none
+int (*hash_function(int n))(int64 k);
+
+// the number 'n' of hash function 'hash' as above, or 0 if it is none of them
+int hash_number(int (*hash)(int64 k));
+
+// find the one key below p that hash function 'n' maps to 'value', by
+// inverting A * key + B modulo p, and store it in 'key'
+// returns false if there is none ('value' is not below p)
+bool hash_preimage(int n, int64 value, int64 *key);
+
 #endif
@@ -22,19 +22,35 @@
 #include <stdbool.h>
 #include <string.h>
 #include <getopt.h>
+#include <pthread.h>
 
 #include "inthash.h"
 #include "hashtbl.h"
+#include "cmdstream.h"
+#include "cmdqueue.h"
+#include "output.h"
+#include "trace.h"
 
 
 // Need the silencer for bash code to work all proper goodly
-#define SILENT 0  // Silences insert and lookup operation
+#define SILENT 0  // Silences insert and lookup operation (default for -o)
 #define DEFAULT_SIZE 4
 
 // command line options
 typedef struct options {
 	TableType type;
 	int initial_size;
+	long reserve;	// keys to make room for before reading commands, or 0
+	bool binary;	// read commands in the binary stream format (cmdstream.h)
+	char *file;		// command file to memory-map, or NULL to read stdin
+	bool pipelined;	// parse commands on a separate thread
+	OutputMode output;	// how to report insert and lookup results
+	char *trace;	// file to dump resize / split events to, or NULL
+	char *snapshot;	// snapshot to map instead of building a table, or NULL
+	char *save;		// file to save a snapshot of the table to, or NULL
+	double filter;	// false positive rate of a filter before lookups, or 0
+	int ways;		// inner tables of a cuckoo type table (d-ary cuckoo)
+	PagePolicy pages;	// how to back the table's large arrays
 } Options;
 Options get_options(int argc, char** argv);
 
@@ -47,29 +63,122 @@ Options get_options(int argc, char** argv);
 #define STATS  's'
 #define STATS_HEAD 'n'
 #define STATS_ROW 'd'
+#define STATS_JSON 'j'
+#define HISTOGRAMS 'g'
+#define EVENTS 'e'
 #define HELP   'h'
 #define QUIT   'q'
 #define MAX_LINE_LEN 80
+
+// a function that reads the next command, see get_command()
+typedef int (*CommandReader)(char *operation, int64 *key);
 int get_command(char *operation, int64 *key);
+int get_stream_command(char *operation, int64 *key);
+
+// commands being read, when not reading text from stdin
+static CommandStream *command_input = NULL;
 
 
 // main program
 
-void run_interpreter(HashTable *table);
+bool execute_command(HashTable *table, char op, int argc, int64 key);
+void run_interpreter(HashTable *table, CommandReader get_command);
+void run_pipelined_interpreter(HashTable *table, CommandReader get_command);
 
 int main(int argc, char **argv) {
 	
 	// get command line options (to determine table type, size, etc.)
 	Options options = get_options(argc, argv);
 
-	// create hashtable (of given type)
-	HashTable *table = new_hash_table(options.type, options.initial_size);
+	// trace resizes and splits from the start, if asked to
+	if (options.trace && !trace_start(TRACE_DEFAULT_EVENTS)) {
+		fprintf(stderr, "could not allocate the event trace\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// create hashtable (of given type), or map a saved one
+	HashTable *table;
+	if (options.snapshot) {
+		table = hash_table_open_mmap(options.snapshot);
+		if (!table) {
+			fprintf(stderr, "%s: not a valid snapshot\n", options.snapshot);
+			exit(EXIT_FAILURE);
+		}
+	} else {
+		table = new_hash_map_ways(options.type, options.initial_size, 0,
+			options.ways);
+		if (!table) {
+			fprintf(stderr, "could not create a %s table with %d ways\n",
+				typetostr(options.type), options.ways);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// answer most lookups of absent keys from a filter, if asked to
+	if (options.filter && !hash_table_add_filter(table, options.filter)) {
+		fprintf(stderr, "could not add a filter to the table\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// back its arrays with huge pages if asked to (before reserving, so the
+	// reserved arrays are allocated that way to begin with)
+	if (options.pages != PAGES_DEFAULT
+			&& !hash_table_set_pages(table, options.pages)) {
+		fprintf(stderr, "could not back a %s table with %s pages\n",
+			typetostr(options.type), pagestostr(options.pages));
+		exit(EXIT_FAILURE);
+	}
+
+	// grow it up front if we know how many keys are coming
+	if (options.reserve && !hash_table_reserve(table, options.reserve)) {
+		fprintf(stderr, "could not reserve room for %ld keys\n",
+			options.reserve);
+		exit(EXIT_FAILURE);
+	}
+
+	// report results as requested
+	output_set_mode(options.output);
+
+	// start the interpreter loop, reading commands from a mapped file, binary
+	// commands from stdin, or text from stdin
+	if (options.file) {
+		command_input = map_command_stream(options.file, options.binary);
+		if (!command_input) {
+			perror(options.file);
+			exit(EXIT_FAILURE);
+		}
+	} else if (options.binary) {
+		command_input = new_command_stream(stdin);
+	}
+
+	CommandReader reader = command_input ? get_stream_command : get_command;
+	if (options.pipelined) {
+		run_pipelined_interpreter(table, reader);
+	} else {
+		run_interpreter(table, reader);
+	}
 
-	// start the interpreter loop
-	run_interpreter(table);
+	if (command_input) {
+		free_command_stream(command_input);
+	}
 
 	// done!
+	output_flush();
+	if (options.save && !hash_table_save(table, options.save)) {
+		fprintf(stderr, "%s: could not save snapshot\n", options.save);
+	}
 	free_hash_table(table);
+
+	if (options.trace) {
+		FILE *file = fopen(options.trace, "wb");
+		if (!file || !trace_dump(file)) {
+			perror(options.trace);
+		}
+		if (file) {
+			fclose(file);
+		}
+		trace_stop();
+	}
 	return 0;
 }
 
@@ -81,14 +190,105 @@ void print_operations() {
 	printf(" %c: print stats\n", STATS);
 	printf(" %c: print csv stats header\n", STATS_HEAD);
 	printf(" %c: print csv stats\n", STATS_ROW);
+	printf(" %c: print json stats\n", STATS_JSON);
+	printf(" %c: print csv histograms\n", HISTOGRAMS);
+	printf(" %c: print csv resize / split events (with -T)\n", EVENTS);
 	printf(" %c: quit\n", QUIT);
 }
 
-// run the interpreter, reading and performing commands until 'quit'
-void run_interpreter(HashTable *table) {
+// perform a single command (with 'argc' tokens) against 'table'
+// returns false if the command was 'quit', true otherwise
+bool execute_command(HashTable *table, char op, int argc, int64 key) {
+
+	// buffered results must be written before anything else is printed
+	if (!((op == INSERT || op == LOOKUP) && argc >= 2)) {
+		output_flush();
+	}
+
+	switch (op) {
+		case INSERT:
+			if (argc < 2) {
+				// insert commands must have an argument
+				printf("syntax: %c number\n", INSERT);
+			
+			} else {
+				// perform the insertion
+				output_insert(key, hash_table_insert(table, key));
+			}
+			break;
+
+		case LOOKUP:
+			if (argc < 2) {
+				// lookup commands must have an argument
+				printf("syntax: %c number\n", LOOKUP);
+
+			} else {
+				// perform the lookup
+				output_lookup(key, hash_table_lookup(table, key));
+			}
+			break;
+
+		case PRINT:
+			// perform the print table
+			hash_table_print(table);
+			break;
+
+		case STATS:
+			// perform the print stats
+			hash_table_stats(table);
+			break;
+
+		case STATS_HEAD:
+			// perform the print csv stat header
+			hash_table_csv_stats_header(table);
+			break;
+
+		case STATS_ROW:
+			// perform the print csv format stats
+			hash_table_csv_stats(table);
+			output_summary();
+			break;
+
+		case STATS_JSON:
+			// perform the print json format stats
+			hash_table_json_stats(table);
+			break;
+
+		case HISTOGRAMS:
+			// perform the print csv histograms
+			hash_table_csv_histograms(table);
+			break;
+
+		case EVENTS:
+			// perform the print csv event trace
+			trace_print_csv(stdout);
+			break;
+
+		default:
+			// display error
+			printf("unknown operation '%c'\n", op);
+			// fall through!
+		case HELP:
+			// list available options
+			printf("available operations:\n");
+			print_operations();
+			break;
+			
+		case QUIT:
+			// leave the interpreter loop
+			output_summary();
+			if (output_verbose()) {printf("exiting\n");}
+			return false;
+	}
+	return true;
+}
+
+// run the interpreter, reading commands with 'get_command' and performing them
+// until 'quit'
+void run_interpreter(HashTable *table, CommandReader get_command) {
 	
 	// print a prompt at the beginning
-	if(!SILENT) {printf("enter a command (h for help):\n");}
+	if (output_verbose()) {printf("enter a command (h for help):\n");}
 	
 	char op;
 	int64 key;
@@ -103,73 +303,119 @@ void run_interpreter(HashTable *table) {
 		}
 
 		// execute the command
-		switch (op) {
-			case INSERT:
-				if (argc < 2) {
-					// insert commands must have an argument
-					printf("syntax: %c number\n", INSERT);
-				
-				} else {
-					// perform the insertion
-					if (hash_table_insert(table, key)) {
-						if (!SILENT) {printf("%llu inserted\n", key);}
-					} else {
-						if (!SILENT) {printf("%llu already in table\n", key);}
-					}
-				}
-				break;
-
-			case LOOKUP:
-				if (argc < 2) {
-					// lookup commands must have an argument
-					printf("syntax: %c number\n", LOOKUP);
-
-				} else {
-					// perform the lookup
-					if (hash_table_lookup(table, key)) {
-						if (!SILENT) {printf("%llu found\n", key);}
-					} else {
-						if (!SILENT) {printf("%llu not found\n", key);}
-					}
-				}
-				break;
+		if (!execute_command(table, op, argc, key)) {
+			return;
+		}
+	}
+}
 
-			case PRINT:
-				// perform the print table
-				hash_table_print(table);
-				break;
+// arguments for the reader thread of the pipelined interpreter
+typedef struct reader {
+	CommandQueue *queue;		// queue to fill with parsed commands
+	CommandReader get_command;	// how to read each command
+} Reader;
+
+// reader thread: parse commands into blocks and queue them, up to and
+// including the first 'quit'
+static void *read_commands(void *arg) {
+	Reader *reader = arg;
+	bool quit = false;
+
+	while (!quit) {
+		CommandBlock *block = queue_reserve(reader->queue);
+		while (!quit && block->ncommands < QUEUE_BLOCK_LEN) {
+			Command *command = &block->commands[block->ncommands];
+			command->argc = reader->get_command(&command->op, &command->key);
+			if (command->argc < 1) {
+				continue; // no valid command entered, get another
+			}
+			block->ncommands++;
+			quit = (command->op == QUIT);
+		}
+		queue_push(reader->queue);
+	}
+	return NULL;
+}
 
-			case STATS:
-				// perform the print stats
-				hash_table_stats(table);
-				break;
+// perform a block of commands against 'table'. consecutive inserts (or
+// lookups) are gathered and performed as a single batch, then reported in
+// their original order. returns false once 'quit' is reached
+static bool execute_block(HashTable *table, CommandBlock *block) {
+	static int64 keys[QUEUE_BLOCK_LEN];
+	static bool results[QUEUE_BLOCK_LEN];
+	int i = 0, j, n;
+
+	while (i < block->ncommands) {
+		Command *command = &block->commands[i];
+
+		// gather a run of well formed inserts or lookups
+		n = 0;
+		if (command->op == INSERT || command->op == LOOKUP) {
+			while (i + n < block->ncommands
+					&& block->commands[i+n].op == command->op
+					&& block->commands[i+n].argc >= 2) {
+				keys[n] = block->commands[i+n].key;
+				n++;
+			}
+		}
 
-            case STATS_HEAD:
-				// perform the print csv stat header
-				hash_table_csv_stats_header(table);
-				break;
+		if (n == 0) {
+			// anything else is performed on its own
+			if (!execute_command(table, command->op, command->argc,
+					command->key)) {
+				return false;
+			}
+			i++;
+		} else if (command->op == INSERT) {
+			hash_table_insert_batch(table, keys, n, results);
+			for (j = 0; j < n; j++) {
+				output_insert(keys[j], results[j]);
+			}
+			i += n;
+		} else {
+			hash_table_lookup_batch(table, keys, n, results);
+			for (j = 0; j < n; j++) {
+				output_lookup(keys[j], results[j]);
+			}
+			i += n;
+		}
+	}
+	return true;
+}
 
-			case STATS_ROW:
-				// perform the print csv format stats
-				hash_table_csv_stats(table);
-				break;
+// run the interpreter with commands read by 'get_command' on a separate reader
+// thread, so that parsing overlaps with table operations, until 'quit'
+void run_pipelined_interpreter(HashTable *table, CommandReader get_command) {
 
-			default:
-				// display error
-				printf("unknown operation '%c'\n", op);
-				// fall through!
-			case HELP:
-				// list available options
-				printf("available operations:\n");
-				print_operations();
-				break;
-				
-			case QUIT:
-				// leave the interpreter loop
-				if (!SILENT) {printf("exiting\n");}
+	// print a prompt at the beginning
+	if (output_verbose()) {printf("enter a command (h for help):\n");}
+
+	Reader reader = { .queue = new_command_queue(),
+		.get_command = get_command };
+	pthread_t thread;
+	if (pthread_create(&thread, NULL, read_commands, &reader) != 0) {
+		// no reader thread? fall back to reading on this thread
+		free_command_queue(reader.queue);
+		while (true) {
+			char op;
+			int64 key;
+			int argc = get_command(&op, &key);
+			if (argc >= 1 && !execute_command(table, op, argc, key)) {
 				return;
+			}
 		}
 	}
+
+	// execute blocks as they arrive, until the block containing 'quit'
+	bool running = true;
+	while (running) {
+		CommandBlock *block = queue_pop(reader.queue);
+		running = execute_block(table, block);
+		queue_release(reader.queue);
+	}
+
+	pthread_join(thread, NULL);
+	free_command_queue(reader.queue);
 }
 
 // reads a line from stdin, parses it into an operation character and possibly
@@ -193,16 +439,26 @@ int get_command(char *operation, int64 *key) {
 	return argc;
 }
 
+// reads the next command from the mapped file or binary stdin into *operation
+// and *key. returns the number of tokens read, as get_command() does
+int get_stream_command(char *operation, int64 *key) {
+	return command_stream_next(command_input, operation, key);
+}
+
 // scans command line arguments for program options,
 // prints usage info and exits if commands are missing or otherwise invalid
 Options get_options(int argc, char** argv) {
 	
 	// create the Options structure with defaults
-	Options options = { .type = NOTYPE, .initial_size = DEFAULT_SIZE };
+	Options options = { .type = NOTYPE, .initial_size = DEFAULT_SIZE,
+		.reserve = 0, .binary = false, .file = NULL, .pipelined = false,
+		.output = SILENT ? OUTPUT_SILENT : OUTPUT_TEXT, .trace = NULL,
+		.snapshot = NULL, .save = NULL, .filter = 0, .ways = 2,
+		.pages = PAGES_DEFAULT };
 
 	// use C's built-in getopt function to scan inputs by flag
 	char option;
-	while ((option = getopt(argc, argv, "t:s:")) != EOF){
+	while ((option = getopt(argc, argv, "t:s:r:bf:Po:T:m:w:F:d:H:")) != EOF){
 		switch (option){
 			case 't': // set hash table type
 				options.type = strtotype(optarg);
@@ -210,6 +466,39 @@ Options get_options(int argc, char** argv) {
 			case 's': // set hash table size
 				options.initial_size = atoi(optarg);
 				break;
+			case 'r': // reserve room for this many keys up front
+				options.reserve = atol(optarg);
+				break;
+			case 'b': // read binary commands
+				options.binary = true;
+				break;
+			case 'f': // read commands from a memory-mapped file
+				options.file = optarg;
+				break;
+			case 'P': // parse commands on a separate reader thread
+				options.pipelined = true;
+				break;
+			case 'o': // set output mode
+				options.output = strtomode(optarg);
+				break;
+			case 'T': // trace resizes and splits, dumping them to a file
+				options.trace = optarg;
+				break;
+			case 'm': // map a saved snapshot, instead of building a table
+				options.snapshot = optarg;
+				break;
+			case 'w': // save a snapshot of the table on quitting
+				options.save = optarg;
+				break;
+			case 'F': // filter lookups, with this false positive rate
+				options.filter = atof(optarg);
+				break;
+			case 'd': // let each key be in this many inner (cuckoo) tables
+				options.ways = atoi(optarg);
+				break;
+			case 'H': // back the table's large arrays with huge pages
+				options.pages = strtopages(optarg);
+				break;
 			default:
 				break;
 		}
@@ -218,8 +507,8 @@ Options get_options(int argc, char** argv) {
 	// validation and printing error / usage messages
 	bool valid = true;
 		
-	// check part validity
-	if(options.type == NOTYPE){
+	// check part validity (a mapped snapshot knows its own type)
+	if(options.type == NOTYPE && !options.snapshot){
 		fprintf(stderr,
 			"please specify which table type to use, using the -t flag:\n");
 		fprintf(stderr, " -t linear:  linear hash table\n");
@@ -229,6 +518,11 @@ Options get_options(int argc, char** argv) {
 			" -t 2 or xtnbdln: n-key extendible hash table (part 2)\n");
 		fprintf(stderr, " -t 3 or xuckoo:  extendible cuckoo table (part 3)\n");
         fprintf(stderr, " -t xuckoon: xuckoon table (bonus part 4)\n");
+		fprintf(stderr, " -t linear32, cuckoo32, xtndbln32: 32-bit keys\n");
+		fprintf(stderr,
+			" -t cuckoofilter, quotientfilter: approximate membership\n");
+		fprintf(stderr, " -t hopscotch: hopscotch hash table\n");
+		fprintf(stderr, " -t linhash: linear hashing (split pointer) table\n");
 		valid = false;
 	}
 
@@ -239,6 +533,53 @@ Options get_options(int argc, char** argv) {
 		valid = false;
 	}
 
+	// validate number of keys to reserve room for
+	if(options.reserve < 0) {
+		fprintf(stderr,
+			"please specify a number of keys (>=0) to reserve using -r\n");
+		valid = false;
+	}
+
+	// validate ways (which table types accept them is up to the table)
+	if(options.ways < 2 || options.ways > 4) {
+		fprintf(stderr,
+			"please specify 2 to 4 ways (for cuckoo, xuckoo and xuckoon "
+			"tables) using -d\n");
+		valid = false;
+	}
+
+	// validate page policy (mapped snapshots are backed by their file)
+	if(options.pages == NOPAGES
+			|| (options.pages != PAGES_DEFAULT && options.snapshot)) {
+		fprintf(stderr,
+			"please specify a page policy using -H, without -m:\n");
+		fprintf(stderr, " -H default: malloc'd arrays (default)\n");
+		fprintf(stderr, " -H thp:     transparent huge pages (madvise)\n");
+		fprintf(stderr, " -H huge:    reserved huge pages, else as thp\n");
+		valid = false;
+	}
+
+	// validate filter false positive rate (mapped snapshots cannot be given a
+	// filter: it would not know their keys)
+	if(options.filter < 0 || options.filter >= 1
+			|| (options.filter && options.snapshot)) {
+		fprintf(stderr,
+			"please specify a false positive rate (>0, <1) using -F, "
+			"without -m\n");
+		valid = false;
+	}
+
+	// validate output mode
+	if(options.output == NOMODE) {
+		fprintf(stderr,
+			"please specify a valid output mode using the -o flag:\n");
+		fprintf(stderr, " -o text:     print each result (default)\n");
+		fprintf(stderr, " -o buffered: print each result, buffered\n");
+		fprintf(stderr, " -o summary:  print result counts at 'd' and quit\n");
+		fprintf(stderr, " -o silent:   print no results\n");
+		valid = false;
+	}
+
 	// check overall validity before continuing
 	if(!valid){
 		exit(EXIT_FAILURE);
@@ -0,0 +1,284 @@
+/* * * * * * * * *
+ * Module for tracking how much heap memory a table is using: every
+ * allocation a table makes goes through these wrappers, which keep a running
+ * total (and high-water mark) of the bytes held, allocator overhead included
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#define _DEFAULT_SOURCE		// for MAP_ANONYMOUS, MAP_HUGETLB and madvise
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define block_size(block) malloc_usable_size(block)
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#define block_size(block) malloc_size(block)
+#endif
+
+#include "memacct.h"
+
+#ifndef block_size
+// no way to ask the allocator how big a block is, so keep the requested size
+// in a header in front of each block (max_align_t keeps the alignment intact)
+#include <stddef.h>
+#define PREFIX sizeof(max_align_t)
+#define block_size(block) (*(size_t *)((char *)(block) - PREFIX))
+#endif
+
+// the total footprint of an allocated block, or 0 for NULL
+static size_t footprint(void *block) {
+	return block ? block_size(block) + ALLOC_HEADER : 0;
+}
+
+// note that 'bytes' more are now held
+static void grow(Memory *memory, size_t bytes) {
+	memory->bytes += bytes;
+	if (memory->bytes > memory->peak) {
+		memory->peak = memory->bytes;
+	}
+}
+
+void memory_init(Memory *memory) {
+	memory->bytes = 0;
+	memory->peak = 0;
+}
+
+#ifdef PREFIX
+void *memory_malloc(Memory *memory, size_t size) {
+	char *raw = malloc(size + PREFIX);
+	if (!raw) {
+		return NULL;
+	}
+	*(size_t *)raw = size;
+	grow(memory, footprint(raw + PREFIX));
+	return raw + PREFIX;
+}
+
+void *memory_realloc(Memory *memory, void *block, size_t size) {
+	if (!block) {
+		return memory_malloc(memory, size);
+	}
+	size_t before = footprint(block);
+	char *raw = realloc((char *)block - PREFIX, size + PREFIX);
+	if (!raw) {
+		return NULL;
+	}
+	*(size_t *)raw = size;
+	memory->bytes -= before;
+	grow(memory, footprint(raw + PREFIX));
+	return raw + PREFIX;
+}
+
+void memory_free(Memory *memory, void *block) {
+	if (block) {
+		memory->bytes -= footprint(block);
+		free((char *)block - PREFIX);
+	}
+}
+#else
+void *memory_malloc(Memory *memory, size_t size) {
+	void *block = malloc(size);
+	grow(memory, footprint(block));
+	return block;
+}
+
+void *memory_realloc(Memory *memory, void *block, size_t size) {
+	size_t before = footprint(block);
+	void *moved = realloc(block, size);
+	if (!moved) {
+		return NULL;
+	}
+	memory->bytes -= before;
+	grow(memory, footprint(moved));
+	return moved;
+}
+
+void memory_free(Memory *memory, void *block) {
+	memory->bytes -= footprint(block);
+	free(block);
+}
+#endif
+
+void *memory_calloc(Memory *memory, size_t count, size_t size) {
+	void *block = memory_malloc(memory, count * size);
+	if (block) {
+		memset(block, 0, count * size);
+	}
+	return block;
+}
+
+void memory_add(Memory *total, const Memory *part) {
+	// the peaks of the parts may not have coincided, so this is an upper bound
+	total->bytes += part->bytes;
+	total->peak += part->peak;
+}
+
+PagePolicy strtopages(const char *str) {
+	if (strcmp("default", str) == 0) {
+		return PAGES_DEFAULT;
+	}
+	if (strcmp("thp", str) == 0) {
+		return PAGES_TRANSPARENT;
+	}
+	if (strcmp("huge", str) == 0) {
+		return PAGES_HUGE;
+	}
+	return NOPAGES;
+}
+
+const char *pagestostr(PagePolicy policy) {
+	switch (policy) {
+		case PAGES_DEFAULT:		return "default";
+		case PAGES_TRANSPARENT:	return "thp";
+		case PAGES_HUGE:		return "huge";
+		default:				return "none";
+	}
+}
+
+// kept in front of every block from memory_alloc_pages. a whole cache line,
+// so the array after it is as aligned as the block
+typedef union pages_header {
+	struct {
+		size_t size;		// bytes asked for
+		size_t mapped;		// bytes mapped, this header included, or 0 if
+							// the block was malloc'd
+		PagePolicy policy;	// the policy asked for
+	} h;
+	char pad[64];
+} PagesHeader;
+
+#ifdef MAP_ANONYMOUS
+// map 'length' bytes (a multiple of HUGE_PAGE_SIZE) as 'policy' asks, or
+// return NULL if the system can do no better than malloc
+static void *map_pages(size_t length, PagePolicy policy) {
+#ifdef MAP_HUGETLB
+	if (policy == PAGES_HUGE) {
+		void *pages = mmap(NULL, length, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (pages != MAP_FAILED) {
+			return pages;
+		}
+		// no pool reserved, or not enough of it left
+	}
+#endif
+#ifdef MADV_HUGEPAGE
+	// the kernel only uses a huge page for an aligned 2 MB range, so map one
+	// huge page too many and trim the ends off to start on a boundary
+	char *raw = mmap(NULL, length + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (raw == MAP_FAILED) {
+		return NULL;
+	}
+	size_t head = (HUGE_PAGE_SIZE - (uintptr_t)raw % HUGE_PAGE_SIZE)
+		% HUGE_PAGE_SIZE;
+	if (head > 0) {
+		munmap(raw, head);
+	}
+	munmap(raw + head + length, HUGE_PAGE_SIZE - head);
+	// if this fails (THP disabled) the mapping just keeps small pages
+	madvise(raw + head, length, MADV_HUGEPAGE);
+	return raw + head;
+#else
+	(void)length;
+	return NULL;
+#endif
+}
+#endif
+
+// allocate as memory_alloc_pages, but only zero the block if 'zero'
+static void *allocate_pages(Memory *memory, size_t size, PagePolicy policy,
+		bool zero) {
+	PagesHeader *header = NULL;
+	size_t mapped = 0;
+#ifdef MAP_ANONYMOUS
+	if (policy != PAGES_DEFAULT
+			&& size + sizeof(PagesHeader) >= HUGE_PAGE_SIZE) {
+		mapped = (size + sizeof(PagesHeader) + HUGE_PAGE_SIZE - 1)
+			/ HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+		header = map_pages(mapped, policy);
+		if (header) {
+			// fresh anonymous pages are already zeroed
+			grow(memory, mapped);
+		} else {
+			mapped = 0;
+		}
+	}
+#endif
+	if (!header) {
+		header = memory_malloc(memory, size + sizeof(PagesHeader));
+		if (!header) {
+			return NULL;
+		}
+		if (zero) {
+			memset(header + 1, 0, size);
+		}
+	}
+	header->h.size = size;
+	header->h.mapped = mapped;
+	header->h.policy = policy;
+	return header + 1;
+}
+
+void *memory_alloc_pages(Memory *memory, size_t size, PagePolicy policy) {
+	return allocate_pages(memory, size, policy, true);
+}
+
+void *memory_realloc_pages(Memory *memory, void *block, size_t size,
+		PagePolicy policy) {
+	if (!block) {
+		return allocate_pages(memory, size, policy, false);
+	}
+	PagesHeader *header = (PagesHeader *)block - 1;
+
+	// a malloc'd block that should stay malloc'd is resized in place
+	if (!header->h.mapped && (policy == PAGES_DEFAULT
+			|| size + sizeof(PagesHeader) < HUGE_PAGE_SIZE)) {
+		header = memory_realloc(memory, header, size + sizeof(PagesHeader));
+		if (!header) {
+			return NULL;
+		}
+		header->h.size = size;
+		header->h.policy = policy;
+		return header + 1;
+	}
+
+	// and a mapped one still big enough is left where it is
+	if (header->h.mapped && header->h.policy == policy
+			&& size + sizeof(PagesHeader) <= header->h.mapped) {
+		header->h.size = size;
+		return block;
+	}
+
+	void *moved = allocate_pages(memory, size, policy, false);
+	if (!moved) {
+		return NULL;
+	}
+	memcpy(moved, block, size < header->h.size ? size : header->h.size);
+	memory_free_pages(memory, block);
+	return moved;
+}
+
+void memory_free_pages(Memory *memory, void *block) {
+	if (!block) {
+		return;
+	}
+	PagesHeader *header = (PagesHeader *)block - 1;
+#ifdef MAP_ANONYMOUS
+	if (header->h.mapped) {
+		memory->bytes -= header->h.mapped;
+		munmap(header, header->h.mapped);
+		return;
+	}
+#endif
+	memory_free(memory, header);
+}
@@ -0,0 +1,74 @@
+/* * * * * * * * *
+ * Module for tracking how much heap memory a table is using: every
+ * allocation a table makes goes through these wrappers, which keep a running
+ * total (and high-water mark) of the bytes held, allocator overhead included
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#ifndef MEMACCT_H
+#define MEMACCT_H
+
+#include <stddef.h>
+
+// bytes of bookkeeping the allocator keeps in front of every block
+#define ALLOC_HEADER sizeof(size_t)
+
+// memory held by one table
+typedef struct memory {
+	size_t bytes;	// bytes currently allocated, including overhead
+	size_t peak;	// most bytes ever allocated at once
+} Memory;
+
+// start accounting from nothing
+void memory_init(Memory *memory);
+
+// malloc / calloc / realloc / free, recording the change in 'memory'.
+// these behave exactly like the standard functions they wrap
+void *memory_malloc(Memory *memory, size_t size);
+void *memory_calloc(Memory *memory, size_t count, size_t size);
+void *memory_realloc(Memory *memory, void *block, size_t size);
+void memory_free(Memory *memory, void *block);
+
+// add the totals of 'part' (eg. an inner table) to 'total'
+void memory_add(Memory *total, const Memory *part);
+
+// how a table's large arrays (slots, bucket directories) are backed. random
+// probes into an array of hundreds of MB miss the TLB on nearly every access
+// with 4 KB pages; 2 MB pages cover it with 512 times fewer entries
+typedef enum page_policy {
+	NOPAGES = -1,
+	PAGES_DEFAULT,		// malloc, in whatever pages it uses
+	PAGES_TRANSPARENT,	// mmap, marked madvise(MADV_HUGEPAGE) so the kernel
+						// backs it with transparent huge pages where it can
+	PAGES_HUGE			// mmap from the reserved pool (MAP_HUGETLB), or as
+						// PAGES_TRANSPARENT if the pool is empty
+} PagePolicy;
+
+// the huge page size assumed, and the smallest array that is mapped: smaller
+// ones are always malloc'd, since a huge page would be mostly unused
+#define HUGE_PAGE_SIZE (2 << 20)
+
+// converts from a string representation ("default", "thp" or "huge") to a
+// PagePolicy constant, or NOPAGES if there is no such policy
+PagePolicy strtopages(const char *str);
+const char *pagestostr(PagePolicy policy);
+
+// allocate 'size' zeroed bytes backed as 'policy' asks, falling back to the
+// next policy down (and finally to malloc) when the system can't. returns
+// NULL only if malloc would
+void *memory_alloc_pages(Memory *memory, size_t size, PagePolicy policy);
+
+// resize a block from memory_alloc_pages (or allocate one, if 'block' is
+// NULL), moving it if it now needs backing differently. on failure returns
+// NULL and leaves 'block' as it was
+void *memory_realloc_pages(Memory *memory, void *block, size_t size,
+	PagePolicy policy);
+
+// free a block from memory_alloc_pages (NULL is ignored)
+void memory_free_pages(Memory *memory, void *block);
+
+#endif
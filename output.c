@@ -0,0 +1,151 @@
+/* * * * * * * * *
+ * Module for reporting the results of interpreter commands, either line by
+ * line through stdio, through a large output buffer, or as summary counts
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "output.h"
+
+// size of the buffer results are formatted into before being written
+#define OUTPUT_BUFFER_LEN 1048576
+
+// longest line a single result can produce: 20 digits, a space, a message
+#define MAX_RESULT_LEN 64
+
+// counts of each kind of result reported
+typedef struct counts {
+	unsigned long long inserted;	// inserts that succeeded
+	unsigned long long duplicate;	// inserts of keys already in the table
+	unsigned long long found;		// lookups that found their key
+	unsigned long long notfound;	// lookups that did not
+} Counts;
+
+static OutputMode mode = OUTPUT_TEXT;
+static Counts counts;
+static char buffer[OUTPUT_BUFFER_LEN];
+static size_t buffered = 0;
+
+OutputMode strtomode(char *str) {
+	if (strcmp("text", str) == 0) {
+		return OUTPUT_TEXT;
+	}
+	if (strcmp("buffered", str) == 0) {
+		return OUTPUT_BUFFERED;
+	}
+	if (strcmp("summary", str) == 0) {
+		return OUTPUT_SUMMARY;
+	}
+	if (strcmp("silent", str) == 0) {
+		return OUTPUT_SILENT;
+	}
+	return NOMODE;
+}
+
+void output_set_mode(OutputMode new_mode) {
+	output_flush();
+	mode = new_mode;
+}
+
+bool output_verbose(void) {
+	return mode == OUTPUT_TEXT || mode == OUTPUT_BUFFERED;
+}
+
+void output_flush(void) {
+	if (buffered) {
+		fwrite(buffer, 1, buffered, stdout);
+		buffered = 0;
+	}
+}
+
+// append "'key' 'message'\n" to the output buffer, formatting the key by hand
+static void buffer_result(int64 key, const char *message, size_t length) {
+	if (buffered + MAX_RESULT_LEN > OUTPUT_BUFFER_LEN) {
+		output_flush();
+	}
+
+	// write the digits backwards into a scratch space, then copy them over
+	char digits[20];
+	int ndigits = 0;
+	do {
+		digits[ndigits++] = '0' + (key % 10);
+		key /= 10;
+	} while (key);
+
+	char *out = buffer + buffered;
+	while (ndigits) {
+		*out++ = digits[--ndigits];
+	}
+	memcpy(out, message, length);
+	out += length;
+
+	buffered = out - buffer;
+}
+
+void output_insert(int64 key, bool inserted) {
+	if (inserted) {
+		counts.inserted++;
+	} else {
+		counts.duplicate++;
+	}
+
+	switch (mode) {
+		case OUTPUT_TEXT:
+			if (inserted) {
+				printf("%llu inserted\n", key);
+			} else {
+				printf("%llu already in table\n", key);
+			}
+			break;
+		case OUTPUT_BUFFERED:
+			if (inserted) {
+				buffer_result(key, " inserted\n", 10);
+			} else {
+				buffer_result(key, " already in table\n", 18);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+void output_lookup(int64 key, bool found) {
+	if (found) {
+		counts.found++;
+	} else {
+		counts.notfound++;
+	}
+
+	switch (mode) {
+		case OUTPUT_TEXT:
+			if (found) {
+				printf("%llu found\n", key);
+			} else {
+				printf("%llu not found\n", key);
+			}
+			break;
+		case OUTPUT_BUFFERED:
+			if (found) {
+				buffer_result(key, " found\n", 7);
+			} else {
+				buffer_result(key, " not found\n", 11);
+			}
+			break;
+		default:
+			break;
+	}
+}
+
+void output_summary(void) {
+	if (mode != OUTPUT_SUMMARY) {
+		return;
+	}
+	printf("%llu inserted, %llu already in table, %llu found, %llu not found\n",
+		counts.inserted, counts.duplicate, counts.found, counts.notfound);
+}
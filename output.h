@@ -0,0 +1,48 @@
+/* * * * * * * * *
+ * Module for reporting the results of interpreter commands, either line by
+ * line through stdio, through a large output buffer, or as summary counts
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <stdbool.h>
+#include "inthash.h"
+
+// enumerated type containing the ways insert / lookup results can be reported
+typedef enum output_mode {
+	NOMODE = -1,
+	OUTPUT_TEXT,		// a printf per result (the original behaviour)
+	OUTPUT_BUFFERED,	// the same text, formatted into a large buffer
+	OUTPUT_SUMMARY,		// only counts of each result, at 'd' and on quit
+	OUTPUT_SILENT		// nothing at all
+} OutputMode;
+
+// converts from a string representation to an OutputMode constant:
+// "text" -> OUTPUT_TEXT, "buffered" -> OUTPUT_BUFFERED,
+// "summary" -> OUTPUT_SUMMARY, "silent" -> OUTPUT_SILENT
+OutputMode strtomode(char *str);
+
+// select how results are reported from now on
+void output_set_mode(OutputMode mode);
+
+// true if prompts and other messages should be printed in the current mode
+bool output_verbose(void);
+
+// report the result of inserting / looking up 'key'
+void output_insert(int64 key, bool inserted);
+void output_lookup(int64 key, bool found);
+
+// print the counts of each result reported so far (in summary mode)
+void output_summary(void);
+
+// write out any buffered results. must be called before anything else is
+// printed to stdout, so that output stays in order
+void output_flush(void);
+
+#endif
@@ -0,0 +1,120 @@
+/* * * * * * * * *
+ * Module for splitting bulk table work (eg. rehashing on resize) across a
+ * small pool of worker threads
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+// everything a worker thread needs to run its share of a parallel_for
+typedef struct task {
+	ParallelWork work;	// function to run
+	void *arg;			// argument passed through to 'work'
+	int n;				// total number of items being split
+	int nworkers;		// how many ways the items are split
+	int worker;			// which share belongs to this task
+} Task;
+
+// thread entry point, runs one task
+static void *run_task(void *data) {
+	Task *task = data;
+	int start, end;
+	parallel_range(task->n, task->nworkers, task->worker, &start, &end);
+	task->work(start, end, task->worker, task->arg);
+	return NULL;
+}
+
+int parallel_worker_count(void) {
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+	/* Allow the worker count to be pinned for benchmarking */
+	char *override = getenv("HASHTBL_THREADS");
+	if (override) {
+		count = atoi(override);
+	}
+
+	if (count < 1) {
+		count = 1;
+	}
+	if (count > PARALLEL_MAX_WORKERS) {
+		count = PARALLEL_MAX_WORKERS;
+	}
+	return (int)count;
+}
+
+void parallel_range(int n, int nworkers, int worker, int *start, int *end) {
+	/* Spread the remainder over the first n % nworkers ranges */
+	int share = n / nworkers, extra = n % nworkers;
+	*start = worker * share + (worker < extra ? worker : extra);
+	*end = *start + share + (worker < extra ? 1 : 0);
+}
+
+void parallel_for(int n, int nworkers, ParallelWork work, void *arg) {
+	/* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+	 * DESC: Run 'work' over [0, n) split into 'nworkers' contiguous ranges.
+	 *       Worker 0 runs on the calling thread, the rest on new threads.
+	 *
+	 * INPT: int n
+	 *          Number of items to process
+	 *
+	 *       int nworkers
+	 *          Number of ranges (and so threads) to split the items over
+	 *
+	 *       ParallelWork work, void *arg
+	 *          Function run for each range, and the argument passed to it
+	 *
+	 * NOTE: Ranges whose thread cannot be started are run serially on the
+	 *       calling thread, so the work is always complete on return.
+	 *
+	 * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+	if (nworkers < 1) {
+		nworkers = 1;
+	}
+	if (nworkers > PARALLEL_MAX_WORKERS) {
+		nworkers = PARALLEL_MAX_WORKERS;
+	}
+
+	Task tasks[PARALLEL_MAX_WORKERS];
+	pthread_t threads[PARALLEL_MAX_WORKERS];
+	int started[PARALLEL_MAX_WORKERS];
+	int w;
+
+	for (w = 0; w < nworkers; w++) {
+		tasks[w].work = work;
+		tasks[w].arg = arg;
+		tasks[w].n = n;
+		tasks[w].nworkers = nworkers;
+		tasks[w].worker = w;
+		started[w] = 0;
+	}
+
+	/* Start workers 1..n-1 on their own threads */
+	for (w = 1; w < nworkers; w++) {
+		started[w] = (pthread_create(&threads[w], NULL, run_task, &tasks[w])
+						== 0);
+	}
+
+	/* The calling thread does its own share (and any that failed to start) */
+	run_task(&tasks[0]);
+	for (w = 1; w < nworkers; w++) {
+		if (!started[w]) {
+			run_task(&tasks[w]);
+		}
+	}
+
+	for (w = 1; w < nworkers; w++) {
+		if (started[w]) {
+			pthread_join(threads[w], NULL);
+		}
+	}
+}
@@ -0,0 +1,40 @@
+/* * * * * * * * *
+ * Module for splitting bulk table work (eg. rehashing on resize) across a
+ * small pool of worker threads
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+// below this many slots a resize is done on the calling thread, as thread
+// start-up would cost more than the rehash itself
+#ifndef PARALLEL_MIN_ITEMS
+#define PARALLEL_MIN_ITEMS 65536
+#endif
+
+// upper bound on the number of worker threads used for one operation
+#define PARALLEL_MAX_WORKERS 16
+
+// a unit of work over the index range [start, end). 'worker' is the zero based
+// id of the worker running it, and 'arg' is passed through untouched
+typedef void (*ParallelWork)(int start, int end, int worker, void *arg);
+
+// number of workers to use for bulk operations. this is the number of online
+// cpus (or the HASHTBL_THREADS environment variable, if set), capped at
+// PARALLEL_MAX_WORKERS
+int parallel_worker_count(void);
+
+// split [0, n) into 'nworkers' contiguous ranges and run 'work' on each range
+// from its own thread. returns once every range is done. falls back to running
+// ranges on the calling thread if threads cannot be created
+void parallel_for(int n, int nworkers, ParallelWork work, void *arg);
+
+// the range [*start, *end) handled by 'worker' of 'nworkers' over [0, n)
+void parallel_range(int n, int nworkers, int worker, int *start, int *end);
+
+#endif
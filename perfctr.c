@@ -0,0 +1,139 @@
+/* * * * * * * * *
+ * Module for reading hardware performance counters (instructions, cache,
+ * branch and dTLB misses) around a section of code, via perf_event_open
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#define _DEFAULT_SOURCE		// for syscall
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "perfctr.h"
+
+// a set of counters is one file descriptor per counter, -1 if unavailable
+struct perf_counters {
+	int fd[PERF_NCOUNTERS];
+};
+
+#ifdef __linux__
+// open a single user-space-only counter for this thread (and the threads it
+// starts from now on), -1 on failure
+static int open_counter(uint32_t type, uint64_t config) {
+	struct perf_event_attr attr;
+	memset(&attr, 0, sizeof attr);
+	attr.size = sizeof attr;
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	// count the workers of a parallel rehash too (parallel.c starts them
+	// afresh for each one): a thread's counts are added to this counter when
+	// it exits, and enabling or resetting this counter does the same to its
+	// threads' counters. each counter is read on its own, as inherited
+	// counters cannot be read as a group
+	attr.inherit = 1;
+
+	long fd = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+	return (int)fd;
+}
+#endif
+
+PerfCounters *new_perf_counters(void) {
+	PerfCounters *counters = malloc(sizeof *counters);
+	assert(counters);
+
+	int i;
+	for (i = 0; i < PERF_NCOUNTERS; i++) {
+		counters->fd[i] = -1;
+	}
+
+#ifdef __linux__
+	counters->fd[PERF_INSTRUCTIONS] = open_counter(PERF_TYPE_HARDWARE,
+		PERF_COUNT_HW_INSTRUCTIONS);
+	counters->fd[PERF_CACHE_MISSES] = open_counter(PERF_TYPE_HARDWARE,
+		PERF_COUNT_HW_CACHE_MISSES);
+	counters->fd[PERF_BRANCH_MISSES] = open_counter(PERF_TYPE_HARDWARE,
+		PERF_COUNT_HW_BRANCH_MISSES);
+	counters->fd[PERF_DTLB_MISSES] = open_counter(PERF_TYPE_HW_CACHE,
+		PERF_COUNT_HW_CACHE_DTLB |
+		(PERF_COUNT_HW_CACHE_OP_READ << 8) |
+		(PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#endif
+
+	return counters;
+}
+
+void free_perf_counters(PerfCounters *counters) {
+	int i;
+	for (i = 0; i < PERF_NCOUNTERS; i++) {
+		if (counters->fd[i] >= 0) {
+			close(counters->fd[i]);
+		}
+	}
+	free(counters);
+}
+
+void perf_counters_start(PerfCounters *counters) {
+#ifdef __linux__
+	int i;
+	for (i = 0; i < PERF_NCOUNTERS; i++) {
+		if (counters->fd[i] >= 0) {
+			ioctl(counters->fd[i], PERF_EVENT_IOC_RESET, 0);
+			ioctl(counters->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+		}
+	}
+#endif
+}
+
+void perf_counters_stop(PerfCounters *counters, PerfSample *sample) {
+	int i;
+	for (i = 0; i < PERF_NCOUNTERS; i++) {
+		sample->valid[i] = false;
+		sample->value[i] = 0;
+	}
+
+#ifdef __linux__
+	for (i = 0; i < PERF_NCOUNTERS; i++) {
+		if (counters->fd[i] >= 0) {
+			ioctl(counters->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+		}
+	}
+	for (i = 0; i < PERF_NCOUNTERS; i++) {
+		uint64_t value;
+		if (counters->fd[i] >= 0
+				&& read(counters->fd[i], &value, sizeof value) == sizeof value) {
+			sample->valid[i] = true;
+			sample->value[i] = value;
+		}
+	}
+#endif
+}
+
+const char *perf_counter_name(PerfCounter counter) {
+	switch (counter) {
+		case PERF_INSTRUCTIONS:
+			return "instructions";
+		case PERF_CACHE_MISSES:
+			return "cache misses";
+		case PERF_BRANCH_MISSES:
+			return "branch misses";
+		case PERF_DTLB_MISSES:
+			return "dTLB misses";
+		default:
+			return "unknown";
+	}
+}
@@ -0,0 +1,56 @@
+/* * * * * * * * *
+ * Module for reading hardware performance counters (instructions, cache,
+ * branch and dTLB misses) around a section of code, via perf_event_open
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * Counters are opened individually for the calling thread, user space only,
+ * and also count every thread it starts after they are opened (so the
+ * workers of a parallel rehash are measured with the inserts they serve).
+ * Any counter the kernel or hardware refuses (eg. under a restrictive
+ * perf_event_paranoid setting, in a container, or on a non-linux system) is
+ * simply marked unavailable.
+ */
+
+#ifndef PERFCTR_H
+#define PERFCTR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// the counters collected, in the order they are reported
+typedef enum perf_counter {
+	PERF_INSTRUCTIONS,
+	PERF_CACHE_MISSES,
+	PERF_BRANCH_MISSES,
+	PERF_DTLB_MISSES,
+	PERF_NCOUNTERS
+} PerfCounter;
+
+// counts read from each counter over one measured section
+typedef struct perf_sample {
+	bool valid[PERF_NCOUNTERS];		// was the counter available?
+	uint64_t value[PERF_NCOUNTERS];	// events counted, if valid
+} PerfSample;
+
+typedef struct perf_counters PerfCounters;
+
+// open every counter that is available for this thread
+PerfCounters *new_perf_counters(void);
+
+// close all counters and free memory associated with 'counters'
+void free_perf_counters(PerfCounters *counters);
+
+// zero and start all open counters
+void perf_counters_start(PerfCounters *counters);
+
+// stop all open counters and store their counts in 'sample'
+void perf_counters_stop(PerfCounters *counters, PerfSample *sample);
+
+// short name of a counter, for use in csv headers
+const char *perf_counter_name(PerfCounter counter);
+
+#endif
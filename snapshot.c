@@ -0,0 +1,449 @@
+/* * * * * * * * *
+ * Module for saving built tables to a snapshot file, and for mapping a
+ * snapshot back read-only so it can be queried straight away, without
+ * replaying the inserts that built it
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#define _DEFAULT_SOURCE		// for madvise
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+
+// where the first section starts: room is left for every section descriptor,
+// so the header can be written last, once the sections are known
+#define DATA_START (sizeof(SnapshotHeader) \
+	+ SNAPSHOT_MAX_SECTIONS * sizeof(SnapshotSection))
+
+/* * * *
+ * saving
+ */
+
+struct snapshot_writer {
+	FILE *file;
+	bool failed;			// has any write failed?
+	uint64_t offset;		// bytes written so far
+	SnapshotHeader header;
+	SnapshotSection sections[SNAPSHOT_MAX_SECTIONS];
+	uint64_t *directory;	// entries of the directory being written
+};
+
+// write 'n' bytes from 'data' at the end of the file
+static void put(SnapshotWriter *writer, const void *data, size_t n) {
+	if (n && fwrite(data, n, 1, writer->file) != 1) {
+		writer->failed = true;
+	}
+	writer->offset += n;
+}
+
+// pad the file with zeros up to an 8 byte boundary
+static void align(SnapshotWriter *writer) {
+	static const unsigned char zeros[8];
+	put(writer, zeros, (8 - writer->offset % 8) % 8);
+}
+
+// the next free section descriptor
+static SnapshotSection *new_section(SnapshotWriter *writer, SnapshotKind kind,
+		int hash) {
+	assert(writer->header.nsections < SNAPSHOT_MAX_SECTIONS);
+	SnapshotSection *section = &writer->sections[writer->header.nsections++];
+	section->kind = kind;
+	section->hash = hash;
+	return section;
+}
+
+SnapshotWriter *new_snapshot_writer(const char *path, int type) {
+	FILE *file = fopen(path, "wb");
+	if (!file) {
+		return NULL;
+	}
+
+	SnapshotWriter *writer = calloc(1, sizeof *writer);
+	assert(writer);
+	writer->file = file;
+	writer->header.type = type;
+
+	// leave a hole for the header and section descriptors
+	if (fseek(file, DATA_START, SEEK_SET) != 0) {
+		writer->failed = true;
+	}
+	writer->offset = DATA_START;
+	return writer;
+}
+
+void snapshot_write_slots(SnapshotWriter *writer, SnapshotKind kind, int hash,
+		const int64 *slots, const bool *inuse, long size) {
+	SnapshotSection *section = new_section(writer, kind, hash);
+	section->size = size;
+	section->bucketsize = 1;
+	section->nbuckets = size;
+
+	// slots that are not in use may hold garbage, so write them as zero
+	section->data = writer->offset;
+	long i;
+	for (i = 0; i < size; i++) {
+		int64 key = inuse[i] ? slots[i] : 0;
+		put(writer, &key, sizeof key);
+	}
+
+	section->extra = writer->offset;
+	for (i = 0; i < size; i++) {
+		unsigned char used = inuse[i];
+		put(writer, &used, 1);
+		section->nkeys += used;
+	}
+	align(writer);
+	writer->header.nkeys += section->nkeys;
+}
+
+void snapshot_begin_directory(SnapshotWriter *writer, int hash, int depth,
+		int bucketsize) {
+	assert(!writer->directory);
+	SnapshotSection *section = new_section(writer, SNAPSHOT_DIRECTORY, hash);
+	section->size = (uint64_t)1 << depth;
+	section->bucketsize = bucketsize;
+	section->extra = writer->offset;
+
+	writer->directory = calloc(section->size, sizeof *writer->directory);
+	assert(writer->directory);
+}
+
+void snapshot_write_bucket(SnapshotWriter *writer, int id, int depth,
+		const int64 *keys, int nkeys) {
+	SnapshotSection *section = &writer->sections[writer->header.nsections-1];
+	assert(writer->directory && nkeys <= (int)section->bucketsize);
+
+	// point every address sharing the bucket's low 'depth' bits at it
+	uint64_t address;
+	for (address = id; address < section->size; address += 1ul << depth) {
+		writer->directory[address] = writer->offset;
+	}
+
+	// buckets are all the same size, with unused key slots zeroed
+	int64 count = nkeys, zero = 0;
+	int i;
+	put(writer, &count, sizeof count);
+	put(writer, keys, sizeof *keys * nkeys);
+	for (i = nkeys; i < (int)section->bucketsize; i++) {
+		put(writer, &zero, sizeof zero);
+	}
+	section->nbuckets++;
+	section->nkeys += nkeys;
+}
+
+void snapshot_end_directory(SnapshotWriter *writer) {
+	SnapshotSection *section = &writer->sections[writer->header.nsections-1];
+	assert(writer->directory);
+
+	section->data = writer->offset;
+	put(writer, writer->directory, sizeof *writer->directory * section->size);
+	writer->header.nkeys += section->nkeys;
+
+	free(writer->directory);
+	writer->directory = NULL;
+}
+
+bool finish_snapshot_writer(SnapshotWriter *writer) {
+	assert(!writer->directory);
+	SnapshotHeader *header = &writer->header;
+	memset(header->magic, 0, sizeof header->magic);
+	memcpy(header->magic, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC));
+	header->version = SNAPSHOT_VERSION;
+	header->byte_order = SNAPSHOT_BYTE_ORDER;
+	header->length = writer->offset;
+
+	// now everything is in place, fill in the hole at the front
+	bool ok = !writer->failed
+		&& fseek(writer->file, 0, SEEK_SET) == 0
+		&& fwrite(header, sizeof *header, 1, writer->file) == 1
+		&& fwrite(writer->sections, sizeof writer->sections, 1,
+			writer->file) == 1;
+	ok = (fclose(writer->file) == 0) && ok;
+
+	free(writer);
+	return ok;
+}
+
+/* * * *
+ * mapping
+ */
+
+// a section of a mapped snapshot, with its arrays resolved to pointers
+typedef struct section {
+	SnapshotKind kind;
+	int (*hash)(int64 key);
+	int hashnum;					// which hash function 'hash' is
+	uint64_t size;
+	uint64_t bucketsize;
+	uint64_t nbuckets;
+	uint64_t nkeys;
+	const int64 *slots;				// SLOTS and PROBED
+	const unsigned char *inuse;		// SLOTS and PROBED
+	const uint64_t *directory;		// DIRECTORY
+	const unsigned char *buckets;	// DIRECTORY: first bucket
+	const unsigned char *base;		// start of the file, which offsets are from
+} Section;
+
+struct snapshot {
+	unsigned char *map;		// the whole file
+	size_t length;
+	int type;
+	uint64_t nkeys;
+	int nsections;
+	Section sections[SNAPSHOT_MAX_SECTIONS];
+};
+
+// does [offset, offset + n * width) lie within the data of a 'length' byte
+// file, starting on an 8 byte boundary?
+static bool in_file(uint64_t offset, uint64_t n, uint64_t width,
+		size_t length) {
+	return offset >= DATA_START && offset % 8 == 0 && offset <= length
+		&& n <= (length - offset) / width;
+}
+
+// check 'stored' describes a section within the file, and resolve it
+static bool load_section(Snapshot *snapshot, const SnapshotSection *stored,
+		Section *section) {
+	size_t length = snapshot->length;
+	uint64_t i, bucket_bytes;
+
+	if (stored->hash < 1 || stored->hash > NHASHES) {
+		return false;
+	}
+	section->kind = stored->kind;
+	section->hash = hash_function(stored->hash);
+	section->hashnum = stored->hash;
+	section->size = stored->size;
+	section->bucketsize = stored->bucketsize;
+	section->nbuckets = stored->nbuckets;
+	section->nkeys = stored->nkeys;
+	section->base = snapshot->map;
+	if (section->size == 0 || section->size > MAX_TABLE_SIZE) {
+		return false;
+	}
+
+	switch (section->kind) {
+		case SNAPSHOT_SLOTS:
+		case SNAPSHOT_PROBED:
+			if (!in_file(stored->data, section->size, sizeof(int64), length)
+					|| stored->extra < stored->data
+					|| stored->extra > length
+					|| section->size > length - stored->extra) {
+				return false;
+			}
+			section->slots = (const int64 *)(snapshot->map + stored->data);
+			section->inuse = snapshot->map + stored->extra;
+			return true;
+
+		case SNAPSHOT_DIRECTORY:
+			// the directory is addressed by masking, so must be 2^depth long
+			if ((section->size & (section->size - 1)) != 0
+					|| section->bucketsize == 0
+					|| section->bucketsize > length / sizeof(int64)
+					|| !in_file(stored->data, section->size, sizeof(uint64_t),
+						length)) {
+				return false;
+			}
+			section->directory = (const uint64_t *)(snapshot->map
+				+ stored->data);
+			section->buckets = snapshot->map + stored->extra;
+
+			// every bucket a lookup can reach must be inside the file
+			bucket_bytes = (1 + section->bucketsize) * sizeof(int64);
+			for (i = 0; i < section->size; i++) {
+				if (!in_file(section->directory[i], 1, bucket_bytes, length)) {
+					return false;
+				}
+			}
+			return in_file(stored->extra, section->nbuckets, bucket_bytes,
+				length);
+
+		default:
+			return false;
+	}
+}
+
+Snapshot *open_snapshot(const char *path) {
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) < 0 || (size_t)info.st_size < DATA_START) {
+		close(fd);
+		return NULL;
+	}
+
+	unsigned char *map = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED) {
+		return NULL;
+	}
+
+	Snapshot *snapshot = malloc(sizeof *snapshot);
+	assert(snapshot);
+	snapshot->map = map;
+	snapshot->length = info.st_size;
+
+	// copy the header and sections out before checking them
+	SnapshotHeader header;
+	SnapshotSection sections[SNAPSHOT_MAX_SECTIONS];
+	memcpy(&header, map, sizeof header);
+	memcpy(sections, map + sizeof header, sizeof sections);
+
+	bool valid = memcmp(header.magic, SNAPSHOT_MAGIC, strlen(SNAPSHOT_MAGIC))
+			== 0
+		&& header.version == SNAPSHOT_VERSION
+		&& header.byte_order == SNAPSHOT_BYTE_ORDER
+		&& header.length == snapshot->length
+		&& header.nsections >= 1
+		&& header.nsections <= SNAPSHOT_MAX_SECTIONS;
+	int i;
+	for (i = 0; valid && i < (int)header.nsections; i++) {
+		valid = load_section(snapshot, &sections[i], &snapshot->sections[i]);
+	}
+	if (!valid) {
+		close_snapshot(snapshot);
+		return NULL;
+	}
+
+	snapshot->type = header.type;
+	snapshot->nkeys = header.nkeys;
+	snapshot->nsections = header.nsections;
+
+	// lookups land anywhere in the file, so read-ahead would be wasted
+	madvise(map, snapshot->length, MADV_RANDOM);
+	return snapshot;
+}
+
+void close_snapshot(Snapshot *snapshot) {
+	munmap(snapshot->map, snapshot->length);
+	free(snapshot);
+}
+
+int snapshot_type(Snapshot *snapshot) {
+	return snapshot->type;
+}
+
+// the bucket of 'section' that 'key' hashes to: its key count, then its keys
+static const int64 *find_bucket(const Section *section, int64 key) {
+	uint64_t address = section->hash(key) & (section->size - 1);
+	return (const int64 *)(section->base + section->directory[address]);
+}
+
+// lookup whether 'key' is in 'section'
+static bool section_lookup(const Section *section, int64 key) {
+	uint64_t i, h, steps;
+	const int64 *bucket;
+
+	switch (section->kind) {
+		case SNAPSHOT_SLOTS:
+			h = section->hash(key) % section->size;
+			return section->inuse[h] && section->slots[h] == key;
+
+		case SNAPSHOT_PROBED:
+			// step along until a free slot, as linear_hash_table_lookup does
+			h = section->hash(key) % section->size;
+			for (steps = 0; steps < section->size && section->inuse[h];
+					steps++) {
+				if (section->slots[h] == key) {
+					return true;
+				}
+				h = (h + 1) % section->size;
+			}
+			return false;
+
+		case SNAPSHOT_DIRECTORY:
+			bucket = find_bucket(section, key);
+			for (i = 0; i < (uint64_t)bucket[0] && i < section->bucketsize;
+					i++) {
+				if (bucket[1 + i] == key) {
+					return true;
+				}
+			}
+			return false;
+
+		default:
+			return false;
+	}
+}
+
+bool snapshot_lookup(Snapshot *snapshot, int64 key) {
+	int i;
+	for (i = 0; i < snapshot->nsections; i++) {
+		if (section_lookup(&snapshot->sections[i], key)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void snapshot_print(Snapshot *snapshot) {
+	int i;
+	uint64_t j, k;
+	printf("--- mapped snapshot ---\n");
+	for (i = 0; i < snapshot->nsections; i++) {
+		const Section *section = &snapshot->sections[i];
+		printf("section %d (h%d):\n", i + 1, section->hashnum);
+
+		if (section->kind == SNAPSHOT_DIRECTORY) {
+			// buckets are stored one after another, in the order saved
+			uint64_t width = 1 + section->bucketsize;
+			for (j = 0; j < section->nbuckets; j++) {
+				const int64 *bucket = (const int64 *)section->buckets
+					+ j * width;
+				printf("bucket %llu:", (unsigned long long)j);
+				for (k = 0; k < (uint64_t)bucket[0] && k < section->bucketsize;
+						k++) {
+					printf(" %llu", (unsigned long long)bucket[1 + k]);
+				}
+				printf("\n");
+			}
+		} else {
+			for (j = 0; j < section->size; j++) {
+				if (section->inuse[j]) {
+					printf("%6llu | %llu\n", (unsigned long long)j,
+						(unsigned long long)section->slots[j]);
+				}
+			}
+		}
+	}
+	printf("--- end snapshot ---\n");
+}
+
+void snapshot_get_stats(Snapshot *snapshot, HashTableStats *stats) {
+	int i;
+	long capacity = 0;
+	bool extendible = false;
+
+	stats->size = 0;
+	stats->nbuckets = 0;
+	for (i = 0; i < snapshot->nsections; i++) {
+		const Section *section = &snapshot->sections[i];
+		stats->size += section->size;
+		stats->nbuckets += section->nbuckets;
+		capacity += section->nbuckets * section->bucketsize;
+		if (section->kind == SNAPSHOT_DIRECTORY) {
+			extendible = true;
+			stats->bucketsize = section->bucketsize;
+		}
+	}
+	if (!extendible) {
+		stats->nbuckets = UNTRACKED;
+	}
+	stats->nkeys = snapshot->nkeys;
+	stats->load_factor = capacity ? (double)snapshot->nkeys / capacity : 0;
+}
@@ -0,0 +1,127 @@
+/* * * * * * * * *
+ * Module for saving built tables to a snapshot file, and for mapping a
+ * snapshot back read-only so it can be queried straight away, without
+ * replaying the inserts that built it
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * A snapshot holds one to four sections, each a table of keys addressed by
+ * one hash function (h1 to h4). Every position in the file is an offset from
+ * its start, so the file can be mapped anywhere. Integers are in the byte
+ * order of the machine that saved it (checked when opening). All arrays
+ * start on an 8 byte boundary.
+ *
+ *   header:    SnapshotHeader, then nsections SnapshotSections
+ *   SLOTS:     int64 slots[size], then u8 inuse[size]. a key lives in slot
+ *              hash % size (linear probing onwards from there if PROBED)
+ *   DIRECTORY: buckets, each int64 nkeys and int64 keys[bucketsize], then
+ *              u64 directory[size] of bucket offsets. a key lives in the
+ *              bucket at directory[hash % size] (size is a power of two)
+ *
+ * Linear tables save one PROBED section, cuckoo tables one SLOTS section per
+ * inner table and the extendible types one DIRECTORY section per inner table.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "inthash.h"
+#include "tblstats.h"
+
+#define SNAPSHOT_MAGIC "HTSNAP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+#define SNAPSHOT_MAX_SECTIONS 4
+
+// how the keys of a section are laid out
+typedef enum snapshot_kind {
+	SNAPSHOT_SLOTS = 1,		// one key per slot
+	SNAPSHOT_PROBED,		// one key per slot, linear probing
+	SNAPSHOT_DIRECTORY		// extendible hashing directory of buckets
+} SnapshotKind;
+
+// the start of every snapshot file
+typedef struct snapshot_header {
+	char magic[8];			// SNAPSHOT_MAGIC, NUL padded
+	uint32_t version;		// SNAPSHOT_VERSION
+	uint32_t byte_order;	// SNAPSHOT_BYTE_ORDER, as saved
+	uint32_t type;			// TableType of the saved table
+	uint32_t nsections;
+	uint64_t nkeys;			// keys over all sections
+	uint64_t length;		// bytes in the whole file
+} SnapshotHeader;
+
+// where one section is, following the header
+typedef struct snapshot_section {
+	uint32_t kind;			// SnapshotKind
+	uint32_t hash;			// 1 for h1, 2 for h2, ...
+	uint64_t size;			// slots, or directory entries
+	uint64_t bucketsize;	// keys per bucket (1 for slots)
+	uint64_t nbuckets;		// distinct buckets (size for slots)
+	uint64_t nkeys;			// keys in this section
+	uint64_t data;			// offset of the slots / directory
+	uint64_t extra;			// offset of the inuse markers / first bucket
+} SnapshotSection;
+
+/* * * *
+ * saving
+ */
+
+typedef struct snapshot_writer SnapshotWriter;
+
+// start writing a snapshot of a table of type 'type' to 'path'
+// returns NULL if the file cannot be created
+SnapshotWriter *new_snapshot_writer(const char *path, int type);
+
+// add a section of 'size' slots, addressed with hash function 'hash'
+void snapshot_write_slots(SnapshotWriter *writer, SnapshotKind kind, int hash,
+	const int64 *slots, const bool *inuse, long size);
+
+// start a directory section of 2^'depth' entries and buckets of 'bucketsize'
+// keys, addressed with hash function 'hash'
+void snapshot_begin_directory(SnapshotWriter *writer, int hash, int depth,
+	int bucketsize);
+
+// add the bucket first referenced from address 'id' and using 'depth' bits of
+// the hash, holding 'nkeys' keys, to the directory section being written
+void snapshot_write_bucket(SnapshotWriter *writer, int id, int depth,
+	const int64 *keys, int nkeys);
+
+// finish the directory section being written
+void snapshot_end_directory(SnapshotWriter *writer);
+
+// finish the snapshot and free 'writer'. returns false if anything could not
+// be written, in which case the file is incomplete
+bool finish_snapshot_writer(SnapshotWriter *writer);
+
+/* * * *
+ * mapping
+ */
+
+typedef struct snapshot Snapshot;
+
+// map the snapshot at 'path' read-only. returns NULL if it cannot be mapped,
+// or is not a valid snapshot saved on a machine of the same byte order
+Snapshot *open_snapshot(const char *path);
+
+// unmap 'snapshot' and free it
+void close_snapshot(Snapshot *snapshot);
+
+// the TableType of the table that was saved
+int snapshot_type(Snapshot *snapshot);
+
+// lookup whether 'key' is inside 'snapshot'
+bool snapshot_lookup(Snapshot *snapshot, int64 key);
+
+// print the keys in 'snapshot' to stdout
+void snapshot_print(Snapshot *snapshot);
+
+// fill 'stats' with the size and shape of 'snapshot'
+void snapshot_get_stats(Snapshot *snapshot, HashTableStats *stats);
+
+#endif
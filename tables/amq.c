@@ -0,0 +1,662 @@
+/* * * * * * * * *
+ * Approximate membership tables: a cuckoo filter and a quotient filter,
+ * holding fingerprints of keys rather than the keys (see amq.h)
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+#include <math.h>
+
+#include "amq.h"
+
+#define MAX_LAYERS 16
+// kicks a cuckoo filter insert makes before giving up on the newest layer
+#define MAX_KICKS 500
+// load of the cuckoo filter reserve sizes for. four slot buckets hold keys
+// up to about 95% full
+#define CUCKOOF_RESERVE_LOAD 0.9
+// load at which a quotient filter layer is full. runs of shifted remainders,
+// and so inserts and lookups, grow quickly above it
+#define QUOTIENTF_MAX_LOAD 0.85
+
+/* * * *
+ * packed fields
+ */
+
+// an array of fields 'width' bits wide, packed end to end, least significant
+// bit first. 8 bytes of padding let every field be read with one 8 byte load
+
+// an array of 'n' zeroed fields of 'width' bits
+static unsigned char *new_fields(Memory *memory, long n, int width) {
+	unsigned char *bytes = memory_calloc(memory,
+		((size_t)n * width + 7) / 8 + 8, 1);
+	assert(bytes);
+	return bytes;
+}
+
+// the 8 bytes at 'p', as a little endian integer
+static uint64_t load(const unsigned char *p) {
+	uint64_t word = 0;
+	int i;
+	for (i = 0; i < 8; i++) {
+		word |= (uint64_t)p[i] << (8 * i);
+	}
+	return word;
+}
+
+// store 'word' in the 8 bytes at 'p', little endian
+static void store(unsigned char *p, uint64_t word) {
+	int i;
+	for (i = 0; i < 8; i++) {
+		p[i] = (unsigned char)(word >> (8 * i));
+	}
+}
+
+// field 'i' of the fields at 'bytes'
+static uint64_t get_field(const unsigned char *bytes, long i, int width) {
+	uint64_t bit = (uint64_t)i * width;
+	return (load(bytes + bit / 8) >> (bit % 8)) & ((1ULL << width) - 1);
+}
+
+// set field 'i' of the fields at 'bytes' to 'value'
+static void set_field(unsigned char *bytes, long i, int width,
+		uint64_t value) {
+	uint64_t bit = (uint64_t)i * width;
+	uint64_t mask = ((1ULL << width) - 1) << (bit % 8);
+	uint64_t word = load(bytes + bit / 8);
+	store(bytes + bit / 8, (word & ~mask) | (value << (bit % 8)));
+}
+
+// 'n' rounded up to a whole number, at least 'least', and capped a little
+// above MAX_TABLE_SIZE (so that it is still seen to be too large)
+static long round_up(double n, long least) {
+	if (n > 2.0 * MAX_TABLE_SIZE) {
+		return 2L * MAX_TABLE_SIZE;
+	}
+	long size = (long)ceil(n);
+	return size > least ? size : least;
+}
+
+// a hash from h1 or h2 (31 bits) scaled down to [0, 'n'), without a division
+static long scale(int hash, long n) {
+	return (long)(((uint64_t)hash * (uint64_t)n) >> 31);
+}
+
+// fingerprint bits in layer 'i', given those of the first
+static int layer_bits(int first, int i) {
+	return first + i < AMQ_MAX_BITS ? first + i : AMQ_MAX_BITS;
+}
+
+/* * * *
+ * cuckoo filter
+ */
+
+// one cuckoo filter, of a fixed size
+typedef struct cf_layer {
+	unsigned char *fingerprints;	// CUCKOOF_BUCKETSIZE per bucket, 0 if empty
+	long nbuckets;
+	int bits;						// fingerprint width
+	long nkeys;
+} CfLayer;
+
+struct cuckoo_filter {
+	CfLayer layers[MAX_LAYERS];
+	int nlayers;		// inserts go into the newest layer
+	long nkeys;
+	long nkicks;		// fingerprints kicked to their other bucket
+	Histogram chains;	// kicks made by each insert
+	Memory memory;
+};
+
+// the fingerprint of 'key' in 'layer': h2, cut down to 'bits' bits, never 0
+static uint64_t cf_fingerprint(CfLayer *layer, int64 key) {
+	return (uint64_t)h2(key) % ((1ULL << layer->bits) - 1) + 1;
+}
+
+// the first bucket of 'key' in 'layer'
+static long cf_bucket(CfLayer *layer, int64 key) {
+	return scale(h1(key), layer->nbuckets);
+}
+
+// the other bucket of the fingerprint 'fp' in bucket 'i': the two add up to
+// a hash of the fingerprint (modulo the number of buckets), so this works
+// either way round and needs nothing but the fingerprint
+static long cf_alternate(CfLayer *layer, long i, uint64_t fp) {
+	long other = scale(h1(fp), layer->nbuckets) - i;
+	return other < 0 ? other + layer->nbuckets : other;
+}
+
+// the slot in bucket 'i' holding 'fp' (0 for a free slot), or -1
+static int cf_find(CfLayer *layer, long i, uint64_t fp) {
+	int j;
+	for (j = 0; j < CUCKOOF_BUCKETSIZE; j++) {
+		if (get_field(layer->fingerprints, i * CUCKOOF_BUCKETSIZE + j,
+				layer->bits) == fp) {
+			return j;
+		}
+	}
+	return -1;
+}
+
+// put 'fp' in a free slot of bucket 'i', if there is one
+static bool cf_add(CfLayer *layer, long i, uint64_t fp) {
+	int j = cf_find(layer, i, 0);
+	if (j < 0) {
+		return false;
+	}
+	set_field(layer->fingerprints, i * CUCKOOF_BUCKETSIZE + j, layer->bits, fp);
+	return true;
+}
+
+// add a layer of 'nbuckets' buckets, returning false if it would be too large
+// or there are MAX_LAYERS already
+static bool cf_add_layer(CuckooFilter *filter, long nbuckets) {
+	if (filter->nlayers == MAX_LAYERS
+			|| nbuckets * CUCKOOF_BUCKETSIZE > MAX_TABLE_SIZE) {
+		return false;
+	}
+	CfLayer *layer = &filter->layers[filter->nlayers];
+	layer->bits = layer_bits(CUCKOOF_FINGERPRINT_BITS, filter->nlayers);
+	layer->nbuckets = nbuckets;
+	layer->nkeys = 0;
+	layer->fingerprints = new_fields(&filter->memory,
+		nbuckets * CUCKOOF_BUCKETSIZE, layer->bits);
+	filter->nlayers++;
+	return true;
+}
+
+CuckooFilter *new_cuckoo_filter(int size) {
+	Memory memory;
+	memory_init(&memory);
+	CuckooFilter *filter = memory_malloc(&memory, sizeof *filter);
+	assert(filter);
+	filter->memory = memory;
+	filter->nlayers = 0;
+	filter->nkeys = 0;
+	filter->nkicks = 0;
+	init_histogram(&filter->chains, "kick chain length", HIST_LOG2);
+	cf_add_layer(filter, round_up(size, 1));
+	return filter;
+}
+
+void free_cuckoo_filter(CuckooFilter *filter) {
+	assert(filter != NULL);
+	int i;
+	for (i = 0; i < filter->nlayers; i++) {
+		memory_free(&filter->memory, filter->layers[i].fingerprints);
+	}
+	memory_free(&filter->memory, filter);
+}
+
+// place 'key' in 'layer', kicking fingerprints between their buckets as
+// cuckoo_hash_table_insert kicks keys between its inner tables. if no free
+// slot turns up within MAX_KICKS kicks, every kick is undone and false is
+// returned: the fingerprint left over cannot be moved to a new layer, since
+// its key is not known
+static bool cf_place(CuckooFilter *filter, CfLayer *layer, int64 key) {
+	uint64_t fp = cf_fingerprint(layer, key);
+	long i = cf_bucket(layer, key);
+	long alternate = cf_alternate(layer, i, fp);
+	if (cf_add(layer, i, fp) || cf_add(layer, alternate, fp)) {
+		histogram_add(&filter->chains, 0);
+		return true;
+	}
+
+	// kick a fingerprint out of one of the buckets at random, and carry it to
+	// its other bucket, remembering where each kick was made
+	long buckets[MAX_KICKS];
+	int slots[MAX_KICKS];
+	int kicks;
+	if (rand() % 2) {
+		i = alternate;
+	}
+	for (kicks = 0; kicks < MAX_KICKS; kicks++) {
+		long slot = i * CUCKOOF_BUCKETSIZE + rand() % CUCKOOF_BUCKETSIZE;
+		uint64_t kicked = get_field(layer->fingerprints, slot, layer->bits);
+		set_field(layer->fingerprints, slot, layer->bits, fp);
+		buckets[kicks] = i;
+		slots[kicks] = slot % CUCKOOF_BUCKETSIZE;
+		fp = kicked;
+		i = cf_alternate(layer, i, fp);
+		if (cf_add(layer, i, fp)) {
+			filter->nkicks += kicks + 1;
+			histogram_add(&filter->chains, kicks + 1);
+			return true;
+		}
+	}
+
+	// put each kicked fingerprint back where it was, newest first
+	while (kicks-- > 0) {
+		long slot = buckets[kicks] * CUCKOOF_BUCKETSIZE + slots[kicks];
+		uint64_t placed = get_field(layer->fingerprints, slot, layer->bits);
+		set_field(layer->fingerprints, slot, layer->bits, fp);
+		fp = placed;
+	}
+	return false;
+}
+
+bool cuckoo_filter_insert(CuckooFilter *filter, int64 key) {
+	assert(filter != NULL);
+	if (cuckoo_filter_lookup(filter, key)) {
+		return false;
+	}
+
+	// a full layer is followed by a larger one, which has room
+	CfLayer *layer = &filter->layers[filter->nlayers - 1];
+	if (!cf_place(filter, layer, key)) {
+		if (!cf_add_layer(filter, layer->nbuckets * AMQ_GROWTH)) {
+			return false;
+		}
+		layer = &filter->layers[filter->nlayers - 1];
+		bool placed = cf_place(filter, layer, key);
+		assert(placed);
+	}
+	layer->nkeys++;
+	filter->nkeys++;
+	return true;
+}
+
+bool cuckoo_filter_lookup(CuckooFilter *filter, int64 key) {
+	assert(filter != NULL);
+
+	// the newest layer holds the most keys, so check it first
+	int l;
+	for (l = filter->nlayers - 1; l >= 0; l--) {
+		CfLayer *layer = &filter->layers[l];
+		uint64_t fp = cf_fingerprint(layer, key);
+		long i = cf_bucket(layer, key);
+		if (cf_find(layer, i, fp) >= 0
+				|| cf_find(layer, cf_alternate(layer, i, fp), fp) >= 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool cuckoo_filter_reserve(CuckooFilter *filter, size_t nkeys) {
+	assert(filter != NULL);
+
+	// keys go into the newest layer: see if it has room for the rest
+	CfLayer *layer = &filter->layers[filter->nlayers - 1];
+	double more = (double)nkeys - filter->nkeys;
+	double room = CUCKOOF_RESERVE_LOAD * layer->nbuckets * CUCKOOF_BUCKETSIZE
+		- layer->nkeys;
+	if (more <= 0 || more <= room) {
+		return true;
+	}
+	long nbuckets = round_up(more
+		/ (CUCKOOF_RESERVE_LOAD * CUCKOOF_BUCKETSIZE), 1);
+
+	// an empty filter can start over with one layer of the right size
+	if (filter->nkeys == 0) {
+		if (nbuckets * CUCKOOF_BUCKETSIZE > MAX_TABLE_SIZE) {
+			return false;
+		}
+		memory_free(&filter->memory, layer->fingerprints);
+		filter->nlayers = 0;
+	}
+	return cf_add_layer(filter, nbuckets);
+}
+
+void cuckoo_filter_print(CuckooFilter *filter) {
+	assert(filter != NULL);
+	int l, j;
+	long i;
+	for (l = 0; l < filter->nlayers; l++) {
+		CfLayer *layer = &filter->layers[l];
+		printf("--- layer %d: %ld buckets, %d bit fingerprints\n", l,
+			layer->nbuckets, layer->bits);
+		printf("   address | fingerprints\n");
+		for (i = 0; i < layer->nbuckets; i++) {
+			printf(" %9ld |", i);
+			for (j = 0; j < CUCKOOF_BUCKETSIZE; j++) {
+				uint64_t fp = get_field(layer->fingerprints,
+					i * CUCKOOF_BUCKETSIZE + j, layer->bits);
+				if (fp) {
+					printf(" %6llx", (unsigned long long)fp);
+				} else {
+					printf(" %6s", "-");
+				}
+			}
+			printf("\n");
+		}
+	}
+	printf("--- end table ---\n");
+}
+
+void cuckoo_filter_get_stats(CuckooFilter *filter, HashTableStats *stats) {
+	assert(filter != NULL);
+	long nbuckets = 0;
+	int l;
+	for (l = 0; l < filter->nlayers; l++) {
+		nbuckets += filter->layers[l].nbuckets;
+	}
+	stats->size = nbuckets * CUCKOOF_BUCKETSIZE;
+	stats->nkeys = filter->nkeys;
+	stats->nbuckets = nbuckets;
+	stats->bucketsize = CUCKOOF_BUCKETSIZE;
+	stats->load_factor = (double)filter->nkeys / stats->size;
+	stats->resizes = filter->nlayers - 1;
+	stats->kicks = filter->nkicks;
+	stats->memory = filter->memory.bytes;
+	stats->peak_memory = filter->memory.peak;
+	add_stats_histogram(stats, &filter->chains);
+}
+
+void cuckoo_filter_memory(CuckooFilter *filter, Memory *memory) {
+	assert(filter != NULL);
+	*memory = filter->memory;
+}
+
+/* * * *
+ * quotient filter
+ */
+
+// each slot holds a remainder above three bits of metadata. a slot with all
+// three clear is empty
+#define OCCUPIED 1		// some key has this slot as its home (its quotient)
+#define CONTINUATION 2	// this remainder continues the run of the slot before
+#define SHIFTED 4		// this remainder is not in its home slot
+#define METADATA 7
+#define META_BITS 3
+
+// one quotient filter, of a fixed size
+typedef struct qf_layer {
+	unsigned char *slots;	// remainder << META_BITS | metadata, per slot
+	long nslots;
+	int bits;				// remainder width
+	long nkeys;
+} QfLayer;
+
+struct quotient_filter {
+	QfLayer layers[MAX_LAYERS];
+	int nlayers;		// inserts go into the newest layer
+	long nkeys;
+	Histogram shifts;	// remainders shifted along by each insert
+	Memory memory;
+};
+
+static uint64_t qf_get(QfLayer *layer, long i) {
+	return get_field(layer->slots, i, layer->bits + META_BITS);
+}
+
+static void qf_set(QfLayer *layer, long i, uint64_t slot) {
+	set_field(layer->slots, i, layer->bits + META_BITS, slot);
+}
+
+// slots wrap around at the end of the layer
+static long qf_next(QfLayer *layer, long i) {
+	return i + 1 < layer->nslots ? i + 1 : 0;
+}
+
+static long qf_prev(QfLayer *layer, long i) {
+	return i > 0 ? i - 1 : layer->nslots - 1;
+}
+
+// the home slot (quotient) and remainder of 'key' in 'layer'
+static long qf_quotient(QfLayer *layer, int64 key) {
+	return scale(h1(key), layer->nslots);
+}
+
+static uint64_t qf_remainder(QfLayer *layer, int64 key) {
+	return h2(key) & ((1ULL << layer->bits) - 1);
+}
+
+// the first slot of the run of remainders with quotient 'q'. the cluster 'q'
+// is in starts at the last unshifted slot at or before it, and holds the runs
+// of each occupied slot from there in order
+static long qf_find_run(QfLayer *layer, long q) {
+	long home = q, run;
+	while (qf_get(layer, home) & SHIFTED) {
+		home = qf_prev(layer, home);
+	}
+
+	// step through the runs and their home slots together until reaching q
+	run = home;
+	while (home != q) {
+		do {
+			run = qf_next(layer, run);
+		} while (qf_get(layer, run) & CONTINUATION);
+		do {
+			home = qf_next(layer, home);
+		} while (!(qf_get(layer, home) & OCCUPIED));
+	}
+	return run;
+}
+
+// does 'layer' hold the remainder of 'key'?
+static bool qf_contains(QfLayer *layer, int64 key) {
+	long q = qf_quotient(layer, key);
+	uint64_t r = qf_remainder(layer, key);
+	if (!(qf_get(layer, q) & OCCUPIED)) {
+		return false;
+	}
+
+	// runs are sorted, so stop at the first larger remainder
+	long i = qf_find_run(layer, q);
+	do {
+		uint64_t found = qf_get(layer, i) >> META_BITS;
+		if (found == r) {
+			return true;
+		}
+		if (found > r) {
+			return false;
+		}
+		i = qf_next(layer, i);
+	} while (qf_get(layer, i) & CONTINUATION);
+	return false;
+}
+
+// put 'slot' at 'i', shifting the remainders from there to the next empty
+// slot along by one. the occupied bits stay with their slots. returns the
+// number of remainders shifted
+static long qf_shift_in(QfLayer *layer, long i, uint64_t slot) {
+	long shifted = 0;
+	uint64_t moving = slot;
+	bool empty;
+	do {
+		uint64_t here = qf_get(layer, i);
+		empty = (here & METADATA) == 0;
+		if (!empty) {
+			here |= SHIFTED;
+			if (here & OCCUPIED) {
+				moving |= OCCUPIED;
+				here &= ~(uint64_t)OCCUPIED;
+			}
+			shifted++;
+		}
+		qf_set(layer, i, moving);
+		moving = here;
+		i = qf_next(layer, i);
+	} while (!empty);
+	return shifted;
+}
+
+// add the remainder of 'key', which 'layer' does not hold, to 'layer'
+static void qf_place(QuotientFilter *filter, QfLayer *layer, int64 key) {
+	long q = qf_quotient(layer, key);
+	uint64_t r = qf_remainder(layer, key);
+	uint64_t home = qf_get(layer, q);
+	uint64_t slot = r << META_BITS;
+	layer->nkeys++;
+
+	// an empty home slot takes the remainder as it is
+	if ((home & METADATA) == 0) {
+		qf_set(layer, q, slot | OCCUPIED);
+		histogram_add(&filter->shifts, 0);
+		return;
+	}
+	qf_set(layer, q, home | OCCUPIED);
+
+	// find where in its run (if it has one yet) the remainder goes
+	long start = qf_find_run(layer, q), i = start;
+	if (home & OCCUPIED) {
+		do {
+			if ((qf_get(layer, i) >> META_BITS) > r) {
+				break;
+			}
+			i = qf_next(layer, i);
+		} while (qf_get(layer, i) & CONTINUATION);
+
+		if (i == start) {
+			// the old head of the run now continues it
+			qf_set(layer, start, qf_get(layer, start) | CONTINUATION);
+		} else {
+			slot |= CONTINUATION;
+		}
+	}
+	if (i != q) {
+		slot |= SHIFTED;
+	}
+	histogram_add(&filter->shifts, qf_shift_in(layer, i, slot));
+}
+
+// add a layer of 'nslots' slots, returning false if it would be too large or
+// there are MAX_LAYERS already
+static bool qf_add_layer(QuotientFilter *filter, long nslots) {
+	if (filter->nlayers == MAX_LAYERS || nslots > MAX_TABLE_SIZE) {
+		return false;
+	}
+	QfLayer *layer = &filter->layers[filter->nlayers];
+	layer->bits = layer_bits(QUOTIENTF_REMAINDER_BITS, filter->nlayers);
+	layer->nslots = nslots;
+	layer->nkeys = 0;
+	layer->slots = new_fields(&filter->memory, nslots, layer->bits + META_BITS);
+	filter->nlayers++;
+	return true;
+}
+
+// is 'layer' as full as it should get?
+static bool qf_full(QfLayer *layer) {
+	return layer->nkeys + 1 > QUOTIENTF_MAX_LOAD * layer->nslots;
+}
+
+QuotientFilter *new_quotient_filter(int size) {
+	Memory memory;
+	memory_init(&memory);
+	QuotientFilter *filter = memory_malloc(&memory, sizeof *filter);
+	assert(filter);
+	filter->memory = memory;
+	filter->nlayers = 0;
+	filter->nkeys = 0;
+	init_histogram(&filter->shifts, "insert shifts", HIST_LOG2);
+	// a slot must always be left empty, to end the last cluster
+	qf_add_layer(filter, round_up(size, 2));
+	return filter;
+}
+
+void free_quotient_filter(QuotientFilter *filter) {
+	assert(filter != NULL);
+	int i;
+	for (i = 0; i < filter->nlayers; i++) {
+		memory_free(&filter->memory, filter->layers[i].slots);
+	}
+	memory_free(&filter->memory, filter);
+}
+
+bool quotient_filter_insert(QuotientFilter *filter, int64 key) {
+	assert(filter != NULL);
+	if (quotient_filter_lookup(filter, key)) {
+		return false;
+	}
+
+	// a full layer is followed by a larger one
+	QfLayer *layer = &filter->layers[filter->nlayers - 1];
+	if (qf_full(layer)) {
+		if (!qf_add_layer(filter, layer->nslots * AMQ_GROWTH)) {
+			return false;
+		}
+		layer = &filter->layers[filter->nlayers - 1];
+	}
+	qf_place(filter, layer, key);
+	filter->nkeys++;
+	return true;
+}
+
+bool quotient_filter_lookup(QuotientFilter *filter, int64 key) {
+	assert(filter != NULL);
+	int l;
+	for (l = filter->nlayers - 1; l >= 0; l--) {
+		if (qf_contains(&filter->layers[l], key)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool quotient_filter_reserve(QuotientFilter *filter, size_t nkeys) {
+	assert(filter != NULL);
+
+	// keys go into the newest layer: see if it has room for the rest
+	QfLayer *layer = &filter->layers[filter->nlayers - 1];
+	double more = (double)nkeys - filter->nkeys;
+	double room = QUOTIENTF_MAX_LOAD * layer->nslots - layer->nkeys;
+	if (more <= 0 || more <= room) {
+		return true;
+	}
+	long nslots = round_up(more / QUOTIENTF_MAX_LOAD + 1, 2);
+
+	// an empty filter can start over with one layer of the right size
+	if (filter->nkeys == 0) {
+		if (nslots > MAX_TABLE_SIZE) {
+			return false;
+		}
+		memory_free(&filter->memory, layer->slots);
+		filter->nlayers = 0;
+	}
+	return qf_add_layer(filter, nslots);
+}
+
+void quotient_filter_print(QuotientFilter *filter) {
+	assert(filter != NULL);
+	int l;
+	long i;
+	for (l = 0; l < filter->nlayers; l++) {
+		QfLayer *layer = &filter->layers[l];
+		printf("--- layer %d: %ld slots, %d bit remainders\n", l,
+			layer->nslots, layer->bits);
+		printf("   address | ocs | remainder\n");
+		for (i = 0; i < layer->nslots; i++) {
+			uint64_t slot = qf_get(layer, i);
+			printf(" %9ld | %c%c%c | ", i,
+				(slot & OCCUPIED) ? 'o' : '-',
+				(slot & CONTINUATION) ? 'c' : '-',
+				(slot & SHIFTED) ? 's' : '-');
+			if (slot & METADATA) {
+				printf("%llx\n", (unsigned long long)(slot >> META_BITS));
+			} else {
+				printf("-\n");
+			}
+		}
+	}
+	printf("--- end table ---\n");
+}
+
+void quotient_filter_get_stats(QuotientFilter *filter,
+		HashTableStats *stats) {
+	assert(filter != NULL);
+	long nslots = 0;
+	int l;
+	for (l = 0; l < filter->nlayers; l++) {
+		nslots += filter->layers[l].nslots;
+	}
+	stats->size = nslots;
+	stats->nkeys = filter->nkeys;
+	stats->load_factor = (double)filter->nkeys / nslots;
+	stats->resizes = filter->nlayers - 1;
+	stats->memory = filter->memory.bytes;
+	stats->peak_memory = filter->memory.peak;
+	add_stats_histogram(stats, &filter->shifts);
+}
+
+void quotient_filter_memory(QuotientFilter *filter, Memory *memory) {
+	assert(filter != NULL);
+	*memory = filter->memory;
+}
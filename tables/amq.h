@@ -0,0 +1,91 @@
+/* * * * * * * * *
+ * Approximate membership tables: a cuckoo filter and a quotient filter. They
+ * hold a short fingerprint of each key instead of the key, so they take a
+ * fraction of the memory of the exact tables, but a lookup of a key that was
+ * never inserted is sometimes answered true (a false positive)
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * The cuckoo filter keeps CUCKOOF_BUCKETSIZE fingerprints per bucket. A key's
+ * first bucket comes from h1, its fingerprint from h2, and its other bucket
+ * from the first and the fingerprint alone (partial-key cuckoo hashing), so a
+ * fingerprint can be kicked between its two buckets without knowing its key.
+ *
+ * The quotient filter splits a key's hash into a quotient (from h1), naming
+ * its home slot, and a remainder (from h2), stored in that slot or shifted
+ * along to the next free one, with three bits per slot recording how.
+ *
+ * Neither can be resized without its keys, so both grow as a series of
+ * layers: when the newest is full, one AMQ_GROWTH times larger is added with
+ * a one bit longer fingerprint (halving its false positive rate), and every
+ * layer is checked on lookup. Reserving room for the keys up front keeps to
+ * one layer. Inserting a key that is (or seems to be) there already returns
+ * false and adds nothing.
+ *
+ * Fingerprints are packed bit to bit. With the default widths a filter sized
+ * by reserve has a false positive rate of about 0.4% at about 12 bits per key
+ * (cuckoo filter) or 0.3% at about 13 (quotient filter), against the 16 bytes
+ * per key of an exact table of int64 keys.
+ */
+
+#ifndef AMQ_H
+#define AMQ_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../inthash.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+
+// fingerprints per cuckoo filter bucket
+#define CUCKOOF_BUCKETSIZE 4
+// fingerprint bits in the first layer of each filter (later layers add one
+// per layer, up to AMQ_MAX_BITS)
+#define CUCKOOF_FINGERPRINT_BITS 11
+#define QUOTIENTF_REMAINDER_BITS 8
+#define AMQ_MAX_BITS 24
+// how much larger each layer is than the one before
+#define AMQ_GROWTH 4
+
+typedef struct cuckoo_filter CuckooFilter;
+typedef struct quotient_filter QuotientFilter;
+
+// a cuckoo filter whose first layer has 'size' buckets
+CuckooFilter *new_cuckoo_filter(int size);
+void free_cuckoo_filter(CuckooFilter *filter);
+
+// add a fingerprint of 'key' to 'filter', unless lookup would find one
+// returns true if added, false if it seemed to be there already (or the
+// filter would grow too large)
+bool cuckoo_filter_insert(CuckooFilter *filter, int64 key);
+
+// false if 'key' was certainly never inserted, true if it may have been
+bool cuckoo_filter_lookup(CuckooFilter *filter, int64 key);
+
+// size the filter for 'nkeys' keys in total (see above). returns false if it
+// would grow too large
+bool cuckoo_filter_reserve(CuckooFilter *filter, size_t nkeys);
+
+// print the fingerprints in each bucket of each layer to stdout
+void cuckoo_filter_print(CuckooFilter *filter);
+void cuckoo_filter_get_stats(CuckooFilter *filter, HashTableStats *stats);
+void cuckoo_filter_memory(CuckooFilter *filter, Memory *memory);
+
+// a quotient filter whose first layer has 'size' slots (at least 2)
+QuotientFilter *new_quotient_filter(int size);
+void free_quotient_filter(QuotientFilter *filter);
+
+// as the cuckoo filter functions above
+bool quotient_filter_insert(QuotientFilter *filter, int64 key);
+bool quotient_filter_lookup(QuotientFilter *filter, int64 key);
+bool quotient_filter_reserve(QuotientFilter *filter, size_t nkeys);
+
+// print the remainder and metadata bits in each slot of each layer to stdout
+void quotient_filter_print(QuotientFilter *filter);
+void quotient_filter_get_stats(QuotientFilter *filter, HashTableStats *stats);
+void quotient_filter_memory(QuotientFilter *filter, Memory *memory);
+
+#endif
@@ -1,6 +1,6 @@
 /* * * * * * * * *
  * Dynamic hash table using cuckoo hashing, resolving collisions by switching
- * keys between two tables with two separate hash functions
+ * keys between two (up to four) tables with separate hash functions
  *
  * created for COMP20007 Design of Algorithms - Assignment 2, 2017
  * by ...
@@ -20,74 +20,129 @@
 
 /* Includes inthash.h */
 #include "cuckoo.h"
+#include "../parallel.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+#include "../trace.h"
 
 /* A multiple by which to increase a tables size */
 #define EXPANSION_FACTOR 2
-#define NSTATS 4
-#define HEADER_MAX_STR_LENGTH 100
 
-// an inner table represents one of the two internal tables for a cuckoo
+/* How many times longer kick chains may grow before upsizing, per inner table
+ * past the second */
+#define KICK_SCALE 8
+
+/* Load over all inner tables that cuckoo_hash_table_reserve sizes for, by
+ * number of inner tables. Two tables of single slots start failing inserts a
+ * little below half full, three at about 90% and four at about 96% */
+static const double reserve_load_factor[CUCKOO_MAX_TABLES + 1] = {
+    0, 0, 0.4, 0.8, 0.9
+};
+
+// an inner table represents one of the internal tables for a cuckoo
 // hash table. it stores two parallel arrays: 'slots' for storing keys and
-// 'inuse' for marking which entries are occupied
+// 'inuse' for marking which entries are occupied (and in map mode a third,
+// 'values', holding the value of each slot's key)
 typedef struct inner_table {
 	int64 *slots;	// array of slots holding keys
 	bool  *inuse;	// is this slot in use or not?
+	unsigned char *values;	// value of each slot's key, or NULL
+	int valuesize;	// bytes in each value (0 if not a map)
+	PagePolicy pages;	// how these arrays are backed
 } InnerTable;
 
-// a cuckoo hash table stores its keys in two inner tables
+// a cuckoo hash table stores its keys in two or more inner tables, inner
+// table t addressing its keys with hash function t+1 (h1, h2, ...)
 struct cuckoo_table {
-	InnerTable *table1; /* array of inner table pointers */
-	InnerTable *table2; /* array of inner table pointers */
+	InnerTable *tables[CUCKOO_MAX_TABLES]; /* array of inner table pointers */
+	int ntables;        // inner tables in use
 	int size;	  		// size of each table
+    int valuesize;      // bytes of value stored with each key (0: no values)
     
     int nkeys;
     double accum_lookup_time;
     double accum_insert_time;
+
+    long nkicks;        // keys evicted from their slot by another key
+    int nresizes;       // times the inner tables have been upsized
+    Histogram chains;   // kicks made by each insert
+    Histogram resizes;  // load factor [%] at which each resize was triggered
+    Memory memory;      // heap memory held by the table and its inner tables
 };
 
 /* PROTOTYPES */
-static InnerTable *new_inner_table(int size);
-static bool upsize_inner_table(InnerTable *table, 
-                                bool first_table,
+static InnerTable *new_inner_table(Memory *memory, int size, int valuesize);
+static bool upsize_inner_table(Memory *memory,
+                                InnerTable *table, 
+                                int t,
                                 int size,
-                                int factor);
+                                int factor,
+                                long *moved);
 
-static void free_inner_table(InnerTable* table);
+static void free_inner_table(Memory *memory, InnerTable* table);
 static bool upsize_hash_table(CuckooHashTable *table, int factor);
-static int get_cuckoo_index(int size, bool first_table,int64 key);
+static int get_cuckoo_index(int size, int t, int64 key);
+static int locate_key(CuckooHashTable *table, int64 key, int *t);
+static void relocate_keys(int start, int end, int worker, void *arg);
+
+// arguments shared by the workers relocating keys of an upsized inner table
+typedef struct relocation {
+    InnerTable *table;  // inner table being upsized
+    int t;              // which inner table (and so hash function) it is
+    int new_size;       // size of the inner table after upsizing
+    long moved[PARALLEL_MAX_WORKERS];   // keys relocated by each worker
+} Relocation;
 
 static InnerTable 
-*new_inner_table(int size) {
+*new_inner_table(Memory *memory, int size, int valuesize) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
      * DESC: Allocate and initialize an inner-table of 'size'
      *
-     * INPT: int size
+     * INPT: Memory *memory
+     *          Accounting to record the inner table's allocations in
+     *
+     *       int size
      *          How many elements the inner table can store
      *
+     *       int valuesize
+     *          Bytes of value stored with each key. 0 for no values.
+     *
      * OTPT: InnerTable*
      *          A pointer to the newly initialized inner table
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-    InnerTable *table = malloc(sizeof(*table));
-    table->slots=calloc((size_t)size, sizeof(int64));
-    table->inuse=calloc((size_t)size, sizeof(bool));
+    InnerTable *table = memory_malloc(memory, sizeof(*table));
+    table->pages=PAGES_DEFAULT;
+    table->slots=memory_alloc_pages(memory, sizeof(int64)*size, table->pages);
+    table->inuse=memory_alloc_pages(memory, sizeof(bool)*size, table->pages);
+    table->valuesize=valuesize;
+    table->values=NULL;
+    if (valuesize) {
+        table->values=memory_alloc_pages(memory, (size_t)valuesize*size,
+                table->pages);
+    }
     return(table);
 }
 
-static bool upsize_inner_table(InnerTable *table, 
-                                bool first_table, 
+static bool upsize_inner_table(Memory *memory,
+                                InnerTable *table, 
+                                int t, 
                                 int size, 
-                                int factor) {
+                                int factor,
+                                long *moved) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
      * DESC: Increase the size of a given inner table by an integer factor.
      *       Rehash all elements of the table where necessary.
      *
-     * INPT: InnerTable *table
+     * INPT: Memory *memory
+     *          Accounting to record the resized arrays in
+     *
+     *       InnerTable *table
      *          Pointer to the inner table on which to operate.
      *
-     *       bool first_table
-     *          Indicate which inner table this is. True for the first inner
-     *          table. False for the second. 
+     *       int t
+     *          Indicate which inner table this is, from 0 for the first. Inner
+     *          table t addresses its keys with hash function t+1.
      *
      *       int size
      *          How many elements the inner table currently stores
@@ -98,6 +153,9 @@ static bool upsize_inner_table(InnerTable *table,
      *          mathematical laws like all things on the universe. The law
      *          requires this be an integer. (For rehashing items)
      *
+     *       long *moved
+     *          Set to the number of keys that changed slot.
+     *
      * OTPT: bool
      *          Indicates the status of the resize operation. True if resize and
      *          rehash sucessful. False if not.
@@ -119,58 +177,135 @@ static bool upsize_inner_table(InnerTable *table,
     
     /* Factor needs to be greater than zero. Validate */
     if (factor<0) {return(false);}
-    int ix, new_index, new_size=size * factor;
+    int ix, new_size=size * factor;
     
     /* Fail the new size will be greater than what is allowed. */
     if (new_size > MAX_TABLE_SIZE) {return(false);}
 
     /* Realloc the table members and return false if failed */
-    table->slots = realloc(table->slots, sizeof(int64)*new_size);
-    table->inuse = realloc(table->inuse, sizeof(bool)*new_size);
+    table->slots = memory_realloc_pages(memory, table->slots,
+            sizeof(int64)*new_size, table->pages);
+    table->inuse = memory_realloc_pages(memory, table->inuse,
+            sizeof(bool)*new_size, table->pages);
     if (table->slots == NULL || table->inuse == NULL ) {return(false);}
+    if (table->valuesize) {
+        table->values = memory_realloc_pages(memory, table->values,
+                (size_t)table->valuesize*new_size, table->pages);
+        if (table->values == NULL) {return(false);}
+    }
 
     /* Initialize usage indicator of new part of inner table */
     for(ix=size; ix<new_size; ix++) {table->inuse[ix]=false;}
 
-    /* Relocate and vacate all keys that have their hash position changed */
-    for (ix=0;ix<size;ix++) {
+    /* Relocate and vacate all keys that have their hash position changed.
+     * Every key lands in a slot no other key can, so large tables are split
+     * into ranges and relocated by a pool of workers */
+    Relocation relocation = {table, t, new_size, {0}};
+    int nworkers = parallel_worker_count();
+    if (size < PARALLEL_MIN_ITEMS) {nworkers = 1;}
+    parallel_for(size, nworkers, relocate_keys, &relocation);
+
+    *moved = 0;
+    for (ix=0; ix<PARALLEL_MAX_WORKERS; ix++) {*moved += relocation.moved[ix];}
+
+    return(true);
+}
+
+static void relocate_keys(int start, int end, int worker, void *arg) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Move the keys in slots [start, end) of an upsized inner table to
+     *       their index under the new size. See upsize_inner_table().
+     *
+     * INPT: int start, int end
+     *          Range of (old) slots to relocate
+     *
+     *       int worker
+     *          Id of the worker running this range, to count keys moved.
+     *
+     *       void *arg
+     *          Relocation describing the table being upsized
+     *
+     * NOTE: A key at old index ix moves to ix + f*old_size, which is in the
+     *       newly allocated part of the table and unique to ix, so ranges can
+     *       be relocated concurrently without locking.
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    Relocation *relocation = arg;
+    InnerTable *table = relocation->table;
+    int ix, new_index;
+
+    for (ix=start;ix<end;ix++) {
 
         /* Transfer over key if there is one */
         if (table->inuse[ix]) {
 
             /* Get new hashmod (index) given the new size */
-            new_index=get_cuckoo_index(new_size,first_table,table->slots[ix]);
+            new_index=get_cuckoo_index(relocation->new_size,
+                                       relocation->t,
+                                       table->slots[ix]);
 
             /* No change if hashmod with new size gives same result */
             if (ix != new_index) {
 
-                /* Move key to its new location, vacate old slot. */
+                /* Move key (and value) to its new location, vacate old slot*/
                 table->slots[new_index]=table->slots[ix]; 
+                if (table->valuesize) {
+                    memcpy(table->values + (size_t)new_index*table->valuesize,
+                           table->values + (size_t)ix*table->valuesize,
+                           table->valuesize);
+                }
                 table->inuse[ix]=false;
                 table->inuse[new_index]=true;
+                relocation->moved[worker]++;
             }
         }
     }
-
-    return(true);
 }
 
 /* Free all memory associated with an inner table */
-static void free_inner_table(InnerTable* table) {
-    free(table->slots);
-    free(table->inuse);
-    free(table);
+static void free_inner_table(Memory *memory, InnerTable* table) {
+    memory_free_pages(memory, table->slots);
+    memory_free_pages(memory, table->inuse);
+    memory_free_pages(memory, table->values);
+    memory_free(memory, table);
 }
 
 /* Get index for a given key and inner table */
-static int get_cuckoo_index(int size, bool first_table,int64 key){
-    if (first_table) {
-        return(h1(key)%size);
-    } else {
-        return(h2(key)%size);
+static int get_cuckoo_index(int size, int t, int64 key){
+    switch (t) {
+        case 0: return(h1(key)%size);
+        case 1: return(h2(key)%size);
+        case 2: return(h3(key)%size);
+        default: return(h4(key)%size);
     }
 }
 
+/* Find the slot holding 'key'. Returns its index and sets 't' to the inner
+ * table it is in, or returns -1 if 'key' is not in the table */
+static int locate_key(CuckooHashTable *table, int64 key, int *t) {
+    int i, index[CUCKOO_MAX_TABLES];
+
+    /* With more than two inner tables, work out every candidate slot first
+     * and prefetch them all, so their cache misses overlap instead of being
+     * taken one after another */
+    for (i=0; i<table->ntables; i++) {
+        index[i] = get_cuckoo_index(table->size, i, key);
+        if (table->ntables > 2) {
+            __builtin_prefetch(&table->tables[i]->slots[index[i]]);
+            __builtin_prefetch(&table->tables[i]->inuse[index[i]]);
+        }
+    }
+
+    for (i=0; i<table->ntables; i++) {
+        InnerTable *inner = table->tables[i];
+        if (inner->inuse[index[i]] && inner->slots[index[i]]==key) {
+            *t = i;
+            return(index[i]);
+        }
+    }
+    return(-1);
+}
+
 static bool upsize_hash_table(CuckooHashTable *table, int factor) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
      * DESC: Increases the size of a CuckooHashTable's inner tables
@@ -183,21 +318,48 @@ static bool upsize_hash_table(CuckooHashTable *table, int factor) {
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
-    bool status=false;
+    bool status=true;
+    long moved=0, moved_total=0;
+    uint64_t start=trace_clock();
+    int t;
     /* Upsize the the inner tables and return status */
     
     /* Lazily upside the tables. Track the sucess of upsize operations.*/
-    if (upsize_inner_table(table->table1, true, table->size, factor)) {
-        status = (upsize_inner_table(table->table2,false, table->size, factor));
+    for (t=0; t<table->ntables && status; t++) {
+        status = upsize_inner_table(&table->memory, table->tables[t], t,
+                table->size, factor, &moved);
+        moved_total += moved;
     }
 
+    /* A table too large to upsize fails on its first inner table, before
+     * any has changed, so the table is left as it was */
+    if (!status) {return(false);}
+
     /* Update the table size */
     table->size*=factor;
+    table->nresizes++;
+
+    /* Sizes are in slots over all inner tables, as in the stats */
+    trace_record(TRACE_CUCKOO_UPSIZE, start,
+            (long)table->ntables*table->size/factor,
+            (long)table->ntables*table->size, moved_total);
     return(status);
 }
 
 // initialise a cuckoo hash table with 'size' slots in each table
 CuckooHashTable *new_cuckoo_hash_table(int size) {
+    return(new_cuckoo_hash_map(size, 0));
+}
+
+// initialise a cuckoo hash table with 'size' slots in each table, storing a
+// value of 'valuesize' bytes with each key
+CuckooHashTable *new_cuckoo_hash_map(int size, int valuesize) {
+    return(new_cuckoo_dary_hash_map(size, valuesize, 2));
+}
+
+// initialise a cuckoo hash table of 'ntables' inner tables
+CuckooHashTable *new_cuckoo_dary_hash_map(int size, int valuesize,
+        int ntables) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
      * DESC: Allocate and initialize cuckoo hash table.
      *
@@ -205,20 +367,42 @@ CuckooHashTable *new_cuckoo_hash_table(int size) {
      *          number of elements each table of the cuckoo strucure can
      *          store.
      *
+     *       int valuesize
+     *          bytes of value stored with each key, 0 for a plain table
+     *
+     *       int ntables
+     *          number of inner tables (and hash functions), 2 to
+     *          CUCKOO_MAX_TABLES
+     *
      * OTPT: CuckooHashTable*
-     *          initialized, empty cuckoo table pointer
+     *          initialized, empty cuckoo table pointer, or NULL if ntables
+     *          is out of range
      * 
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+    if (ntables < 2 || ntables > CUCKOO_MAX_TABLES) {return(NULL);}
+
     /* Initialize the cuckoo table structure */
-    CuckooHashTable *cuckoo_table = malloc(sizeof(*cuckoo_table));
+    Memory memory;
+    memory_init(&memory);
+    CuckooHashTable *cuckoo_table = memory_malloc(&memory, sizeof(*cuckoo_table));
+    cuckoo_table->memory=memory;
     cuckoo_table->size=size;
 
     /* Initialize the inner tables */
-    cuckoo_table->table1=new_inner_table(size);
-    cuckoo_table->table2=new_inner_table(size);
+    cuckoo_table->valuesize=valuesize;
+    cuckoo_table->ntables=ntables;
+    int t;
+    for (t=0; t<ntables; t++) {
+        cuckoo_table->tables[t]=new_inner_table(&cuckoo_table->memory, size,
+                valuesize);
+    }
 
     cuckoo_table->nkeys=0;
+    cuckoo_table->nkicks=0;
+    cuckoo_table->nresizes=0;
+    init_histogram(&cuckoo_table->chains, "kick chain length", 1);
+    init_histogram(&cuckoo_table->resizes, "resize load [%]", 5);
     cuckoo_table->accum_lookup_time=0;
     cuckoo_table->accum_insert_time=0;
 
@@ -235,17 +419,92 @@ void free_cuckoo_hash_table(CuckooHashTable *table) {
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
     /* Free members */
-    free_inner_table(table->table1);
-    free_inner_table(table->table2);
+    int t;
+    for (t=0; t<table->ntables; t++) {
+        free_inner_table(&table->memory, table->tables[t]);
+    }
         
     /* Free structure */
-    free(table);
+    memory_free(&table->memory, table);
+}
+
+// make room for 'nkeys' keys in total, so inserting them does not upsize
+bool cuckoo_hash_table_reserve(CuckooHashTable *table, size_t nkeys) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Upsize all inner tables at once to hold 'nkeys' keys at a load
+     *       of at most reserve_load_factor, instead of through a doubling
+     *       each time inserts start kicking too much.
+     *
+     * INPT: CuckooHashTable *table
+     *          table to make room in
+     *
+     *       size_t nkeys
+     *          number of keys expected in the table in total
+     *
+     * OTPT: bool
+     *          false if the table would grow too large, otherwise true. A
+     *          table that is already large enough is left as it is.
+     *
+     * NOTE: The factor is a power of two so every inner table size remains
+     *       the initial size times a power of two, as with doubling.
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+    /* Slots each inner table needs */
+    double needed = nkeys / (table->ntables
+            * reserve_load_factor[table->ntables]);
+    long factor = 1;
+
+    while ((double)table->size * factor < needed) {
+        factor *= 2;
+        if ((long)table->size * factor > MAX_TABLE_SIZE) {return(false);}
+    }
+
+    if (factor == 1) {return(true);}
+    return(upsize_hash_table(table, (int)factor));
+}
+
+// back the arrays of every inner table as 'policy' asks
+void cuckoo_hash_table_set_pages(CuckooHashTable *table, PagePolicy policy) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Move each inner table's arrays to memory backed as 'policy'
+     *       asks. Upsizing keeps to the same policy afterwards.
+     *
+     * INPT: CuckooHashTable *table
+     *          table whose inner tables are moved
+     *
+     *       PagePolicy policy
+     *          how to back them (see memacct.h)
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    int t;
+    for (t=0; t<table->ntables; t++) {
+        InnerTable *inner = table->tables[t];
+        inner->pages = policy;
+        inner->slots = memory_realloc_pages(&table->memory, inner->slots,
+                sizeof(int64)*table->size, policy);
+        inner->inuse = memory_realloc_pages(&table->memory, inner->inuse,
+                sizeof(bool)*table->size, policy);
+        assert(inner->slots && inner->inuse);
+        if (inner->valuesize) {
+            inner->values = memory_realloc_pages(&table->memory,
+                    inner->values, (size_t)inner->valuesize*table->size,
+                    policy);
+            assert(inner->values);
+        }
+    }
 }
 
 
 bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
+    return(cuckoo_hash_table_put(table, key, NULL, false));
+}
+
+bool cuckoo_hash_table_put(CuckooHashTable *table, int64 key,
+        const void *value, bool replace) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
-     * DESC: Insert 'key' into 'table', if it's not in there already 
+     * DESC: Insert 'key' into 'table' with 'value', if it's not in there
+     *       already 
      *
      * INPT: CuckooHashTable *table
      *          table in which key will be inserted
@@ -253,9 +512,18 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
      *       int64 key
      *          the integer key to insert
      *
+     *       const void *value
+     *          the value to store with the key (zeros if NULL). Ignored
+     *          unless the table is a map.
+     *
+     *       bool replace
+     *          overwrite the value of 'key' if it is already in the table
+     *
      * OTPT: bool
      *          indicates insertion sucess if true, otherwise false
      *
+     * NOTE: Values are carried along with their keys as they are kicked.
+     *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
     /* Time insertion */
@@ -265,53 +533,87 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
      * part of insertion */
     double original_accum_lookup_time = table->accum_lookup_time;
 
-    /* See if the key is already in the table */
-    if (cuckoo_hash_table_lookup(table, key)) {
+    /* Helper fn, get the value stored at a given inner table location */
+    unsigned char *get_value(int t, int index) {
+        return(table->tables[t]->values + (size_t)index*table->valuesize);
+    }
+
+    /* Helper fn, copy a value (zeros if NULL) to a value slot */
+    void copy_value(unsigned char *to, const void *from) {
+        if (from) {
+            memcpy(to, from, table->valuesize);
+        } else {
+            memset(to, 0, table->valuesize);
+        }
+    }
+
+    /* See if the key is already in the table, updating its value if asked */
+    int found_table;
+    int found_index = locate_key(table, key, &found_table);
+    if (found_index >= 0) {
+        if (replace && table->valuesize) {
+            copy_value(get_value(found_table, found_index), value);
+        }
         return(false);
     }
 
-    /* Helper fn, calculates a kick threshold before increasing cuckoo size */
+    /* Values of the key being placed and of the key it kicks out */
+    int width = table->valuesize ? table->valuesize : 1;
+    unsigned char carried[2][width];
+    unsigned char *current_value = carried[0], *next_value = carried[1];
+    if (table->valuesize) {copy_value(current_value, value);}
+
+    /* Helper fn, calculates a kick threshold before increasing cuckoo size.
+     * With more than two tables a walk almost always ends in a free slot if
+     * given long enough, so walks are allowed to run much longer to fill the
+     * table to 90% and beyond */
     int get_kick_threshold(int size) {
-        return((int)log2(size)+1);
+        if (table->ntables == 2) {
+            return((int)log2(size)+1);
+        }
+        return(((int)log2(size)+1) * KICK_SCALE * (table->ntables-1));
     }
 
     /* Helper fn, get usage for a given inner table location */
-    bool get_usage(bool first_table, int index) {
-        if (first_table) {
-            return(table->table1->inuse[index]);
-        } else {
-            return(table->table2->inuse[index]); }
+    bool get_usage(int t, int index) {
+        return(table->tables[t]->inuse[index]);
     }
 
     /* Helper fn, get a key for a given inner table */
-    int64 get_key(bool first_table, int index) {
-        if (first_table) {
-            return(table->table1->slots[index]);
-        } else {
-            return(table->table2->slots[index]);
-        }
+    int64 get_key(int t, int index) {
+        return(table->tables[t]->slots[index]);
     }
 
     /* Helper fn, Write key to cuckoo table to a given location */
-    void write_key(bool first_table, int index, int64 key) {
-        if (first_table) {
-            table->table1->slots[index] = key;
-            table->table1->inuse[index] = true;
-        } else {
-            table->table2->slots[index] = key;
-            table->table2->inuse[index] = true;
+    void write_key(int t, int index, int64 key) {
+        table->tables[t]->slots[index] = key;
+        table->tables[t]->inuse[index] = true;
+    }
+
+    /* Helper fn, with more than two inner tables, find an inner table with a
+     * free slot for 'key' so it can be placed without kicking. Returns
+     * 'start' if there is none */
+    int find_free_table(int64 key, int start) {
+        int i, t;
+        for (i=0; i<table->ntables; i++) {
+            t = (start+i) % table->ntables;
+            if (!get_usage(t, get_cuckoo_index(table->size, t, key))) {
+                return(t);
+            }
         }
+        return(start);
     }
 
     /* kick_count threshold for expansion of cuckoo hash table. */
     int expansion_threshold = get_kick_threshold(table->size);
 
     /* Init loop variables */
-    bool use_first_table = true;
+    int use_table = 0;   // Inner table the current key is being placed in
     int current_index;   // Index for the current key in the current inner table
     int kick_count=0;    // A counter for the number of kicks required on insert
+    int chain_length=0;  // Kicks over the whole insert, across any resizes
     bool loop_exit = false;
-    int64 next_key, current_key=key; 
+    int64 next_key=0, current_key=key; 
 
     /* Insert and cuckoo keys as necessary */
     while (loop_exit == false) {
@@ -319,8 +621,12 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
         /* Loop detection and threshold detection for resizing table */
         /* Loop has occured once loop is back at it's initial state */
         if ( (kick_count > expansion_threshold) || 
-             ((kick_count != 0) && (current_key == key) && use_first_table) ) {
+             ((kick_count != 0) && (current_key == key) && use_table == 0) ) {
             
+            /* Record the load that forced the resize */
+            histogram_add(&table->resizes,
+                    100*table->nkeys/((long)table->ntables*table->size));
+
             /* Upsize hash table, return false if fails */
             if (!(upsize_hash_table(table, (int)EXPANSION_FACTOR))){
                 return(false);}
@@ -333,17 +639,29 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
             expansion_threshold = get_kick_threshold(table->size);
         }
 
+        /* Two inner tables are simply alternated. With more, prefer any
+         * free slot the key has before kicking another key out */
+        if (table->ntables > 2) {
+            use_table = find_free_table(current_key, use_table);
+        }
+
         /* Get key index*/
         current_index = get_cuckoo_index(table->size, 
-                                         use_first_table,
+                                         use_table,
                                          current_key);
         
         /* Grab kicked key if there is one*/
-        if (get_usage(use_first_table, current_index)){
+        if (get_usage(use_table, current_index)){
 
-            /* Grab key and increment kick count */
-            next_key = get_key(use_first_table, current_index);
+            /* Grab key (and value) and increment kick count */
+            next_key = get_key(use_table, current_index);
+            if (table->valuesize) {
+                memcpy(next_value, get_value(use_table, current_index),
+                       table->valuesize);
+            }
             kick_count++;
+            chain_length++;
+            table->nkicks++;
 
         } else {
 
@@ -352,14 +670,22 @@ bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key) {
         }
 
         /* Write the key to its hashed slot (overwrites whatever was there)*/
-        write_key(use_first_table, current_index, current_key);
+        write_key(use_table, current_index, current_key);
+        if (table->valuesize) {
+            memcpy(get_value(use_table, current_index), current_value,
+                   table->valuesize);
+        }
 
-        /* Update key and the inner table to be used */
+        /* Update key (and value) and the inner table to be used */
         current_key=next_key;
-        use_first_table = !(use_first_table);
+        unsigned char *swap = current_value;
+        current_value = next_value;
+        next_value = swap;
+        use_table = (use_table+1) % table->ntables;
     }
 
     table->nkeys++;
+    histogram_add(&table->chains, chain_length);
 
     /* Reset lookup time */
     table->accum_lookup_time = original_accum_lookup_time;
@@ -388,27 +714,56 @@ bool cuckoo_hash_table_lookup(CuckooHashTable *table, int64 key) {
 
     /* Time operation */
     int start_time = clock();
-    bool found = false;
+    int t;
 
-    /* Lazy check if in either inner table */
-    int hash1 = h1(key) % table->size;
-    found = (table->table1->inuse[hash1] && table->table1->slots[hash1]==key);
-
-    if (!found) {
-        int hash2 = h2(key) % table->size;
-        found = (table->table2->inuse[hash2] && table->table2->slots[hash2]==key);
-    }
+    /* Lazy check if in any inner table */
+    bool found = (locate_key(table, key, &t) >= 0);
 
     /* Accumulate lookup time */
     table->accum_lookup_time += clock()-start_time;
     return(found);
 }
 
+// lookup 'key' in 'table', copying its value into 'value' (unless NULL)
+bool cuckoo_hash_table_get(CuckooHashTable *table, int64 key, void *value) {
+    int start_time = clock();
+    int t;
+    int index = locate_key(table, key, &t);
+
+    /* Copy out the value from whichever inner table holds the key */
+    if (index >= 0 && value && table->valuesize) {
+        InnerTable *inner = table->tables[t];
+        memcpy(value, inner->values + (size_t)index*table->valuesize,
+               table->valuesize);
+    }
+
+    table->accum_lookup_time += clock()-start_time;
+    return(index >= 0);
+}
+
 // print the contents of 'table' to stdout
 void cuckoo_hash_table_print(CuckooHashTable *table) {
 	assert(table);
 	printf("--- table size: %d\n", table->size);
 
+	// more than two inner tables are printed one after another
+	if (table->ntables > 2) {
+		int t, i;
+		for (t = 0; t < table->ntables; t++) {
+			printf("table %d\n", t + 1);
+			printf("  address | key\n");
+			for (i = 0; i < table->size; i++) {
+				if (table->tables[t]->inuse[i]) {
+					printf(" %9d | %llu\n", i, table->tables[t]->slots[i]);
+				} else {
+					printf(" %9d | -\n", i);
+				}
+			}
+		}
+		printf("--- end table ---\n");
+		return;
+	}
+
 	// print header
 	printf("                    table one         table two\n");
 	printf("                  key | address     address | key\n");
@@ -418,8 +773,8 @@ void cuckoo_hash_table_print(CuckooHashTable *table) {
 	for (i = 0; i < table->size; i++) {
 
 		// table 1 key
-		if (table->table1->inuse[i]) {
-			printf(" %20llu ", table->table1->slots[i]);
+		if (table->tables[0]->inuse[i]) {
+			printf(" %20llu ", table->tables[0]->slots[i]);
 		} else {
 			printf(" %20s ", "-");
 		}
@@ -428,8 +783,8 @@ void cuckoo_hash_table_print(CuckooHashTable *table) {
 		printf("| %-9d %9d |", i, i);
 
 		// table 2 key
-		if (table->table2->inuse[i]) {
-			printf(" %llu\n", table->table2->slots[i]);
+		if (table->tables[1]->inuse[i]) {
+			printf(" %llu\n", table->tables[1]->slots[i]);
 		} else {
 			printf(" %s\n",  "-");
 		}
@@ -439,83 +794,36 @@ void cuckoo_hash_table_print(CuckooHashTable *table) {
 	printf("--- end table ---\n");
 }
 
-// print some statistics about 'table' to stdout
-void cuckoo_hash_table_stats(CuckooHashTable *table) {
-	fprintf(stderr, "Please see the print csv data functions.\n");
-    fprintf(stderr, "Press h for additional csv stat print commands\n");
+// fill 'stats' with the statistics this table tracks
+void cuckoo_hash_table_get_stats(CuckooHashTable *table, HashTableStats *stats) {
+    /* Size and load are over the slots of all inner tables */
+    stats->size = (long)table->ntables*table->size;
+    stats->nkeys = table->nkeys;
+    stats->load_factor = (double)table->nkeys/stats->size;
+    stats->resizes = table->nresizes;
+    stats->kicks = table->nkicks;
+    stats->insert_time = 1000*table->accum_insert_time/CLOCKS_PER_SEC;
+    stats->lookup_time = 1000*table->accum_lookup_time/CLOCKS_PER_SEC;
+    stats->memory = table->memory.bytes;
+    stats->peak_memory = table->memory.peak;
+    add_stats_histogram(stats, &table->chains);
+    add_stats_histogram(stats, &table->resizes);
 }
 
-// Returns csv stat header 
-static char** get_stat_header() {
-    int ix, n_columns = NSTATS;
-    char** header= malloc(sizeof(char*)*n_columns);
-
-    /* Allocate memory for header strings */
-    for (ix=0; ix<n_columns; ix++) {
-        header[ix]=malloc(sizeof(char)*HEADER_MAX_STR_LENGTH);
-    }
-
-    strcpy(header[0],"table size [slots]");
-    strcpy(header[1],"lookup time [ms]");
-    strcpy(header[2],"insert time [ms]");
-    strcpy(header[3],"keycount [keys]");
-
-    return(header);
-}
-
-// Print csv stat header to stdout
-static void print_stat_header(char** header) {
-    int ix, n_columns=NSTATS;
-    char seperator=',';
-    for (ix=0; ix<n_columns; ix++) {
-        printf("%s", header[ix]);
-        if (ix!=(n_columns-1)) {
-            printf("%c", seperator);
-        }
-    }
-    printf("\n");
+// copy the memory currently and at most held by 'table' into 'memory'
+void cuckoo_hash_table_memory(CuckooHashTable *table, Memory *memory) {
+    *memory = table->memory;
 }
 
-// Get a csv row of statistics for the table 
-static double* get_stat_row(CuckooHashTable* table) {
-    int n_columns = NSTATS;
-    double* statrow = malloc(sizeof(double) * n_columns);
-
-    double insert_time = 1000*table->accum_insert_time/CLOCKS_PER_SEC;
-    long double lookup_time = 1000*table->accum_lookup_time/CLOCKS_PER_SEC;
 
-    statrow[0] = table->size;
-    statrow[1] = lookup_time;
-    statrow[2] = insert_time;
-    statrow[3] = table->nkeys;
-
-    return(statrow);
-}
-
-// Print statistics to stdout
-static void print_stat_row(double *statrow) {
-    char seperator = ',';
-    int ix, n_columns=NSTATS;
-    for (ix=0; ix<n_columns;ix++) {
-        printf("%3.9f", statrow[ix]);
-        if (ix!=(n_columns-1)) {
-            printf("%c", seperator);
-        }
+// write every inner table of 'table' to 'writer' as slot sections
+void cuckoo_hash_table_save(CuckooHashTable *table, SnapshotWriter *writer) {
+    /* Inner tables keep one key per slot, so map straight onto slot sections
+     * using the same hash function as the inner table */
+    int t;
+    for (t=0; t<table->ntables; t++) {
+        snapshot_write_slots(writer, SNAPSHOT_SLOTS, t+1,
+                table->tables[t]->slots, table->tables[t]->inuse,
+                table->size);
     }
-    printf("\n");
-}
-
-// Get stats and print to stdout
-void cuckoo_hash_table_csv_stats(CuckooHashTable *table) {
-    double* stats = get_stat_row(table);
-    print_stat_row(stats);
-    free(stats);
 }
-
-// Get stats header and print to stdout
-void cuckoo_hash_table_csv_stats_header (CuckooHashTable *table) {
-    char** header =get_stat_header();
-    print_stat_header(header);
-    free(header);
-}
-
@@ -1,6 +1,7 @@
 /* * * * * * PT* * *
  * Dynamic hash table using cuckoo hashing, resolving collisions by switching
- * keys between two tables with two separate hash functions
+ * keys between two tables with two separate hash functions (or between up to
+ * CUCKOO_MAX_TABLES tables with as many, d-ary cuckoo hashing)
  *
  * created for COMP20007 Design of Algorithms - Assignment 2, 2017
  * by ...
@@ -11,12 +12,30 @@
 
 #include <stdbool.h>
 #include "../inthash.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+#include "../snapshot.h"
+
+// the most inner tables (and hash functions) a cuckoo table can have. each
+// one more lets the table fill further before an insert cannot place its key:
+// to under 50% with two, 90% with three, 96% with four, at the cost of one
+// more slot to check per lookup (the slots are prefetched together)
+#define CUCKOO_MAX_TABLES 4
 
 typedef struct cuckoo_table CuckooHashTable;
 
 // initialise a cuckoo hash table with 'size' slots in each table
 CuckooHashTable *new_cuckoo_hash_table(int size);
 
+// initialise a cuckoo hash table with 'size' slots in each table, storing a
+// value of 'valuesize' bytes with each key
+CuckooHashTable *new_cuckoo_hash_map(int size, int valuesize);
+
+// as new_cuckoo_hash_map, but with 'ntables' inner tables (2 to
+// CUCKOO_MAX_TABLES) instead of two. returns NULL if 'ntables' is out of range
+CuckooHashTable *new_cuckoo_dary_hash_map(int size, int valuesize,
+	int ntables);
+
 // free all memory associated with 'table'
 void free_cuckoo_hash_table(CuckooHashTable *table);
 
@@ -24,20 +43,38 @@ void free_cuckoo_hash_table(CuckooHashTable *table);
 // returns true if insertion succeeds, false if it was already in there
 bool cuckoo_hash_table_insert(CuckooHashTable *table, int64 key);
 
+// insert 'key' with 'value' (zeros if NULL) into 'table'. if 'key' is already
+// in there, its value is overwritten only if 'replace'
+// returns true if 'key' was inserted, false if it was already in there
+bool cuckoo_hash_table_put(CuckooHashTable *table, int64 key,
+	const void *value, bool replace);
+
+// make room for 'nkeys' keys in total, so inserting them does not upsize the
+// table. returns false if the table would grow too large
+bool cuckoo_hash_table_reserve(CuckooHashTable *table, size_t nkeys);
+
+// back the inner tables of 'table' as 'policy' asks (moving them if need
+// be), now and whenever they upsize
+void cuckoo_hash_table_set_pages(CuckooHashTable *table, PagePolicy policy);
+
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool cuckoo_hash_table_lookup(CuckooHashTable *table, int64 key);
 
+// lookup 'key' in 'table', copying its value into 'value' (unless NULL)
+// returns true if found, false if not
+bool cuckoo_hash_table_get(CuckooHashTable *table, int64 key, void *value);
+
 // print the contents of 'table' to stdout
 void cuckoo_hash_table_print(CuckooHashTable *table);
 
-// print some statistics about 'table' to stdout
-void cuckoo_hash_table_stats(CuckooHashTable *table);
+// fill 'stats' with the statistics this table tracks
+void cuckoo_hash_table_get_stats(CuckooHashTable *table, HashTableStats *stats);
 
-// print statistics in csv format
-void cuckoo_hash_table_csv_stats(CuckooHashTable *table);
+// write every inner table of 'table' to 'writer' as slot sections
+void cuckoo_hash_table_save(CuckooHashTable *table, SnapshotWriter *writer);
 
-// print header for csv format statistics
-void cuckoo_hash_table_csv_stats_header (CuckooHashTable *table);
+// copy the memory currently and at most held by 'table' into 'memory'
+void cuckoo_hash_table_memory(CuckooHashTable *table, Memory *memory);
 
 #endif
@@ -0,0 +1,402 @@
+/* * * * * * * * *
+ * Dynamic hash table using hopscotch hashing to resolve collisions (see
+ * hopscotch.h)
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <math.h>
+
+#include "hopscotch.h"
+#include "../trace.h"
+
+#if HOP_RANGE == 64
+typedef uint64_t Hops;
+#elif HOP_RANGE == 32
+typedef uint32_t Hops;
+#else
+#error "HOP_RANGE must be 32 or 64"
+#endif
+
+// the load factor hopscotch_hash_table_reserve sizes the table for, leaving
+// room below the load at which inserts start to fail (see HOP_RANGE)
+#define RESERVE_LOAD_FACTOR 0.85
+
+struct hopscotch_table {
+	int64 *slots;			// size + HOP_RANGE - 1 slots holding keys
+	bool  *inuse;			// is this slot in use or not?
+	Hops  *hops;			// per home slot: which of its neighbourhood's
+							// slots hold its keys (bit i: slot home + i)
+	unsigned char *values;	// in map mode, the value of each slot's key
+	int valuesize;			// bytes in each value (0 if not a map)
+	int size;				// home slots right now
+	int load;				// keys in the table right now
+
+	long collisions;		// inserts that could not use their home slot
+	long distance;			// total distance of keys from their home slot
+	long nhops;				// keys moved to bring a free slot closer
+	int nresizes;			// how many times the table has grown
+	bool rehashing;			// are keys being reinserted by resize_table?
+
+	Histogram insert_probes;	// slots passed looking for a free slot
+	Histogram insert_hops;		// keys moved by each insert
+	Histogram hit_probes;		// keys compared by lookups that find theirs
+	Histogram miss_probes;		// and by those that do not
+
+	Memory memory;			// heap memory held by the table, struct included
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// slots in the arrays of a table of 'size' home slots
+static int nslots(int size) {
+	return size + HOP_RANGE - 1;
+}
+
+// set up the arrays of 'table' for 'size' home slots, all empty
+static void initialise_table(HopscotchHashTable *table, int size) {
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
+	int n = nslots(size);
+
+	table->slots = memory_malloc(&table->memory, (sizeof *table->slots) * n);
+	table->inuse = memory_calloc(&table->memory, n, sizeof *table->inuse);
+	table->hops = memory_calloc(&table->memory, n, sizeof *table->hops);
+	assert(table->slots && table->inuse && table->hops);
+	table->values = NULL;
+	if (table->valuesize) {
+		table->values = memory_malloc(&table->memory,
+			(size_t)table->valuesize * n);
+		assert(table->values);
+	}
+
+	table->size = size;
+	table->load = 0;
+	table->collisions = 0;
+	table->distance = 0;
+}
+
+// the value stored with the key in slot 'slot' of 'values'
+static unsigned char *value_at(HopscotchHashTable *table,
+		unsigned char *values, int slot) {
+	return values + (size_t)slot * table->valuesize;
+}
+
+// store 'value' (or zeros, if NULL) as the value of the key in slot 'slot'
+static void write_value(HopscotchHashTable *table, int slot,
+		const void *value) {
+	if (!table->valuesize) {
+		return;
+	}
+	if (value) {
+		memcpy(value_at(table, table->values, slot), value, table->valuesize);
+	} else {
+		memset(value_at(table, table->values, slot), 0, table->valuesize);
+	}
+}
+
+// the home slot of 'key'
+static int home_of(HopscotchHashTable *table, int64 key) {
+	return h1(key) % table->size;
+}
+
+// find the slot of 'table' holding 'key', or -1 if 'key' is not in there.
+// only the slots marked in the home slot's bitmap are compared. the probes
+// are recorded in the lookup histograms only if 'record' (not for the
+// duplicate check of an insert)
+static int find_slot(HopscotchHashTable *table, int64 key, bool record) {
+	assert(table != NULL);
+	int home = home_of(table, key);
+	Hops hops = table->hops[home];
+	int probes = 0;
+
+	while (hops) {
+		int slot = home + __builtin_ctzll(hops);
+		probes++;
+		if (table->slots[slot] == key) {
+			if (record) {
+				histogram_add(&table->hit_probes, probes);
+			}
+			return slot;
+		}
+		hops &= hops - 1;
+	}
+	if (record) {
+		histogram_add(&table->miss_probes, probes);
+	}
+	return -1;
+}
+
+// move a key from before free slot 'free' into it, so that the slot left free
+// is closer to the front. returns the slot now free, or -1 if no key between
+// can move that far without leaving its neighbourhood
+static int hop_back(HopscotchHashTable *table, int free) {
+	// of the keys that can move, take the one nearest the front, to bring
+	// the free slot as far forward as possible
+	int home, best = -1, besthome = 0;
+	for (home = free - (HOP_RANGE - 1); home < free; home++) {
+		if (home < 0) {
+			continue;
+		}
+		// this home slot's keys in slots before 'free'
+		Hops movable = table->hops[home]
+			& (((Hops)1 << (free - home)) - 1);
+		if (movable && (best < 0 || home + __builtin_ctzll(movable) < best)) {
+			best = home + __builtin_ctzll(movable);
+			besthome = home;
+		}
+	}
+	if (best < 0) {
+		return -1;
+	}
+
+	table->slots[free] = table->slots[best];
+	table->inuse[free] = true;
+	if (table->values) {
+		memcpy(value_at(table, table->values, free),
+			value_at(table, table->values, best), table->valuesize);
+	}
+	table->hops[besthome] |= (Hops)1 << (free - besthome);
+	table->hops[besthome] &= ~((Hops)1 << (best - besthome));
+	table->inuse[best] = false;
+	table->distance += free - best;
+	return best;
+}
+
+// place 'key' (not in the table) in its neighbourhood, hopping other keys
+// along if need be. returns false if it cannot be placed
+static bool place(HopscotchHashTable *table, int64 key, const void *value) {
+	int home = home_of(table, key);
+	int last = home + HOP_ADD_RANGE;
+	if (last > nslots(table->size)) {
+		last = nslots(table->size);
+	}
+
+	// the first free slot from home, as linear probing would find
+	int free = home;
+	while (free < last && table->inuse[free]) {
+		free++;
+	}
+	if (free == last) {
+		return false;
+	}
+	int probes = free - home;
+
+	// hop keys forwards until the free slot is in this key's neighbourhood.
+	// a failed hop leaves every key in a valid slot, and the slot left free
+	// is free, so giving up half way changes nothing that matters
+	int moved = 0;
+	while (free - home >= HOP_RANGE) {
+		free = hop_back(table, free);
+		if (free < 0) {
+			table->nhops += moved;
+			return false;
+		}
+		moved++;
+	}
+
+	table->slots[free] = key;
+	table->inuse[free] = true;
+	write_value(table, free, value);
+	table->hops[home] |= (Hops)1 << (free - home);
+	table->load++;
+	table->distance += free - home;
+	table->collisions += (free != home);
+	table->nhops += moved;
+	if (!table->rehashing) {
+		histogram_add(&table->insert_probes, probes);
+		histogram_add(&table->insert_hops, moved);
+	}
+	return true;
+}
+
+// replace the arrays of 'table' with arrays for 'size' home slots and
+// re-hash all keys into them, tracing the change as 'kind'
+static void resize_table(HopscotchHashTable *table, int size, TraceKind kind) {
+	uint64_t start = trace_clock();
+	int64 *oldslots = table->slots;
+	bool  *oldinuse = table->inuse;
+	Hops  *oldhops = table->hops;
+	unsigned char *oldvalues = table->values;
+	int oldsize = table->size;
+
+	// keep going up until every key fits (almost always the first size)
+	bool placed = false;
+	while (!placed) {
+		initialise_table(table, size);
+		table->nresizes++;
+		table->rehashing = true;
+		placed = true;
+		int i;
+		for (i = 0; i < nslots(oldsize) && placed; i++) {
+			if (oldinuse[i]) {
+				placed = place(table, oldslots[i],
+					oldvalues ? value_at(table, oldvalues, i) : NULL);
+			}
+		}
+		table->rehashing = false;
+		if (!placed) {
+			memory_free(&table->memory, table->slots);
+			memory_free(&table->memory, table->inuse);
+			memory_free(&table->memory, table->hops);
+			memory_free(&table->memory, table->values);
+			size *= 2;
+		}
+	}
+
+	memory_free(&table->memory, oldslots);
+	memory_free(&table->memory, oldinuse);
+	memory_free(&table->memory, oldhops);
+	memory_free(&table->memory, oldvalues);
+
+	// every key is rehashed into the new arrays
+	trace_record(kind, start, oldsize, table->size, table->load);
+}
+
+
+/* * * *
+ * all functions
+ */
+
+HopscotchHashTable *new_hopscotch_hash_table(int size) {
+	return new_hopscotch_hash_map(size, 0);
+}
+
+HopscotchHashTable *new_hopscotch_hash_map(int size, int valuesize) {
+	Memory memory;
+	memory_init(&memory);
+	HopscotchHashTable *table = memory_malloc(&memory, sizeof *table);
+	assert(table);
+	table->memory = memory;
+	table->valuesize = valuesize;
+	table->nhops = 0;
+	table->nresizes = 0;
+	table->rehashing = false;
+	init_histogram(&table->insert_probes, "insert probes", HIST_LOG2);
+	init_histogram(&table->insert_hops, "insert hops", HIST_LOG2);
+	init_histogram(&table->hit_probes, "lookup hit probes", HIST_LOG2);
+	init_histogram(&table->miss_probes, "lookup miss probes", HIST_LOG2);
+
+	initialise_table(table, size);
+
+	return table;
+}
+
+void free_hopscotch_hash_table(HopscotchHashTable *table) {
+	assert(table != NULL);
+	memory_free(&table->memory, table->slots);
+	memory_free(&table->memory, table->inuse);
+	memory_free(&table->memory, table->hops);
+	memory_free(&table->memory, table->values);
+	memory_free(&table->memory, table);
+}
+
+bool hopscotch_hash_table_insert(HopscotchHashTable *table, int64 key) {
+	return hopscotch_hash_table_put(table, key, NULL, false);
+}
+
+bool hopscotch_hash_table_put(HopscotchHashTable *table, int64 key,
+		const void *value, bool replace) {
+	assert(table != NULL);
+
+	int slot = find_slot(table, key, false);
+	if (slot >= 0) {
+		if (replace) {
+			write_value(table, slot, value);
+		}
+		return false;
+	}
+
+	// no room in this key's neighbourhood: double the table until there is
+	while (!place(table, key, value)) {
+		resize_table(table, table->size * 2, TRACE_HOPSCOTCH_DOUBLE);
+	}
+	return true;
+}
+
+// make room for 'nkeys' keys in total without doubling, at a load factor of
+// at most RESERVE_LOAD_FACTOR. returns false if that would be too large
+bool hopscotch_hash_table_reserve(HopscotchHashTable *table, size_t nkeys) {
+	assert(table != NULL);
+
+	double needed = ceil(nkeys / RESERVE_LOAD_FACTOR);
+	if (needed >= MAX_TABLE_SIZE) {
+		return false;
+	}
+
+	// never shrink: a table already large enough is left as it is
+	if ((int)needed > table->size) {
+		resize_table(table, (int)needed, TRACE_HOPSCOTCH_RESERVE);
+	}
+	return true;
+}
+
+bool hopscotch_hash_table_lookup(HopscotchHashTable *table, int64 key) {
+	return find_slot(table, key, true) >= 0;
+}
+
+bool hopscotch_hash_table_get(HopscotchHashTable *table, int64 key,
+		void *value) {
+	int slot = find_slot(table, key, true);
+	if (slot < 0) {
+		return false;
+	}
+	if (value && table->valuesize) {
+		memcpy(value, value_at(table, table->values, slot), table->valuesize);
+	}
+	return true;
+}
+
+void hopscotch_hash_table_print(HopscotchHashTable *table) {
+	assert(table != NULL);
+
+	printf("--- table size: %d\n", table->size);
+
+	// each slot with the hop bitmap of the keys whose home it is
+	printf("   address | hops             | key\n");
+	int i;
+	for (i = 0; i < nslots(table->size); i++) {
+		printf(" %9d | %016llx | ", i, (unsigned long long)table->hops[i]);
+		if (table->inuse[i]) {
+			printf("%llu\n", table->slots[i]);
+		} else {
+			printf("-\n");
+		}
+	}
+
+	printf("--- end table ---\n");
+}
+
+void hopscotch_hash_table_get_stats(HopscotchHashTable *table,
+		HashTableStats *stats) {
+	assert(table != NULL);
+	stats->size = table->size;
+	stats->nkeys = table->load;
+	stats->load_factor = (double)table->load / table->size;
+	stats->collisions = table->collisions;
+	stats->probe_length = table->load
+		? (double)table->distance / table->load : 0;
+	stats->resizes = table->nresizes;
+	stats->kicks = table->nhops;
+	stats->memory = table->memory.bytes;
+	stats->peak_memory = table->memory.peak;
+	add_stats_histogram(stats, &table->insert_probes);
+	add_stats_histogram(stats, &table->insert_hops);
+	add_stats_histogram(stats, &table->hit_probes);
+	add_stats_histogram(stats, &table->miss_probes);
+}
+
+void hopscotch_hash_table_memory(HopscotchHashTable *table, Memory *memory) {
+	assert(table != NULL);
+	*memory = table->memory;
+}
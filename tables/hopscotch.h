@@ -0,0 +1,89 @@
+/* * * * * * * * *
+ * Dynamic hash table using hopscotch hashing to resolve collisions
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * Every key is kept within HOP_RANGE slots of its home slot (h1 % size), its
+ * neighbourhood, and each home slot has a bitmap of which slots of its
+ * neighbourhood hold its keys. A lookup reads one bitmap and compares only
+ * the keys it marks: at most HOP_RANGE however full the table, and nearly
+ * always within a cache line or two of the home slot.
+ *
+ * An insert takes the first free slot after the home slot, as linear probing
+ * would. If that is outside the neighbourhood, keys between are moved ('hop')
+ * forwards into the free slot, each staying within its own neighbourhood,
+ * until the free slot is close enough. If no key can hop, or there is no
+ * free slot within HOP_ADD_RANGE, the table doubles. Neighbourhoods never
+ * wrap around: the arrays have HOP_RANGE - 1 slots past the last home slot.
+ *
+ * An insert only moves keys between its home slot and the free slot it found,
+ * so locking that stretch of slots (in neighbourhood-sized stripes) would let
+ * inserts and lookups of distant keys run concurrently (nothing here is
+ * thread safe yet).
+ */
+
+#ifndef HOPSCOTCH_H
+#define HOPSCOTCH_H
+
+#include <stdbool.h>
+#include "../inthash.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+
+// slots in each neighbourhood, and bits in each hop bitmap (32 or 64). with
+// 64 the table fills to 90-95% before an insert cannot hop and it doubles,
+// with 32 only to about 85%
+#define HOP_RANGE 64
+// how far past its home slot an insert looks for a free slot. runs of full
+// slots grow long near 90% load
+#define HOP_ADD_RANGE 4096
+
+typedef struct hopscotch_table HopscotchHashTable;
+
+// initialise a hopscotch hash table with initial size 'size'
+HopscotchHashTable *new_hopscotch_hash_table(int size);
+
+// initialise a hopscotch hash table with initial size 'size', storing a
+// value of 'valuesize' bytes with each key
+HopscotchHashTable *new_hopscotch_hash_map(int size, int valuesize);
+
+// free all memory associated with 'table'
+void free_hopscotch_hash_table(HopscotchHashTable *table);
+
+// insert 'key' into 'table', if it's not in there already
+// returns true if insertion succeeds, false if it was already in there
+bool hopscotch_hash_table_insert(HopscotchHashTable *table, int64 key);
+
+// insert 'key' with 'value' (zeros if NULL) into 'table'. if 'key' is already
+// in there, its value is overwritten only if 'replace'
+// returns true if 'key' was inserted, false if it was already in there
+bool hopscotch_hash_table_put(HopscotchHashTable *table, int64 key,
+	const void *value, bool replace);
+
+// make room for 'nkeys' keys in total, so inserting them does not double the
+// table. returns false if the table would grow too large
+bool hopscotch_hash_table_reserve(HopscotchHashTable *table, size_t nkeys);
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool hopscotch_hash_table_lookup(HopscotchHashTable *table, int64 key);
+
+// lookup 'key' in 'table', copying its value into 'value' (unless NULL)
+// returns true if found, false if not
+bool hopscotch_hash_table_get(HopscotchHashTable *table, int64 key,
+	void *value);
+
+// print the contents of 'table' to stdout
+void hopscotch_hash_table_print(HopscotchHashTable *table);
+
+// fill 'stats' with the statistics this table tracks
+void hopscotch_hash_table_get_stats(HopscotchHashTable *table,
+	HashTableStats *stats);
+
+// copy the memory currently and at most held by 'table' into 'memory'
+void hopscotch_hash_table_memory(HopscotchHashTable *table, Memory *memory);
+
+#endif
@@ -18,12 +18,17 @@
 #include <time.h>
 
 #include "linear.h"
+#include "../parallel.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+#include "../trace.h"
 
 // how many cells to advance at a time while looking for a free slot
 #define STEP_SIZE 1
-// Number of columns in the stat output csv
-#define NSTATS 9
-#define HEADER_MAX_STR_LENGTH 100
+
+// the load factor linear_hash_table_reserve sizes the table for. the table
+// only doubles once full, but probes get long well before then
+#define RESERVE_LOAD_FACTOR 0.5
 
 // a hash table is an array of slots holding keys, along with a parallel array
 // of boolean markers recording which slots are in use (true) or free (false)
@@ -32,7 +37,10 @@
 struct linear_table {
 	int64 *slots;	// array of slots holding keys
 	bool  *inuse;	// is this slot in use or not?
-	int size;		// the size of both of these arrays right now
+	unsigned char *values;	// in map mode, the value of each slot's key
+	int valuesize;	// bytes in each value (0 if the table is not a map)
+	int size;		// the size of these arrays right now
+	PagePolicy pages;	// how these arrays are backed
 	int load;		// number of keys in the table right now
     int preexist;
 
@@ -45,6 +53,16 @@ struct linear_table {
 
     double accum_lookup_time;
     double accum_insert_time;
+
+    int nresizes;	// how many times the table has doubled or been resized
+    bool rehashing;	// are keys being reinserted by resize_table?
+
+    /* Probe lengths of inserts, and of lookups that find / miss their key */
+    Histogram insert_probes;
+    Histogram hit_probes;
+    Histogram miss_probes;
+
+    Memory memory;	// heap memory held by the table, struct included
 };
 
 
@@ -57,13 +75,18 @@ struct linear_table {
 static void initialise_table(LinearHashTable *table, int size) {
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
-	table->slots = malloc((sizeof *table->slots) * size);
+	// zeroed, so every slot starts out not in use
+	table->slots = memory_alloc_pages(&table->memory,
+		(sizeof *table->slots) * size, table->pages);
 	assert(table->slots);
-	table->inuse = malloc((sizeof *table->inuse) * size);
+	table->inuse = memory_alloc_pages(&table->memory,
+		(sizeof *table->inuse) * size, table->pages);
 	assert(table->inuse);
-	int i;
-	for (i = 0; i < size; i++) {
-		table->inuse[i] = false;
+	table->values = NULL;
+	if (table->valuesize) {
+		table->values = memory_alloc_pages(&table->memory,
+			(size_t)table->valuesize * size, table->pages);
+		assert(table->values);
 	}
 
 	table->size = size;
@@ -76,25 +99,286 @@ static void initialise_table(LinearHashTable *table, int size) {
     table->preexist=0;
 }
 
+// the value stored with the key in slot 'slot' of 'values'
+static unsigned char *value_at(LinearHashTable *table, unsigned char *values,
+		int slot) {
+	return values + (size_t)slot * table->valuesize;
+}
 
-// double the size of the internal table arrays and re-hash all
-// keys in the old tables
-static void double_table(LinearHashTable *table) {
+// store 'value' (or zeros, if NULL) as the value of the key in slot 'slot'
+static void write_value(LinearHashTable *table, int slot, const void *value) {
+	if (!table->valuesize) {
+		return;
+	}
+	if (value) {
+		memcpy(value_at(table, table->values, slot), value, table->valuesize);
+	} else {
+		memset(value_at(table, table->values, slot), 0, table->valuesize);
+	}
+}
+
+
+// state shared between the workers of a parallel rehash. keys are grouped by
+// the partition of the new table their home slot falls in, then each worker
+// places the keys (and values) of one partition without touching any other
+// partition
+typedef struct rehash {
+	LinearHashTable *table;	// the new (doubled) table
+	int64 *oldslots;		// slots of the table being rehashed
+	bool  *oldinuse;		// inuse markers of the table being rehashed
+	unsigned char *oldvalues;	// values of the table being rehashed, or NULL
+	int oldsize;			// size of the old arrays
+	int nworkers;			// number of old ranges, and of new partitions
+	int *counts;			// [w*nworkers+p]: keys in old range w bound for p
+	int *offsets;			// [w*nworkers+p]: where w stages its keys for p
+	int *pstart;			// first staged key of each partition (+ end)
+	int *staged;			// old slot of every key, grouped by destination
+							// partition
+	int *noverflow;			// keys that probed off the end of their partition
+	long *steps;			// total probe steps taken in each partition
+	int *collisions;		// keys not placed at their home slot, per partition
+} Rehash;
+
+// which of the 'n' equal partitions of [0, size) contains 'address'
+// (the inverse of parallel_range)
+static int partition_of(int address, int size, int n) {
+	int share = size / n, extra = size % n;
+	int wide = extra * (share + 1);
+	if (address < wide) {
+		return address / (share + 1);
+	}
+	return extra + (address - wide) / share;
+}
+
+// worker: count the keys in an old range by destination partition
+static void count_keys(int start, int end, int worker, void *arg) {
+	Rehash *r = arg;
+	int *counts = r->counts + worker * r->nworkers;
+	int i;
+	for (i = start; i < end; i++) {
+		if (r->oldinuse[i]) {
+			int h = h1(r->oldslots[i]) % r->table->size;
+			counts[partition_of(h, r->table->size, r->nworkers)]++;
+		}
+	}
+}
+
+// worker: copy the keys of an old range into their partition's staging area
+static void stage_keys(int start, int end, int worker, void *arg) {
+	Rehash *r = arg;
+	int *offsets = r->offsets + worker * r->nworkers;
+	int i;
+	for (i = start; i < end; i++) {
+		if (r->oldinuse[i]) {
+			int h = h1(r->oldslots[i]) % r->table->size;
+			r->staged[offsets[partition_of(h, r->table->size, r->nworkers)]++]
+				= i;
+		}
+	}
+}
+
+// worker: linear probe the keys of one partition into it. keys that run off
+// the end of the partition are moved to the front of its staging area, to be
+// placed afterwards on a single thread
+static void place_keys(int start, int end, int partition, void *arg) {
+	Rehash *r = arg;
+	LinearHashTable *table = r->table;
+	int first = r->pstart[partition], last = r->pstart[partition+1];
+	int i, noverflow = 0, collisions = 0;
+	long steps = 0;
+
+	for (i = first; i < last; i++) {
+		int old = r->staged[i];
+		int64 key = r->oldslots[old];
+		int h = h1(key) % table->size;
+		int home = h;
+
+		while (h < end && table->inuse[h]) {
+			h += STEP_SIZE;
+		}
+
+		if (h >= end) {
+			// overflow slots are always at or behind i, so already read
+			r->staged[first + noverflow++] = old;
+		} else {
+			table->slots[h] = key;
+			table->inuse[h] = true;
+			if (r->oldvalues) {
+				write_value(table, h, value_at(table, r->oldvalues, old));
+			}
+			steps += h - home;
+			collisions += (h != home);
+		}
+	}
+
+	r->noverflow[partition] = noverflow;
+	r->steps[partition] = steps;
+	r->collisions[partition] = collisions;
+}
+
+// rehash the keys of the old arrays into 'table' (already initialised at its
+// new size) using 'nworkers' threads. leaves the table's load and collision
+// statistics as a serial reinsertion would
+static void parallel_rehash(LinearHashTable *table, int64 *oldslots,
+		bool *oldinuse, unsigned char *oldvalues, int oldsize, int nworkers) {
+	int n = nworkers, w, p, i;
+	Memory *memory = &table->memory;
+	Rehash r = {
+		.table = table,
+		.oldslots = oldslots,
+		.oldinuse = oldinuse,
+		.oldvalues = oldvalues,
+		.oldsize = oldsize,
+		.nworkers = n,
+		.counts = memory_calloc(memory, (size_t)n * n, sizeof(int)),
+		.offsets = memory_malloc(memory, sizeof(int) * n * n),
+		.pstart = memory_malloc(memory, sizeof(int) * (n + 1)),
+		.noverflow = memory_malloc(memory, sizeof(int) * n),
+		.steps = memory_malloc(memory, sizeof(long) * n),
+		.collisions = memory_malloc(memory, sizeof(int) * n),
+	};
+	assert(r.counts && r.offsets && r.pstart && r.noverflow && r.steps
+		&& r.collisions);
+
+	// FIRST, count keys by (old range, new partition)
+	parallel_for(oldsize, n, count_keys, &r);
+
+	// SECOND, lay the staging array out partition by partition
+	int nkeys = 0;
+	for (p = 0; p < n; p++) {
+		r.pstart[p] = nkeys;
+		for (w = 0; w < n; w++) {
+			r.offsets[w*n + p] = nkeys;
+			nkeys += r.counts[w*n + p];
+		}
+	}
+	r.pstart[n] = nkeys;
+	r.staged = memory_malloc(memory, sizeof(int) * (nkeys ? nkeys : 1));
+	assert(r.staged);
+	parallel_for(oldsize, n, stage_keys, &r);
+
+	// THIRD, place each partition's keys within that partition
+	parallel_for(table->size, n, place_keys, &r);
+
+	// FINALLY, place the keys that spilled past their partition, wrapping
+	// around the table as a normal insert would
+	long steps = 0;
+	int collisions = 0;
+	for (p = 0; p < n; p++) {
+		steps += r.steps[p];
+		collisions += r.collisions[p];
+		for (i = r.pstart[p]; i < r.pstart[p] + r.noverflow[p]; i++) {
+			int old = r.staged[i];
+			int64 key = oldslots[old];
+			int h = h1(key) % table->size;
+			int nsteps = 0;
+			while (table->inuse[h]) {
+				h = (h + STEP_SIZE) % table->size;
+				nsteps++;
+			}
+			table->slots[h] = key;
+			table->inuse[h] = true;
+			if (oldvalues) {
+				write_value(table, h, value_at(table, oldvalues, old));
+			}
+			steps += nsteps;
+			collisions += (nsteps != 0);
+		}
+	}
+
+	// statistics as if each key had gone through linear_hash_table_insert
+	table->load = nkeys;
+	table->collision_count = collisions;
+	table->average_probe_length = nkeys ? (double)steps / nkeys : 0;
+	table->average_load_factor = nkeys ? (nkeys + 1) / (2.0 * table->size) : 0;
+
+	memory_free(memory, r.counts);
+	memory_free(memory, r.offsets);
+	memory_free(memory, r.pstart);
+	memory_free(memory, r.noverflow);
+	memory_free(memory, r.steps);
+	memory_free(memory, r.collisions);
+	memory_free(memory, r.staged);
+}
+
+// replace the internal table arrays with arrays of size 'size' and re-hash
+// all keys in the old tables, tracing the change as 'kind'
+static void resize_table(LinearHashTable *table, int size, TraceKind kind) {
+	uint64_t start = trace_clock();
 	int64 *oldslots = table->slots;
 	bool  *oldinuse = table->inuse;
+	unsigned char *oldvalues = table->values;
 	int oldsize = table->size;
 
-	initialise_table(table, table->size * 2);
+	initialise_table(table, size);
+	table->nresizes++;
 
-	int i;
-	for (i = 0; i < oldsize; i++) {
-		if (oldinuse[i] == true) {
-			linear_hash_table_insert(table, oldslots[i]);
+	// large tables are rehashed by a pool of workers
+	int nworkers = parallel_worker_count();
+	if (nworkers > 1 && oldsize >= PARALLEL_MIN_ITEMS) {
+		parallel_rehash(table, oldslots, oldinuse, oldvalues, oldsize,
+			nworkers);
+	} else {
+		// reinsertions are not inserts of the table's user, so keep them out
+		// of the probe histograms
+		table->rehashing = true;
+		int i;
+		for (i = 0; i < oldsize; i++) {
+			if (oldinuse[i] == true) {
+				linear_hash_table_put(table, oldslots[i],
+					oldvalues ? value_at(table, oldvalues, i) : NULL, false);
+			}
 		}
+		table->rehashing = false;
 	}
 
-	free(oldslots);
-	free(oldinuse);
+	memory_free_pages(&table->memory, oldslots);
+	memory_free_pages(&table->memory, oldinuse);
+	memory_free_pages(&table->memory, oldvalues);
+
+	// every key is rehashed into the new arrays
+	trace_record(kind, start, oldsize, table->size, table->load);
+}
+
+// double the size of the internal table arrays and re-hash all
+// keys in the old tables
+static void double_table(LinearHashTable *table) {
+	resize_table(table, table->size * 2, TRACE_LINEAR_DOUBLE);
+}
+
+
+// find the slot of 'table' holding 'key', or -1 if 'key' is not in there
+static int find_slot(LinearHashTable *table, int64 key) {
+    int start_time = clock();
+	assert(table != NULL);
+
+	// need to count our steps to make sure we recognise when the table is full
+	int steps = 0;
+
+	// calculate the initial address for this key
+	int h = h1(key) % table->size;
+
+	// step along until we find a free space (inuse[]==false), or until we
+	// visit every cell
+	while (table->inuse[h] && steps < table->size) {
+
+		if (table->slots[h] == key) {
+
+			// found the key!. Add time to accumulator 
+            table->accum_lookup_time+=clock()-start_time;
+			histogram_add(&table->hit_probes, steps);
+			return h;
+		}
+
+		// keep stepping
+		h = (h + STEP_SIZE) % table->size;
+		steps++;
+	}
+
+	// we have either searched the whole table or come back to where we started
+	// either way, the key is not in the hash table
+	histogram_add(&table->miss_probes, steps);
+	return -1;
 }
 
 
@@ -104,8 +388,25 @@ static void double_table(LinearHashTable *table) {
 
 // initialise a linear probing hash table with initial size 'size'
 LinearHashTable *new_linear_hash_table(int size) {
-	LinearHashTable *table = malloc(sizeof *table);
+	return new_linear_hash_map(size, 0);
+}
+
+
+// initialise a linear probing hash table with initial size 'size', storing a
+// value of 'valuesize' bytes with each key
+LinearHashTable *new_linear_hash_map(int size, int valuesize) {
+	Memory memory;
+	memory_init(&memory);
+	LinearHashTable *table = memory_malloc(&memory, sizeof *table);
 	assert(table);
+	table->memory = memory;
+	table->valuesize = valuesize;
+	table->pages = PAGES_DEFAULT;
+	table->nresizes = 0;
+	table->rehashing = false;
+	init_histogram(&table->insert_probes, "insert probes", HIST_LOG2);
+	init_histogram(&table->hit_probes, "lookup hit probes", HIST_LOG2);
+	init_histogram(&table->miss_probes, "lookup miss probes", HIST_LOG2);
 
 	// set up the internals of the table struct with arrays of size 'size'
 	initialise_table(table, size);
@@ -119,17 +420,27 @@ void free_linear_hash_table(LinearHashTable *table) {
 	assert(table != NULL);
 
 	// free the table's arrays
-	free(table->slots);
-	free(table->inuse);
+	memory_free_pages(&table->memory, table->slots);
+	memory_free_pages(&table->memory, table->inuse);
+	memory_free_pages(&table->memory, table->values);
 
 	// free the table struct itself
-	free(table);
+	memory_free(&table->memory, table);
 }
 
 
 // insert 'key' into 'table', if it's not in there already
 // returns true if insertion succeeds, false if it was already in there
 bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
+	return linear_hash_table_put(table, key, NULL, false);
+}
+
+
+// insert 'key' with 'value' into 'table'. if 'key' is already in there, its
+// value is overwritten only if 'replace'
+// returns true if 'key' was inserted, false if it was already in there
+bool linear_hash_table_put(LinearHashTable *table, int64 key,
+		const void *value, bool replace) {
     /* CPU time for insert operation */
     int start_time = clock();
 	assert(table != NULL);
@@ -146,6 +457,9 @@ bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
 		if (table->slots[h] == key) {
 			// this key already exists in the table! no need to insert
             table->preexist++;
+			if (replace) {
+				write_value(table, h, value);
+			}
 			return false;
 		}
 		
@@ -174,13 +488,17 @@ bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
         
         //* Add insert time so far */
         table->accum_insert_time += clock() - start_time;
-		return linear_hash_table_insert(table, key);
+		return linear_hash_table_put(table, key, value, replace);
 
 	} else {
 		// otherwise, we have found a free slot! insert this key right here
 		table->slots[h] = key;
 		table->inuse[h] = true;
+		write_value(table, h, value);
 		table->load++;
+		if (!table->rehashing) {
+			histogram_add(&table->insert_probes, steps);
+		}
 
         /* Get average load factor */
         table->average_load_factor = ((table->average_load_factor*
@@ -194,37 +512,66 @@ bool linear_hash_table_insert(LinearHashTable *table, int64 key) {
 }
 
 
-// lookup whether 'key' is inside 'table'
-// returns true if found, false if not
-bool linear_hash_table_lookup(LinearHashTable *table, int64 key) {
-    int start_time = clock();
+// make room for 'nkeys' keys in total without doubling, at a load factor of
+// at most RESERVE_LOAD_FACTOR. returns false if that would be too large
+bool linear_hash_table_reserve(LinearHashTable *table, size_t nkeys) {
 	assert(table != NULL);
 
-	// need to count our steps to make sure we recognise when the table is full
-	int steps = 0;
-
-	// calculate the initial address for this key
-	int h = h1(key) % table->size;
+	// the smallest power of two that holds the keys at the target load
+	double needed = nkeys / RESERVE_LOAD_FACTOR;
+	size_t size = 1;
+	while (size < needed && size < MAX_TABLE_SIZE) {
+		size *= 2;
+	}
+	if (size >= MAX_TABLE_SIZE) {
+		return false;
+	}
 
-	// step along until we find a free space (inuse[]==false), or until we
-	// visit every cell
-	while (table->inuse[h] && steps < table->size) {
+	// never shrink: a table already large enough is left as it is
+	if ((int)size > table->size) {
+		resize_table(table, (int)size, TRACE_LINEAR_RESERVE);
+	}
+	return true;
+}
 
-		if (table->slots[h] == key) {
 
-			// found the key!. Add time to accumulator 
-            table->accum_lookup_time+=clock()-start_time;
-			return true;
-		}
+// back the table's arrays as 'policy' asks, from now on and after every resize
+void linear_hash_table_set_pages(LinearHashTable *table, PagePolicy policy) {
+	assert(table != NULL);
 
-		// keep stepping
-		h = (h + STEP_SIZE) % table->size;
-		steps++;
+	table->pages = policy;
+	table->slots = memory_realloc_pages(&table->memory, table->slots,
+		(sizeof *table->slots) * table->size, policy);
+	assert(table->slots);
+	table->inuse = memory_realloc_pages(&table->memory, table->inuse,
+		(sizeof *table->inuse) * table->size, policy);
+	assert(table->inuse);
+	if (table->values) {
+		table->values = memory_realloc_pages(&table->memory, table->values,
+			(size_t)table->valuesize * table->size, policy);
+		assert(table->values);
 	}
+}
 
-	// we have either searched the whole table or come back to where we started
-	// either way, the key is not in the hash table
-	return false;
+
+// lookup whether 'key' is inside 'table'
+// returns true if found, false if not
+bool linear_hash_table_lookup(LinearHashTable *table, int64 key) {
+	return find_slot(table, key) >= 0;
+}
+
+
+// lookup 'key' in 'table', copying its value into 'value' (unless NULL)
+// returns true if found, false if not
+bool linear_hash_table_get(LinearHashTable *table, int64 key, void *value) {
+	int h = find_slot(table, key);
+	if (h < 0) {
+		return false;
+	}
+	if (value && table->valuesize) {
+		memcpy(value, value_at(table, table->values, h), table->valuesize);
+	}
+	return true;
 }
 
 
@@ -286,92 +633,38 @@ void linear_hash_table_stats(LinearHashTable *table) {
 	printf("%20s: %.3f [%s]\n", "lookup time", 1000*lookup_time, "ms");
 	printf("%20s: %.3f [%s]\n", "insert time", 1000*insert_time, "ms");
 	printf("%20s: %d\n", "preexisted", table->preexist);
+	printf("%20s: %zu [%s]\n", "memory", table->memory.bytes, "bytes");
+	printf("%20s: %zu [%s]\n", "peak memory", table->memory.peak, "bytes");
+	printf("%20s: %.3f [%s]\n", "memory per key",
+            table->load ? (double)table->memory.bytes/table->load : 0, "bytes");
 	printf("--- end stats ---\n");
 }
 
-// Returns csv stat header 
-static char** get_stat_header() {
-    int ix, n_columns = NSTATS;
-    char** header= malloc(sizeof(char*)*n_columns);
-
-    /* Allocate memory for header strings */
-    for (ix=0; ix<n_columns; ix++) {
-        header[ix]=malloc(sizeof(char)*HEADER_MAX_STR_LENGTH);
-    }
-
-    strcpy(header[0],"current size [slots]");
-    strcpy(header[1],"current load [items]");
-    strcpy(header[2],"load factor [-]");
-    strcpy(header[3],"step size [-]");
-    strcpy(header[4],"collision count [inserts]");
-    strcpy(header[5],"average probe length [items]");
-    strcpy(header[6],"lookup time [ms]");
-    strcpy(header[7],"insert time [ms]");
-    strcpy(header[8],"average load factor [-]");
-
-    return(header);
+// fill 'stats' with the statistics this table tracks
+void linear_hash_table_get_stats(LinearHashTable *table, HashTableStats *stats) {
+	stats->size = table->size;
+	stats->nkeys = table->load;
+	stats->load_factor = (double)table->load / table->size;
+	stats->collisions = table->collision_count;
+	stats->probe_length = table->average_probe_length;
+	stats->resizes = table->nresizes;
+	stats->insert_time = 1000*table->accum_insert_time/CLOCKS_PER_SEC;
+	stats->lookup_time = 1000*table->accum_lookup_time/CLOCKS_PER_SEC;
+	stats->memory = table->memory.bytes;
+	stats->peak_memory = table->memory.peak;
+	add_stats_histogram(stats, &table->insert_probes);
+	add_stats_histogram(stats, &table->hit_probes);
+	add_stats_histogram(stats, &table->miss_probes);
 }
 
-// Print csv stat header to stdout
-static void print_stat_header(char** header) {
-    int ix, n_columns=NSTATS;
-    char seperator=',';
-    for (ix=0; ix<n_columns; ix++) {
-        printf("%s", header[ix]);
-        if (ix!=(n_columns-1)) {
-            printf("%c", seperator);
-        }
-    }
-    printf("\n");
+// copy the memory currently and at most held by 'table' into 'memory'
+void linear_hash_table_memory(LinearHashTable *table, Memory *memory) {
+	*memory = table->memory;
 }
 
-// Get a csv row of statistics for the table 
-static double* get_stat_row(LinearHashTable *table) {
-    int n_columns = NSTATS;
-    double* statrow = malloc(sizeof(double) * n_columns);
-
-    double load_factor = 100*table->load/table->size;
-    double average_load = table->average_load_factor;
-    double insert_time = 1000*table->accum_insert_time/CLOCKS_PER_SEC;
-    double lookup_time = 1000*table->accum_lookup_time/CLOCKS_PER_SEC;
-
-
-    statrow[0] = table->size;
-    statrow[1] = table->load;
-    statrow[2] = load_factor;
-    statrow[3] = STEP_SIZE;
-    statrow[4] = table->collision_count;
-    statrow[5] = table->average_probe_length;
-    statrow[6] = lookup_time;
-    statrow[7] = insert_time;
-    statrow[8] = average_load;
-
-    return(statrow);
-}
-
-// Print statistics to stdout
-static void print_stat_row(double *statrow) {
-    char seperator = ',';
-    int ix, n_columns=NSTATS;
-    for (ix=0; ix<n_columns;ix++) {
-        printf("%3.3f", statrow[ix]);
-        if (ix!=(n_columns-1)) {
-            printf("%c", seperator);
-        }
-    }
-    printf("\n");
-}
-
-// Get stats and print to stdout
-void linear_hash_table_csv_stats(LinearHashTable *table) {
-    double* stats = get_stat_row(table);
-    print_stat_row(stats);
-    free(stats);
-}
-
-// Get stats header and print to stdout
-void linear_hash_table_csv_stats_header (LinearHashTable *table) {
-    char** header =get_stat_header();
-    print_stat_header(header);
-    free(header);
+// write the slots of 'table' to 'writer' as a single probed section
+void linear_hash_table_save(LinearHashTable *table, SnapshotWriter *writer) {
+	assert(table != NULL);
+	snapshot_write_slots(writer, SNAPSHOT_PROBED, 1, table->slots, table->inuse,
+		table->size);
 }
@@ -13,12 +13,19 @@
 
 #include <stdbool.h>
 #include "../inthash.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+#include "../snapshot.h"
 
 typedef struct linear_table LinearHashTable;
 
 // initialise a linear probing hash table with initial size 'size'
 LinearHashTable *new_linear_hash_table(int size);
 
+// initialise a linear probing hash table with initial size 'size', storing a
+// value of 'valuesize' bytes with each key
+LinearHashTable *new_linear_hash_map(int size, int valuesize);
+
 // free all memory associated with 'table'
 void free_linear_hash_table(LinearHashTable *table);
 
@@ -26,18 +33,39 @@ void free_linear_hash_table(LinearHashTable *table);
 // returns true if insertion succeeds, false if it was already in there
 bool linear_hash_table_insert(LinearHashTable *table, int64 key);
 
+// insert 'key' with 'value' (zeros if NULL) into 'table'. if 'key' is already
+// in there, its value is overwritten only if 'replace'
+// returns true if 'key' was inserted, false if it was already in there
+bool linear_hash_table_put(LinearHashTable *table, int64 key,
+	const void *value, bool replace);
+
+// make room for 'nkeys' keys in total, so inserting them does not double the
+// table. returns false if the table would grow too large
+bool linear_hash_table_reserve(LinearHashTable *table, size_t nkeys);
+
+// back the arrays of 'table' as 'policy' asks (moving them if need be), now
+// and whenever it resizes
+void linear_hash_table_set_pages(LinearHashTable *table, PagePolicy policy);
+
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool linear_hash_table_lookup(LinearHashTable *table, int64 key);
 
+// lookup 'key' in 'table', copying its value into 'value' (unless NULL)
+// returns true if found, false if not
+bool linear_hash_table_get(LinearHashTable *table, int64 key, void *value);
+
 // print the contents of 'table' to stdout
 void linear_hash_table_print(LinearHashTable *table);
 
 // print some statistics about 'table' to stdout
 void linear_hash_table_stats(LinearHashTable *table);
 
-/* Print csv stats row */
-void linear_hash_table_csv_stats(LinearHashTable *table);
+// fill 'stats' with the statistics this table tracks
+void linear_hash_table_get_stats(LinearHashTable *table, HashTableStats *stats);
+
+// write the slots of 'table' to 'writer' as a single probed section
+void linear_hash_table_save(LinearHashTable *table, SnapshotWriter *writer);
 
-/* Print csv stats header row*/
-void linear_hash_table_csv_stats_header (LinearHashTable *table);
+// copy the memory currently and at most held by 'table' into 'memory'
+void linear_hash_table_memory(LinearHashTable *table, Memory *memory);
@@ -0,0 +1,212 @@
+/* * * * * * * * *
+ * Memory dense variants of the linear, cuckoo and xtndbln tables holding
+ * 32-bit keys (see narrow.h)
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "narrow.h"
+#include "spectbl.h"
+
+DEFINE_LINEAR_TABLE(linear32, uint32_t, h1, 1)
+DEFINE_CUCKOO_TABLE(cuckoo32, uint32_t, h1, h2)
+DEFINE_XTNDBL_TABLE(xtndbln32, uint32_t, h1, XTNDBLN32_BUCKETSIZE)
+
+// can 'key' be held in 32 bits?
+static bool fits(int64 key) {
+	return key <= UINT32_MAX;
+}
+
+// fill the memory fields of 'stats' from 'memory'
+static void set_memory(HashTableStats *stats, const Memory *memory) {
+	stats->memory = memory->bytes;
+	stats->peak_memory = memory->peak;
+}
+
+/* * * *
+ * linear32
+ */
+
+Linear32HashTable *new_linear32_hash_table(int size) {
+	return linear32_new(size);
+}
+
+void free_linear32_hash_table(Linear32HashTable *table) {
+	linear32_free(table);
+}
+
+bool linear32_hash_table_insert(Linear32HashTable *table, int64 key) {
+	return fits(key) && linear32_insert(table, key);
+}
+
+bool linear32_hash_table_lookup(Linear32HashTable *table, int64 key) {
+	return fits(key) && linear32_lookup(table, key);
+}
+
+bool linear32_hash_table_reserve(Linear32HashTable *table, size_t nkeys) {
+	return linear32_reserve(table, nkeys);
+}
+
+// print the contents of 'table' to stdout, as linear_hash_table_print does
+void linear32_hash_table_print(Linear32HashTable *table) {
+	assert(table != NULL);
+	printf("--- table size: %ld\n", table->nbuckets);
+	printf("   address | key\n");
+	long i;
+	for (i = 0; i < table->nbuckets; i++) {
+		printf(" %9ld | ", i);
+		if (table->counts[i]) {
+			printf("%lu\n", (unsigned long)table->keys[i]);
+		} else {
+			printf("-\n");
+		}
+	}
+	printf("--- end table ---\n");
+}
+
+void linear32_hash_table_get_stats(Linear32HashTable *table,
+		HashTableStats *stats) {
+	stats->size = table->nbuckets;
+	stats->nkeys = table->nkeys;
+	stats->load_factor = (double)table->nkeys/table->nbuckets;
+	set_memory(stats, &table->memory);
+}
+
+void linear32_hash_table_memory(Linear32HashTable *table, Memory *memory) {
+	linear32_memory(table, memory);
+}
+
+/* * * *
+ * cuckoo32
+ */
+
+Cuckoo32HashTable *new_cuckoo32_hash_table(int size) {
+	return cuckoo32_new(size);
+}
+
+void free_cuckoo32_hash_table(Cuckoo32HashTable *table) {
+	cuckoo32_free(table);
+}
+
+bool cuckoo32_hash_table_insert(Cuckoo32HashTable *table, int64 key) {
+	return fits(key) && cuckoo32_insert(table, key);
+}
+
+bool cuckoo32_hash_table_lookup(Cuckoo32HashTable *table, int64 key) {
+	return fits(key) && cuckoo32_lookup(table, key);
+}
+
+bool cuckoo32_hash_table_reserve(Cuckoo32HashTable *table, size_t nkeys) {
+	return cuckoo32_reserve(table, nkeys);
+}
+
+// print the contents of 'table' to stdout, as cuckoo_hash_table_print does
+void cuckoo32_hash_table_print(Cuckoo32HashTable *table) {
+	assert(table != NULL);
+	printf("--- table size: %ld\n", table->size);
+	printf("                    table one         table two\n");
+	printf("                  key | address     address | key\n");
+	long i;
+	for (i = 0; i < table->size; i++) {
+		if (table->inuse[0][i]) {
+			printf(" %20lu ", (unsigned long)table->slots[0][i]);
+		} else {
+			printf(" %20s ", "-");
+		}
+		printf("| %-9ld %9ld |", i, i);
+		if (table->inuse[1][i]) {
+			printf(" %lu\n", (unsigned long)table->slots[1][i]);
+		} else {
+			printf(" %s\n", "-");
+		}
+	}
+	printf("--- end table ---\n");
+}
+
+void cuckoo32_hash_table_get_stats(Cuckoo32HashTable *table,
+		HashTableStats *stats) {
+	stats->size = 2*table->size;
+	stats->nkeys = table->nkeys;
+	stats->load_factor = (double)table->nkeys/(2*table->size);
+	set_memory(stats, &table->memory);
+}
+
+void cuckoo32_hash_table_memory(Cuckoo32HashTable *table, Memory *memory) {
+	cuckoo32_memory(table, memory);
+}
+
+/* * * *
+ * xtndbln32
+ */
+
+Xtndbln32HashTable *new_xtndbln32_hash_table(void) {
+	return xtndbln32_new(0);
+}
+
+void free_xtndbln32_hash_table(Xtndbln32HashTable *table) {
+	xtndbln32_free(table);
+}
+
+bool xtndbln32_hash_table_insert(Xtndbln32HashTable *table, int64 key) {
+	return fits(key) && xtndbln32_insert(table, key);
+}
+
+bool xtndbln32_hash_table_lookup(Xtndbln32HashTable *table, int64 key) {
+	return fits(key) && xtndbln32_lookup(table, key);
+}
+
+bool xtndbln32_hash_table_reserve(Xtndbln32HashTable *table, size_t nkeys) {
+	return xtndbln32_reserve(table, nkeys);
+}
+
+// print the contents of 'table' to stdout, as xtndbln_hash_table_print does
+// (a bucket's id is the first directory address pointing to it)
+void xtndbln32_hash_table_print(Xtndbln32HashTable *table) {
+	assert(table != NULL);
+	long size = 1L << table->depth;
+	printf("--- table size: %ld\n", size);
+	printf("  table:               buckets:\n");
+	printf("  address | bucketid   bucketid [key]\n");
+	long i;
+	for (i = 0; i < size; i++) {
+		xtndbln32_bucket *bucket = table->buckets[i];
+		long id = xtndbln32_address(i, bucket->depth);
+		printf("%9ld | %-9ld ", i, id);
+		if (id == i) {
+			printf("%9ld [", id);
+			int j;
+			for (j = 0; j < XTNDBLN32_BUCKETSIZE; j++) {
+				if (j < bucket->nkeys) {
+					printf(" %lu", (unsigned long)bucket->keys[j]);
+				} else {
+					printf(" -");
+				}
+			}
+			printf(" ]");
+		}
+		printf("\n");
+	}
+	printf("--- end table ---\n");
+}
+
+void xtndbln32_hash_table_get_stats(Xtndbln32HashTable *table,
+		HashTableStats *stats) {
+	stats->size = 1L << table->depth;
+	stats->nkeys = table->nkeys;
+	stats->nbuckets = table->nbuckets;
+	stats->bucketsize = XTNDBLN32_BUCKETSIZE;
+	stats->load_factor =
+		(double)table->nkeys/(table->nbuckets*XTNDBLN32_BUCKETSIZE);
+	set_memory(stats, &table->memory);
+}
+
+void xtndbln32_hash_table_memory(Xtndbln32HashTable *table, Memory *memory) {
+	xtndbln32_memory(table, memory);
+}
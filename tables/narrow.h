@@ -0,0 +1,66 @@
+/* * * * * * * * *
+ * Memory dense variants of the linear, cuckoo and xtndbln tables holding
+ * 32-bit keys, for key sets that fit in 32 bits: each key takes half the
+ * memory of an int64 one, so twice as many share a cache line
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * These are the templates of spectbl.h instantiated with uint32_t keys and
+ * h1 (and h2 for cuckoo32). Keys are taken as int64 like every other table;
+ * a key that does not fit in 32 bits is never inserted (insert returns false)
+ * and never found.
+ */
+
+#ifndef NARROW_H
+#define NARROW_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../inthash.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+
+// keys per bucket of xtndbln32 tables, fixed when they are compiled
+#define XTNDBLN32_BUCKETSIZE 8
+
+typedef struct linear32_table Linear32HashTable;
+typedef struct cuckoo32_table Cuckoo32HashTable;
+typedef struct xtndbln32_table Xtndbln32HashTable;
+
+// as linear.h: a linear probing table of initial size 'size'
+Linear32HashTable *new_linear32_hash_table(int size);
+void free_linear32_hash_table(Linear32HashTable *table);
+bool linear32_hash_table_insert(Linear32HashTable *table, int64 key);
+bool linear32_hash_table_lookup(Linear32HashTable *table, int64 key);
+bool linear32_hash_table_reserve(Linear32HashTable *table, size_t nkeys);
+void linear32_hash_table_print(Linear32HashTable *table);
+void linear32_hash_table_get_stats(Linear32HashTable *table,
+	HashTableStats *stats);
+void linear32_hash_table_memory(Linear32HashTable *table, Memory *memory);
+
+// as cuckoo.h: two inner tables of initial size 'size'
+Cuckoo32HashTable *new_cuckoo32_hash_table(int size);
+void free_cuckoo32_hash_table(Cuckoo32HashTable *table);
+bool cuckoo32_hash_table_insert(Cuckoo32HashTable *table, int64 key);
+bool cuckoo32_hash_table_lookup(Cuckoo32HashTable *table, int64 key);
+bool cuckoo32_hash_table_reserve(Cuckoo32HashTable *table, size_t nkeys);
+void cuckoo32_hash_table_print(Cuckoo32HashTable *table);
+void cuckoo32_hash_table_get_stats(Cuckoo32HashTable *table,
+	HashTableStats *stats);
+void cuckoo32_hash_table_memory(Cuckoo32HashTable *table, Memory *memory);
+
+// as xtndbln.h, but always XTNDBLN32_BUCKETSIZE keys per bucket
+Xtndbln32HashTable *new_xtndbln32_hash_table(void);
+void free_xtndbln32_hash_table(Xtndbln32HashTable *table);
+bool xtndbln32_hash_table_insert(Xtndbln32HashTable *table, int64 key);
+bool xtndbln32_hash_table_lookup(Xtndbln32HashTable *table, int64 key);
+bool xtndbln32_hash_table_reserve(Xtndbln32HashTable *table, size_t nkeys);
+void xtndbln32_hash_table_print(Xtndbln32HashTable *table);
+void xtndbln32_hash_table_get_stats(Xtndbln32HashTable *table,
+	HashTableStats *stats);
+void xtndbln32_hash_table_memory(Xtndbln32HashTable *table, Memory *memory);
+
+#endif
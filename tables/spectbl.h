@@ -0,0 +1,592 @@
+/* * * * * * * * *
+ * Header-only templates for hash tables specialised at compile time. The key
+ * type, hash function and keys per bucket are macro arguments, so each
+ * instance is compiled with them as constants and its operations inline into
+ * the caller, without the HashTable type switch or a hash function pointer
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * DEFINE_LINEAR_TABLE(name, key_t, hash_fn, bucket_n)
+ *   open addressing over a power of two number of buckets of 'bucket_n' keys
+ *   (1 to 255), probing linearly from bucket to bucket. keys are never
+ *   removed, so a probe stops at the first bucket that is not full. the table
+ *   doubles once SPECTBL_MAX_LOAD of its slots are used
+ *
+ * DEFINE_XTNDBL_TABLE(name, key_t, hash_fn, bucket_n)
+ *   extendible hashing with buckets of 'bucket_n' keys held inline, splitting
+ *   a full bucket (and doubling the directory when needed) as xtndbln does
+ *
+ * DEFINE_CUCKOO_TABLE(name, key_t, hash1_fn, hash2_fn)
+ *   cuckoo hashing over two power of two tables of single key slots, kicking
+ *   keys between them and doubling both when a key is kicked too many times
+ *
+ * Each defines the type name_table and static inline functions:
+ *   name_table *name_new(int size)	initial slots (linear, per inner table for
+ *   								cuckoo) / ignored (xtndbl)
+ *   void name_free(name_table *table)
+ *   bool name_insert(name_table *table, key_t key)	false if already in
+ *   bool name_lookup(const name_table *table, key_t key)
+ *   bool name_reserve(name_table *table, size_t nkeys)	as hash_table_reserve
+ *   long name_nkeys(const name_table *table)
+ *   void name_memory(const name_table *table, Memory *memory)
+ *
+ * key_t is any integer type (uint32_t keys take half the memory of int64
+ * ones), compared with ==. hash_fn(key) must return a non-negative int, as
+ * h1 and h2 (inthash.h) do. Define an instance once, at file scope, in the
+ * file that uses it:
+ *
+ *   DEFINE_LINEAR_TABLE(fastset, int64, h1, 4)
+ *   fastset_table *set = fastset_new(64);
+ *   fastset_insert(set, key);
+ *
+ * The _EQ forms take an equality function eq_fn(a, b) as well, so key_t can
+ * be an opaque fixed size key, such as a struct wrapping a byte array,
+ * passed and stored by value and hashed by a user hash function:
+ *
+ *   typedef struct { unsigned char bytes[16]; } Uuid;
+ *   static inline bool uuid_eq(Uuid a, Uuid b) {
+ *       return memcmp(a.bytes, b.bytes, sizeof a.bytes) == 0;
+ *   }
+ *   DEFINE_LINEAR_TABLE_EQ(uuidset, Uuid, uuid_hash, uuid_eq, 4)
+ */
+
+#ifndef SPECTBL_H
+#define SPECTBL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include "../inthash.h"
+#include "../memacct.h"
+
+// the load at which linear template tables double
+#ifndef SPECTBL_MAX_LOAD
+#define SPECTBL_MAX_LOAD 0.75
+#endif
+
+// the load extendible template tables are sized for by name_reserve, as
+// RESERVE_LOAD_FACTOR in xtndbln.c
+#define SPECTBL_XTNDBL_RESERVE_LOAD 0.69
+
+// the load cuckoo template tables are sized for by name_reserve, as
+// RESERVE_LOAD_FACTOR in cuckoo.c
+#define SPECTBL_CUCKOO_RESERVE_LOAD 0.4
+
+// directories of extendible template tables use at most this many hash bits
+// (the hash functions give 31)
+#define SPECTBL_MAX_DEPTH 30
+
+/* the == comparison of the plain (not _EQ) forms */
+#define DEFINE_SPECTBL_KEY_EQ(name, key_t)                                    \
+static inline bool name##_key_eq(key_t a, key_t b) {                          \
+	return a == b;                                                            \
+}
+
+/* * * *
+ * linear probing over buckets
+ */
+
+#define DEFINE_LINEAR_TABLE(name, key_t, hash_fn, bucket_n)                   \
+DEFINE_SPECTBL_KEY_EQ(name, key_t)                                            \
+DEFINE_LINEAR_TABLE_EQ(name, key_t, hash_fn, name##_key_eq, bucket_n)
+
+#define DEFINE_LINEAR_TABLE_EQ(name, key_t, hash_fn, eq_fn, bucket_n)         \
+/* fails to compile unless a bucket's count fits in its unsigned char */      \
+typedef char name##_bucket_n_check[(bucket_n) >= 1 && (bucket_n) <= 255       \
+	? 1 : -1];                                                                \
+                                                                              \
+typedef struct name##_table {                                                 \
+	key_t *keys;			/* bucket b holds keys[b*bucket_n ...] */         \
+	unsigned char *counts;	/* keys in each bucket */                         \
+	long nbuckets;			/* a power of two */                              \
+	long limit;				/* keys held before doubling */                   \
+	long nkeys;                                                               \
+	Memory memory;			/* heap memory held, struct included */           \
+} name##_table;                                                               \
+                                                                              \
+/* keys allowed in 'nbuckets' buckets before doubling */                      \
+static inline long name##_limit(long nbuckets) {                              \
+	long slots = nbuckets * (bucket_n);                                       \
+	long limit = (long)(slots * SPECTBL_MAX_LOAD);                            \
+	return limit < slots ? limit : slots - 1;                                 \
+}                                                                             \
+                                                                              \
+/* give 'table' 'nbuckets' empty buckets */                                   \
+static inline void name##_alloc(name##_table *table, long nbuckets) {         \
+	assert(nbuckets * (bucket_n) < MAX_TABLE_SIZE                             \
+		&& "error: table has grown too large!");                              \
+	table->keys = memory_malloc(&table->memory,                               \
+		sizeof *table->keys * (bucket_n) * nbuckets);                         \
+	assert(table->keys);                                                      \
+	table->counts = memory_calloc(&table->memory, nbuckets, 1);               \
+	assert(table->counts);                                                    \
+	table->nbuckets = nbuckets;                                               \
+	table->limit = name##_limit(nbuckets);                                    \
+}                                                                             \
+                                                                              \
+/* store 'key', known not to be in 'table', in the first bucket with room */  \
+static inline void name##_place(name##_table *table, key_t key) {             \
+	long mask = table->nbuckets - 1;                                          \
+	long b = hash_fn(key) & mask;                                             \
+	while (table->counts[b] == (bucket_n)) {                                  \
+		b = (b + 1) & mask;                                                   \
+	}                                                                         \
+	table->keys[b * (bucket_n) + table->counts[b]++] = key;                   \
+}                                                                             \
+                                                                              \
+/* move every key of 'table' into 'nbuckets' new buckets */                   \
+static inline void name##_resize(name##_table *table, long nbuckets) {        \
+	key_t *oldkeys = table->keys;                                             \
+	unsigned char *oldcounts = table->counts;                                 \
+	long b, oldnbuckets = table->nbuckets;                                    \
+	int i;                                                                    \
+                                                                              \
+	name##_alloc(table, nbuckets);                                            \
+	for (b = 0; b < oldnbuckets; b++) {                                       \
+		for (i = 0; i < oldcounts[b]; i++) {                                  \
+			name##_place(table, oldkeys[b * (bucket_n) + i]);                 \
+		}                                                                     \
+	}                                                                         \
+	memory_free(&table->memory, oldkeys);                                     \
+	memory_free(&table->memory, oldcounts);                                   \
+}                                                                             \
+                                                                              \
+static inline name##_table *name##_new(int size) {                            \
+	Memory memory;                                                            \
+	memory_init(&memory);                                                     \
+	name##_table *table = memory_malloc(&memory, sizeof *table);              \
+	assert(table);                                                            \
+	table->memory = memory;                                                   \
+                                                                              \
+	long nbuckets = 1;                                                        \
+	while (nbuckets * (bucket_n) < size) {                                    \
+		nbuckets *= 2;                                                        \
+	}                                                                         \
+	name##_alloc(table, nbuckets);                                            \
+	table->nkeys = 0;                                                         \
+	return table;                                                             \
+}                                                                             \
+                                                                              \
+static inline void name##_free(name##_table *table) {                         \
+	memory_free(&table->memory, table->keys);                                 \
+	memory_free(&table->memory, table->counts);                               \
+	memory_free(&table->memory, table);                                       \
+}                                                                             \
+                                                                              \
+static inline bool name##_lookup(const name##_table *table, key_t key) {      \
+	long mask = table->nbuckets - 1;                                          \
+	long b = hash_fn(key) & mask;                                             \
+	for (;;) {                                                                \
+		const key_t *keys = table->keys + b * (bucket_n);                     \
+		int i, n = table->counts[b];                                          \
+		for (i = 0; i < n; i++) {                                             \
+			if (eq_fn(keys[i], key)) {                                        \
+				return true;                                                  \
+			}                                                                 \
+		}                                                                     \
+		/* there is always a bucket with room, ending the probe */            \
+		if (n < (bucket_n)) {                                                 \
+			return false;                                                     \
+		}                                                                     \
+		b = (b + 1) & mask;                                                   \
+	}                                                                         \
+}                                                                             \
+                                                                              \
+static inline bool name##_insert(name##_table *table, key_t key) {            \
+	long mask = table->nbuckets - 1;                                          \
+	long b = hash_fn(key) & mask;                                             \
+	for (;;) {                                                                \
+		key_t *keys = table->keys + b * (bucket_n);                           \
+		int i, n = table->counts[b];                                          \
+		for (i = 0; i < n; i++) {                                             \
+			if (eq_fn(keys[i], key)) {                                        \
+				return false;                                                 \
+			}                                                                 \
+		}                                                                     \
+		if (n < (bucket_n)) {                                                 \
+			break;                                                            \
+		}                                                                     \
+		b = (b + 1) & mask;                                                   \
+	}                                                                         \
+                                                                              \
+	if (table->nkeys >= table->limit) {                                       \
+		name##_resize(table, table->nbuckets * 2);                            \
+		name##_place(table, key);                                             \
+	} else {                                                                  \
+		table->keys[b * (bucket_n) + table->counts[b]++] = key;               \
+	}                                                                         \
+	table->nkeys++;                                                           \
+	return true;                                                              \
+}                                                                             \
+                                                                              \
+static inline bool name##_reserve(name##_table *table, size_t nkeys) {        \
+	long nbuckets = table->nbuckets;                                          \
+	while ((size_t)name##_limit(nbuckets) < nkeys) {                          \
+		nbuckets *= 2;                                                        \
+		if (nbuckets * (bucket_n) >= MAX_TABLE_SIZE) {                        \
+			return false;                                                     \
+		}                                                                     \
+	}                                                                         \
+	if (nbuckets > table->nbuckets) {                                         \
+		name##_resize(table, nbuckets);                                       \
+	}                                                                         \
+	return true;                                                              \
+}                                                                             \
+                                                                              \
+static inline long name##_nkeys(const name##_table *table) {                  \
+	return table->nkeys;                                                      \
+}                                                                             \
+                                                                              \
+static inline void name##_memory(const name##_table *table, Memory *memory) { \
+	*memory = table->memory;                                                  \
+}
+
+/* * * *
+ * extendible hashing
+ */
+
+#define DEFINE_XTNDBL_TABLE(name, key_t, hash_fn, bucket_n)                   \
+DEFINE_SPECTBL_KEY_EQ(name, key_t)                                            \
+DEFINE_XTNDBL_TABLE_EQ(name, key_t, hash_fn, name##_key_eq, bucket_n)
+
+#define DEFINE_XTNDBL_TABLE_EQ(name, key_t, hash_fn, eq_fn, bucket_n)         \
+typedef struct name##_bucket {                                                \
+	int depth;				/* hash bits shared by every key in here */       \
+	int nkeys;                                                                \
+	key_t keys[bucket_n];                                                     \
+} name##_bucket;                                                              \
+                                                                              \
+typedef struct name##_table {                                                 \
+	name##_bucket **buckets;	/* the directory, 2^depth entries */          \
+	int depth;                                                                \
+	long nbuckets;			/* distinct buckets */                            \
+	long nkeys;                                                               \
+	Memory memory;			/* heap memory held, struct included */           \
+} name##_table;                                                               \
+                                                                              \
+/* the directory entry for a hash, using 'depth' bits of it */                \
+static inline long name##_address(int hash, int depth) {                      \
+	return hash & ((1L << depth) - 1);                                        \
+}                                                                             \
+                                                                              \
+static inline name##_bucket *name##_new_bucket(name##_table *table,           \
+		int depth) {                                                          \
+	name##_bucket *bucket = memory_malloc(&table->memory, sizeof *bucket);    \
+	assert(bucket);                                                           \
+	bucket->depth = depth;                                                    \
+	bucket->nkeys = 0;                                                        \
+	table->nbuckets++;                                                        \
+	return bucket;                                                            \
+}                                                                             \
+                                                                              \
+/* double the directory, each new entry sharing its twin's bucket */          \
+static inline void name##_double(name##_table *table) {                       \
+	long i, size = 1L << table->depth;                                        \
+	assert(table->depth < SPECTBL_MAX_DEPTH                                   \
+		&& "error: table has grown too large!");                              \
+	table->buckets = memory_realloc(&table->memory, table->buckets,           \
+		sizeof *table->buckets * size * 2);                                   \
+	assert(table->buckets);                                                   \
+	for (i = 0; i < size; i++) {                                              \
+		table->buckets[size + i] = table->buckets[i];                         \
+	}                                                                         \
+	table->depth++;                                                           \
+}                                                                             \
+                                                                              \
+/* split the bucket at directory entry 'address' in two, on its next bit */   \
+static inline void name##_split(name##_table *table, long address) {          \
+	name##_bucket *bucket = table->buckets[address];                          \
+	if (bucket->depth == table->depth) {                                      \
+		name##_double(table);                                                 \
+	}                                                                         \
+                                                                              \
+	/* entries with the new bit set move to the new bucket */                 \
+	int depth = bucket->depth;                                                \
+	long a, first = name##_address(address, depth) | (1L << depth);           \
+	name##_bucket *sibling = name##_new_bucket(table, depth + 1);             \
+	bucket->depth = depth + 1;                                                \
+	for (a = first; a < (1L << table->depth); a += 1L << (depth + 1)) {       \
+		table->buckets[a] = sibling;                                          \
+	}                                                                         \
+                                                                              \
+	int i, n = bucket->nkeys;                                                 \
+	bucket->nkeys = 0;                                                        \
+	for (i = 0; i < n; i++) {                                                 \
+		key_t key = bucket->keys[i];                                          \
+		if (hash_fn(key) & (1L << depth)) {                                   \
+			sibling->keys[sibling->nkeys++] = key;                            \
+		} else {                                                              \
+			bucket->keys[bucket->nkeys++] = key;                              \
+		}                                                                     \
+	}                                                                         \
+}                                                                             \
+                                                                              \
+static inline name##_table *name##_new(int size) {                            \
+	(void)size;                                                               \
+	Memory memory;                                                            \
+	memory_init(&memory);                                                     \
+	name##_table *table = memory_malloc(&memory, sizeof *table);              \
+	assert(table);                                                            \
+	table->memory = memory;                                                   \
+                                                                              \
+	table->depth = 0;                                                         \
+	table->nbuckets = 0;                                                      \
+	table->nkeys = 0;                                                         \
+	table->buckets = memory_malloc(&table->memory, sizeof *table->buckets);   \
+	assert(table->buckets);                                                   \
+	table->buckets[0] = name##_new_bucket(table, 0);                          \
+	return table;                                                             \
+}                                                                             \
+                                                                              \
+static inline void name##_free(name##_table *table) {                         \
+	long a, b, size = 1L << table->depth;                                     \
+	for (a = 0; a < size; a++) {                                              \
+		name##_bucket *bucket = table->buckets[a];                            \
+		if (!bucket) {                                                        \
+			continue;                                                         \
+		}                                                                     \
+		/* clear the bucket's later entries, so it is freed only once */      \
+		for (b = a; b < size; b += 1L << bucket->depth) {                     \
+			table->buckets[b] = NULL;                                         \
+		}                                                                     \
+		memory_free(&table->memory, bucket);                                  \
+	}                                                                         \
+	memory_free(&table->memory, table->buckets);                              \
+	memory_free(&table->memory, table);                                       \
+}                                                                             \
+                                                                              \
+static inline bool name##_lookup(const name##_table *table, key_t key) {      \
+	const name##_bucket *bucket =                                             \
+		table->buckets[name##_address(hash_fn(key), table->depth)];           \
+	int i;                                                                    \
+	for (i = 0; i < bucket->nkeys; i++) {                                     \
+		if (eq_fn(bucket->keys[i], key)) {                                    \
+			return true;                                                      \
+		}                                                                     \
+	}                                                                         \
+	return false;                                                             \
+}                                                                             \
+                                                                              \
+static inline bool name##_insert(name##_table *table, key_t key) {            \
+	int hash = hash_fn(key);                                                  \
+	long address = name##_address(hash, table->depth);                        \
+	name##_bucket *bucket = table->buckets[address];                          \
+	int i;                                                                    \
+	for (i = 0; i < bucket->nkeys; i++) {                                     \
+		if (eq_fn(bucket->keys[i], key)) {                                    \
+			return false;                                                     \
+		}                                                                     \
+	}                                                                         \
+                                                                              \
+	/* split until the key's bucket has room; its keys may all go one way */  \
+	while (bucket->nkeys == (bucket_n)) {                                     \
+		name##_split(table, address);                                         \
+		address = name##_address(hash, table->depth);                         \
+		bucket = table->buckets[address];                                     \
+	}                                                                         \
+	bucket->keys[bucket->nkeys++] = key;                                      \
+	table->nkeys++;                                                           \
+	return true;                                                              \
+}                                                                             \
+                                                                              \
+static inline bool name##_reserve(name##_table *table, size_t nkeys) {        \
+	int depth = 0;                                                            \
+	while ((1L << depth) * (bucket_n) * SPECTBL_XTNDBL_RESERVE_LOAD < nkeys) { \
+		if (++depth > SPECTBL_MAX_DEPTH) {                                    \
+			return false;                                                     \
+		}                                                                     \
+	}                                                                         \
+	while (table->depth < depth) {                                            \
+		name##_double(table);                                                 \
+	}                                                                         \
+	long a;                                                                   \
+	for (a = 0; a < (1L << depth); a++) {                                     \
+		while (table->buckets[a]->depth < depth) {                            \
+			name##_split(table, a);                                           \
+		}                                                                     \
+	}                                                                         \
+	return true;                                                              \
+}                                                                             \
+                                                                              \
+static inline long name##_nkeys(const name##_table *table) {                  \
+	return table->nkeys;                                                      \
+}                                                                             \
+                                                                              \
+static inline void name##_memory(const name##_table *table, Memory *memory) { \
+	*memory = table->memory;                                                  \
+}
+
+/* * * *
+ * cuckoo hashing
+ */
+
+#define DEFINE_CUCKOO_TABLE(name, key_t, hash1_fn, hash2_fn)                  \
+DEFINE_SPECTBL_KEY_EQ(name, key_t)                                            \
+DEFINE_CUCKOO_TABLE_EQ(name, key_t, hash1_fn, hash2_fn, name##_key_eq)
+
+#define DEFINE_CUCKOO_TABLE_EQ(name, key_t, hash1_fn, hash2_fn, eq_fn)        \
+typedef struct name##_table {                                                 \
+	key_t *slots[2];		/* the two inner tables */                        \
+	unsigned char *inuse[2];                                                  \
+	long size;				/* slots in each inner table, a power of two */   \
+	int maxkicks;			/* kicks before the tables are doubled */         \
+	long nkeys;                                                               \
+	Memory memory;			/* heap memory held, struct included */           \
+} name##_table;                                                               \
+                                                                              \
+/* the slot 'key' hashes to in inner table 'side' */                          \
+static inline long name##_slot(const name##_table *table, int side,           \
+		key_t key) {                                                          \
+	return (side ? hash2_fn(key) : hash1_fn(key)) & (table->size - 1);        \
+}                                                                             \
+                                                                              \
+/* give 'table' two empty inner tables of 'size' slots */                     \
+static inline void name##_alloc(name##_table *table, long size) {             \
+	int side, bits = 0;                                                       \
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");     \
+	for (side = 0; side < 2; side++) {                                        \
+		table->slots[side] = memory_malloc(&table->memory,                    \
+			sizeof *table->slots[side] * size);                               \
+		assert(table->slots[side]);                                           \
+		table->inuse[side] = memory_calloc(&table->memory, size, 1);          \
+		assert(table->inuse[side]);                                           \
+	}                                                                         \
+	while ((1L << bits) < size) {                                             \
+		bits++;                                                               \
+	}                                                                         \
+	table->size = size;                                                       \
+	table->maxkicks = 8 + 3 * bits;                                           \
+}                                                                             \
+                                                                              \
+/* place '*key' by kicking keys between the inner tables. false if a key is   \
+ * still without a slot after maxkicks kicks; that key is left in '*key' */   \
+static inline bool name##_kick(name##_table *table, key_t *key) {             \
+	int kicks, side = 0;                                                      \
+	for (kicks = 0; kicks <= table->maxkicks; kicks++) {                      \
+		long slot = name##_slot(table, side, *key);                           \
+		if (!table->inuse[side][slot]) {                                      \
+			table->slots[side][slot] = *key;                                  \
+			table->inuse[side][slot] = 1;                                     \
+			return true;                                                      \
+		}                                                                     \
+		key_t held = table->slots[side][slot];                                \
+		table->slots[side][slot] = *key;                                      \
+		*key = held;                                                          \
+		side = !side;                                                         \
+	}                                                                         \
+	return false;                                                             \
+}                                                                             \
+                                                                              \
+/* move every key of 'table', and 'extra' (if 'more'), into inner tables of   \
+ * at least 'size' slots, doubling again until they all find a place */       \
+static inline void name##_resize(name##_table *table, long size,              \
+		key_t extra, bool more) {                                             \
+	key_t *oldslots[2] = {table->slots[0], table->slots[1]};                  \
+	unsigned char *oldinuse[2] = {table->inuse[0], table->inuse[1]};          \
+	long i, oldsize = table->size;                                            \
+	int side;                                                                 \
+                                                                              \
+	for (;; size *= 2) {                                                      \
+		name##_alloc(table, size);                                            \
+		bool placed = true;                                                   \
+		for (side = 0; side < 2 && placed; side++) {                          \
+			for (i = 0; i < oldsize && placed; i++) {                         \
+				key_t key = oldslots[side][i];                                \
+				placed = !oldinuse[side][i] || name##_kick(table, &key);      \
+			}                                                                 \
+		}                                                                     \
+		/* a failed attempt may leave 'extra' in the tables it discards */    \
+		key_t carried = extra;                                                \
+		if (placed && (!more || name##_kick(table, &carried))) {              \
+			break;                                                            \
+		}                                                                     \
+		for (side = 0; side < 2; side++) {                                    \
+			memory_free(&table->memory, table->slots[side]);                  \
+			memory_free(&table->memory, table->inuse[side]);                  \
+		}                                                                     \
+	}                                                                         \
+                                                                              \
+	for (side = 0; side < 2; side++) {                                        \
+		memory_free(&table->memory, oldslots[side]);                          \
+		memory_free(&table->memory, oldinuse[side]);                          \
+	}                                                                         \
+}                                                                             \
+                                                                              \
+static inline name##_table *name##_new(int size) {                            \
+	Memory memory;                                                            \
+	memory_init(&memory);                                                     \
+	name##_table *table = memory_malloc(&memory, sizeof *table);              \
+	assert(table);                                                            \
+	table->memory = memory;                                                   \
+                                                                              \
+	long slots = 1;                                                           \
+	while (slots < size) {                                                    \
+		slots *= 2;                                                           \
+	}                                                                         \
+	name##_alloc(table, slots);                                               \
+	table->nkeys = 0;                                                         \
+	return table;                                                             \
+}                                                                             \
+                                                                              \
+static inline void name##_free(name##_table *table) {                         \
+	int side;                                                                 \
+	for (side = 0; side < 2; side++) {                                        \
+		memory_free(&table->memory, table->slots[side]);                      \
+		memory_free(&table->memory, table->inuse[side]);                      \
+	}                                                                         \
+	memory_free(&table->memory, table);                                       \
+}                                                                             \
+                                                                              \
+static inline bool name##_lookup(const name##_table *table, key_t key) {      \
+	int side;                                                                 \
+	for (side = 0; side < 2; side++) {                                        \
+		long slot = name##_slot(table, side, key);                            \
+		if (table->inuse[side][slot]                                          \
+				&& eq_fn(table->slots[side][slot], key)) {                    \
+			return true;                                                      \
+		}                                                                     \
+	}                                                                         \
+	return false;                                                             \
+}                                                                             \
+                                                                              \
+static inline bool name##_insert(name##_table *table, key_t key) {            \
+	if (name##_lookup(table, key)) {                                          \
+		return false;                                                         \
+	}                                                                         \
+	/* the key left over from a failed kick chain goes in with the rest */    \
+	if (!name##_kick(table, &key)) {                                          \
+		name##_resize(table, table->size * 2, key, true);                     \
+	}                                                                         \
+	table->nkeys++;                                                           \
+	return true;                                                              \
+}                                                                             \
+                                                                              \
+static inline bool name##_reserve(name##_table *table, size_t nkeys) {        \
+	long size = table->size;                                                  \
+	while (2 * size * SPECTBL_CUCKOO_RESERVE_LOAD < nkeys) {                  \
+		size *= 2;                                                            \
+		if (size >= MAX_TABLE_SIZE) {                                         \
+			return false;                                                     \
+		}                                                                     \
+	}                                                                         \
+	if (size > table->size) {                                                 \
+		key_t none;                                                           \
+		memset(&none, 0, sizeof none);                                        \
+		name##_resize(table, size, none, false);                              \
+	}                                                                         \
+	return true;                                                              \
+}                                                                             \
+                                                                              \
+static inline long name##_nkeys(const name##_table *table) {                  \
+	return table->nkeys;                                                      \
+}                                                                             \
+                                                                              \
+static inline void name##_memory(const name##_table *table, Memory *memory) { \
+	*memory = table->memory;                                                  \
+}
+
+#endif
@@ -0,0 +1,464 @@
+/* * * * * * * * *
+ * Hash tables keyed by byte strings, with the key bytes kept in an
+ * append-only arena (see strtbl.h)
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+
+#include "strtbl.h"
+#include "../inthash.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+
+// the load at which STR_LINEAR tables double
+#define STR_MAX_LOAD 0.75
+
+// bytes the arena starts with. it doubles whenever it fills up
+#define ARENA_INITIAL 4096
+
+// a key, as a slot or bucket entry holds it. key bytes are stored in the
+// arena as a 32-bit length followed by the bytes themselves
+typedef struct str_slot {
+	uint64_t hash;		// hash of the key's bytes, compared before them
+	uint64_t offset;	// where the key's length and bytes are in the arena,
+						// or 0 if the slot is free (the arena never uses 0)
+} StrSlot;
+
+// append-only store of key bytes. keys are never removed, so an offset
+// stays valid as the arena grows
+typedef struct arena {
+	char *bytes;
+	uint64_t used;		// bytes used so far, including the unused first one
+	uint64_t capacity;
+} Arena;
+
+// an STR_XTNDBL bucket: up to 'bucketsize' entries sharing 'depth' hash bits
+typedef struct str_bucket {
+	int depth;
+	int nkeys;
+	StrSlot slots[];
+} StrBucket;
+
+struct str_table {
+	StrTableKind kind;
+	Arena arena;
+
+	// STR_LINEAR: an array of slots, a power of two long
+	StrSlot *slots;
+	long size;
+
+	// STR_XTNDBL: a directory of 2^depth bucket pointers
+	StrBucket **buckets;
+	int depth;
+	int bucketsize;
+	long nbuckets;		// distinct buckets
+
+	long nkeys;
+	long collisions;	// inserts that could not use their first slot
+	long probes;		// slots stepped over by all inserts
+	long nresizes;		// doublings of the slots or the directory
+
+	Memory memory;		// heap memory held, struct and arena included
+};
+
+
+/* * * *
+ * helper functions
+ */
+
+// FNV-1a over the key's bytes, finished with a 64-bit mix so that every byte
+// affects the low bits used for addressing
+static uint64_t hash_bytes(const char *key, size_t len) {
+	uint64_t hash = 14695981039346656037ULL;
+	size_t i;
+	for (i = 0; i < len; i++) {
+		hash ^= (unsigned char)key[i];
+		hash *= 1099511628211ULL;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+// copy 'key' into the arena, returning where it was put
+static uint64_t arena_append(StrHashTable *table, const char *key,
+		size_t len) {
+	Arena *arena = &table->arena;
+	uint32_t len32 = len;
+	assert(len32 == len && "error: key is too long!");
+
+	uint64_t need = arena->used + sizeof len32 + len;
+	if (need > arena->capacity) {
+		while (arena->capacity < need) {
+			arena->capacity *= 2;
+		}
+		arena->bytes = memory_realloc(&table->memory, arena->bytes,
+			arena->capacity);
+		assert(arena->bytes);
+	}
+
+	uint64_t offset = arena->used;
+	memcpy(arena->bytes + offset, &len32, sizeof len32);
+	memcpy(arena->bytes + offset + sizeof len32, key, len);
+	arena->used = need;
+	return offset;
+}
+
+// the length of the key at 'offset', and a pointer to its bytes
+static const char *arena_key(StrHashTable *table, uint64_t offset,
+		uint32_t *len) {
+	memcpy(len, table->arena.bytes + offset, sizeof *len);
+	return table->arena.bytes + offset + sizeof *len;
+}
+
+// does 'slot' hold the key 'key' of 'len' bytes, which hashes to 'hash'?
+// the key bytes are only read if the hashes match
+static bool slot_matches(StrHashTable *table, const StrSlot *slot,
+		uint64_t hash, const char *key, size_t len) {
+	if (slot->hash != hash) {
+		return false;
+	}
+	uint32_t slotlen;
+	const char *bytes = arena_key(table, slot->offset, &slotlen);
+	return slotlen == len && memcmp(bytes, key, len) == 0;
+}
+
+// the slot array of an STR_LINEAR table, 'size' free slots
+static StrSlot *new_slots(StrHashTable *table, long size) {
+	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
+	StrSlot *slots = memory_calloc(&table->memory, size, sizeof *slots);
+	assert(slots);
+	return slots;
+}
+
+// the index of the slot holding the key (true), or the free slot it would go
+// in (false), stepping over 'steps' slots on the way
+static bool linear_find(StrHashTable *table, uint64_t hash, const char *key,
+		size_t len, long *index, long *steps) {
+	long mask = table->size - 1;
+	long h = hash & mask;
+	*steps = 0;
+
+	// the load is kept below 1, so there is always a free slot to stop at
+	while (table->slots[h].offset) {
+		if (slot_matches(table, &table->slots[h], hash, key, len)) {
+			*index = h;
+			return true;
+		}
+		h = (h + 1) & mask;
+		(*steps)++;
+	}
+	*index = h;
+	return false;
+}
+
+// double the slots of an STR_LINEAR table, placing keys by their stored hash
+static void linear_double(StrHashTable *table) {
+	StrSlot *oldslots = table->slots;
+	long i, oldsize = table->size;
+
+	table->size = oldsize * 2;
+	table->slots = new_slots(table, table->size);
+	for (i = 0; i < oldsize; i++) {
+		if (oldslots[i].offset) {
+			long h = oldslots[i].hash & (table->size - 1);
+			while (table->slots[h].offset) {
+				h = (h + 1) & (table->size - 1);
+			}
+			table->slots[h] = oldslots[i];
+		}
+	}
+	memory_free(&table->memory, oldslots);
+	table->nresizes++;
+}
+
+// a new STR_XTNDBL bucket using 'depth' bits of the hash
+static StrBucket *new_bucket(StrHashTable *table, int depth) {
+	StrBucket *bucket = memory_malloc(&table->memory,
+		sizeof *bucket + sizeof *bucket->slots * table->bucketsize);
+	assert(bucket);
+	bucket->depth = depth;
+	bucket->nkeys = 0;
+	table->nbuckets++;
+	return bucket;
+}
+
+// double the directory of an STR_XTNDBL table, each new entry sharing its
+// twin's bucket
+static void xtndbl_double(StrHashTable *table) {
+	long i, size = 1L << table->depth;
+	assert(size * 2 <= MAX_TABLE_SIZE && "error: table has grown too large!");
+	table->buckets = memory_realloc(&table->memory, table->buckets,
+		sizeof *table->buckets * size * 2);
+	assert(table->buckets);
+	for (i = 0; i < size; i++) {
+		table->buckets[size + i] = table->buckets[i];
+	}
+	table->depth++;
+	table->nresizes++;
+}
+
+// split the bucket at directory entry 'address' on its next hash bit, moving
+// entries by their stored hash
+static void xtndbl_split(StrHashTable *table, long address) {
+	StrBucket *bucket = table->buckets[address];
+	if (bucket->depth == table->depth) {
+		xtndbl_double(table);
+	}
+
+	// entries of the directory with the new bit set go to the new bucket
+	int depth = bucket->depth;
+	long a, first = (address & ((1L << depth) - 1)) | (1L << depth);
+	StrBucket *sibling = new_bucket(table, depth + 1);
+	bucket->depth = depth + 1;
+	for (a = first; a < (1L << table->depth); a += 1L << (depth + 1)) {
+		table->buckets[a] = sibling;
+	}
+
+	int i, n = bucket->nkeys;
+	bucket->nkeys = 0;
+	for (i = 0; i < n; i++) {
+		StrSlot slot = bucket->slots[i];
+		if (slot.hash & (1L << depth)) {
+			sibling->slots[sibling->nkeys++] = slot;
+		} else {
+			bucket->slots[bucket->nkeys++] = slot;
+		}
+	}
+}
+
+// the bucket an STR_XTNDBL key with hash 'hash' belongs in
+static StrBucket *xtndbl_bucket(StrHashTable *table, uint64_t hash) {
+	return table->buckets[hash & ((1L << table->depth) - 1)];
+}
+
+// the entry of 'bucket' holding the key, or -1
+static int bucket_find(StrHashTable *table, StrBucket *bucket, uint64_t hash,
+		const char *key, size_t len) {
+	int i;
+	for (i = 0; i < bucket->nkeys; i++) {
+		if (slot_matches(table, &bucket->slots[i], hash, key, len)) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+
+/* * * *
+ * all functions
+ */
+
+// initialise a string keyed table of layout 'kind'
+StrHashTable *new_str_hash_table(StrTableKind kind, int size) {
+	assert(size > 0);
+	Memory memory;
+	memory_init(&memory);
+	StrHashTable *table = memory_malloc(&memory, sizeof *table);
+	assert(table);
+	table->memory = memory;
+
+	table->kind = kind;
+	table->nkeys = 0;
+	table->collisions = 0;
+	table->probes = 0;
+	table->nresizes = 0;
+
+	// offset 0 marks free slots, so the arena never hands it out
+	table->arena.capacity = ARENA_INITIAL;
+	table->arena.bytes = memory_malloc(&table->memory, ARENA_INITIAL);
+	assert(table->arena.bytes);
+	table->arena.used = 1;
+
+	table->slots = NULL;
+	table->size = 0;
+	table->buckets = NULL;
+	table->depth = 0;
+	table->bucketsize = 0;
+	table->nbuckets = 0;
+
+	if (kind == STR_LINEAR) {
+		table->size = 1;
+		while (table->size < size) {
+			table->size *= 2;
+		}
+		table->slots = new_slots(table, table->size);
+	} else {
+		table->bucketsize = size;
+		table->buckets = memory_malloc(&table->memory, sizeof *table->buckets);
+		assert(table->buckets);
+		table->buckets[0] = new_bucket(table, 0);
+	}
+	return table;
+}
+
+// free all memory associated with 'table'
+void free_str_hash_table(StrHashTable *table) {
+	assert(table != NULL);
+	if (table->kind == STR_LINEAR) {
+		memory_free(&table->memory, table->slots);
+	} else {
+		// clear a bucket's later directory entries, so it is freed only once
+		long a, b, size = 1L << table->depth;
+		for (a = 0; a < size; a++) {
+			StrBucket *bucket = table->buckets[a];
+			if (!bucket) {
+				continue;
+			}
+			for (b = a; b < size; b += 1L << bucket->depth) {
+				table->buckets[b] = NULL;
+			}
+			memory_free(&table->memory, bucket);
+		}
+		memory_free(&table->memory, table->buckets);
+	}
+	memory_free(&table->memory, table->arena.bytes);
+	memory_free(&table->memory, table);
+}
+
+// insert a copy of 'key' into 'table', if it's not in there already
+bool str_hash_table_insert(StrHashTable *table, const char *key, size_t len) {
+	assert(table != NULL);
+	uint64_t hash = hash_bytes(key, len);
+
+	if (table->kind == STR_LINEAR) {
+		long index, steps;
+		if (linear_find(table, hash, key, len, &index, &steps)) {
+			return false;
+		}
+		// make room first, then find the key's free slot in the new array
+		if (table->nkeys + 1 > table->size * STR_MAX_LOAD) {
+			linear_double(table);
+			linear_find(table, hash, key, len, &index, &steps);
+		}
+		table->slots[index].hash = hash;
+		table->slots[index].offset = arena_append(table, key, len);
+		table->collisions += steps > 0;
+		table->probes += steps;
+	} else {
+		StrBucket *bucket = xtndbl_bucket(table, hash);
+		if (bucket_find(table, bucket, hash, key, len) >= 0) {
+			return false;
+		}
+		// split until the key's bucket has room; its keys may all go one way
+		while (bucket->nkeys == table->bucketsize) {
+			xtndbl_split(table, hash & ((1L << table->depth) - 1));
+			bucket = xtndbl_bucket(table, hash);
+		}
+		StrSlot *slot = &bucket->slots[bucket->nkeys++];
+		slot->hash = hash;
+		slot->offset = arena_append(table, key, len);
+	}
+
+	table->nkeys++;
+	return true;
+}
+
+// lookup whether 'key' is inside 'table'
+bool str_hash_table_lookup(StrHashTable *table, const char *key, size_t len) {
+	assert(table != NULL);
+	uint64_t hash = hash_bytes(key, len);
+
+	if (table->kind == STR_LINEAR) {
+		long index, steps;
+		return linear_find(table, hash, key, len, &index, &steps);
+	}
+	return bucket_find(table, xtndbl_bucket(table, hash), hash, key, len) >= 0;
+}
+
+// print the key held in 'slot' to stdout
+static void print_key(StrHashTable *table, const StrSlot *slot) {
+	uint32_t len;
+	const char *bytes = arena_key(table, slot->offset, &len);
+	printf("%.*s", (int)len, bytes);
+}
+
+// print the contents of 'table' to stdout
+void str_hash_table_print(StrHashTable *table) {
+	assert(table != NULL);
+	long i;
+
+	if (table->kind == STR_LINEAR) {
+		printf("--- table size: %ld\n", table->size);
+		printf("   address | key\n");
+		for (i = 0; i < table->size; i++) {
+			printf(" %9ld | ", i);
+			if (table->slots[i].offset) {
+				print_key(table, &table->slots[i]);
+				printf("\n");
+			} else {
+				printf("-\n");
+			}
+		}
+		printf("--- end table ---\n");
+		return;
+	}
+
+	long size = 1L << table->depth;
+	printf("--- table size: %ld\n", size);
+	printf("  table:               buckets:\n");
+	printf("  address | bucketid   bucketid [key]\n");
+	for (i = 0; i < size; i++) {
+		// a bucket's id is the first address pointing to it
+		StrBucket *bucket = table->buckets[i];
+		long id = i & ((1L << bucket->depth) - 1);
+		printf("%9ld | %-9ld ", i, id);
+		if (id == i) {
+			printf("%9ld [", id);
+			int j;
+			for (j = 0; j < table->bucketsize; j++) {
+				printf(" ");
+				if (j < bucket->nkeys) {
+					print_key(table, &bucket->slots[j]);
+				} else {
+					printf("-");
+				}
+			}
+			printf(" ]");
+		}
+		printf("\n");
+	}
+	printf("--- end table ---\n");
+}
+
+// fill 'stats' with the statistics this table tracks
+void str_hash_table_get_stats(StrHashTable *table, HashTableStats *stats) {
+	assert(table != NULL);
+	stats->nkeys = table->nkeys;
+	stats->resizes = table->nresizes;
+	if (table->kind == STR_LINEAR) {
+		stats->type = "strlinear";
+		stats->size = table->size;
+		stats->load_factor = (double)table->nkeys/table->size;
+		stats->collisions = table->collisions;
+		stats->probe_length = table->nkeys
+			? (double)table->probes/table->nkeys : 0;
+	} else {
+		stats->type = "strxtndbl";
+		stats->size = 1L << table->depth;
+		stats->nbuckets = table->nbuckets;
+		stats->bucketsize = table->bucketsize;
+		stats->load_factor =
+			(double)table->nkeys/(table->nbuckets*table->bucketsize);
+		stats->splits = table->nbuckets - 1;
+	}
+	stats->memory = table->memory.bytes;
+	stats->peak_memory = table->memory.peak;
+}
+
+// copy the memory currently and at most held by 'table' into 'memory'
+void str_hash_table_memory(StrHashTable *table, Memory *memory) {
+	*memory = table->memory;
+}
@@ -0,0 +1,63 @@
+/* * * * * * * * *
+ * Hash tables keyed by byte strings, (const char *, size_t) pairs such as
+ * URLs and ids, instead of int64 keys
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * The table copies each key's bytes into an append-only arena. Slots and
+ * bucket entries hold only the key's 64-bit hash and its offset in the
+ * arena. A probe compares hashes first and reads key bytes only when the
+ * hashes match. Growing the table moves slots but never key bytes, and
+ * reuses the stored hashes, so keys are never hashed again.
+ *
+ * Two layouts are available:
+ *   STR_LINEAR: linear probing as in linear.c. The table doubles once
+ *               STR_MAX_LOAD of its slots are in use.
+ *   STR_XTNDBL: extendible hashing with multi-key buckets as in xtndbln.c.
+ */
+
+#ifndef STRTBL_H
+#define STRTBL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "../memacct.h"
+#include "../tblstats.h"
+
+// how the keys of a table are laid out
+typedef enum str_table_kind {
+	STR_LINEAR,		// linear probing
+	STR_XTNDBL		// extendible hashing
+} StrTableKind;
+
+typedef struct str_table StrHashTable;
+
+// initialise a string keyed table. 'size' is the initial number of slots
+// for STR_LINEAR, or the keys per bucket for STR_XTNDBL
+StrHashTable *new_str_hash_table(StrTableKind kind, int size);
+
+// free all memory associated with 'table', key bytes included
+void free_str_hash_table(StrHashTable *table);
+
+// insert a copy of the 'len' bytes at 'key' into 'table', if those bytes
+// are not in there already. returns true if inserted, false if already in
+bool str_hash_table_insert(StrHashTable *table, const char *key, size_t len);
+
+// lookup whether the 'len' bytes at 'key' are inside 'table'
+// returns true if found, false if not
+bool str_hash_table_lookup(StrHashTable *table, const char *key, size_t len);
+
+// print the contents of 'table' to stdout
+void str_hash_table_print(StrHashTable *table);
+
+// fill 'stats' with the statistics this table tracks
+void str_hash_table_get_stats(StrHashTable *table, HashTableStats *stats);
+
+// copy the memory currently and at most held by 'table' (arena included)
+// into 'memory'
+void str_hash_table_memory(StrHashTable *table, Memory *memory);
+
+#endif
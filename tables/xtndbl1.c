@@ -18,10 +18,17 @@
 #include <time.h>
 
 #include "xtndbl1.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+#include "../trace.h"
 
 // macro to calculate the rightmost n bits of a number x
 #define rightmostnbits(n, x) (x) & ((1 << (n)) - 1)
 
+// the fraction of buckets xtndbl1_hash_table_reserve expects to be full. with
+// one key per bucket, any two keys sharing their low hash bits force a split
+#define RESERVE_LOAD_FACTOR 0.5
+
 // a bucket stores a single key (full=true) or is empty (full=false)
 // it also knows how many bits are shared between possible keys, and the first 
 // table address that references it
@@ -39,6 +46,9 @@ typedef struct stats {
 	int nkeys;		// how many keys are being stored in the table
 	int time;		// how much CPU time has been used to insert/lookup keys
 					// in this table
+	int lookup_time;// how much of that time was spent on lookups
+	Memory memory;	// how much heap memory the table is holding
+	Histogram splits;	// how many buckets each insert had to split
 } Stats;
 
 // a hash table is an array of slots pointing to buckets holding up to 1 key,
@@ -57,8 +67,8 @@ struct xtndbl1_table {
 
 // create a new bucket first referenced from 'first_address', based on 'depth'
 // bits of its keys' hash values
-static Bucket *new_bucket(int first_address, int depth) {
-	Bucket *bucket = malloc(sizeof *bucket);
+static Bucket *new_bucket(Memory *memory, int first_address, int depth) {
+	Bucket *bucket = memory_malloc(memory, sizeof *bucket);
 	assert(bucket);
 
 	bucket->id = first_address;
@@ -71,11 +81,13 @@ static Bucket *new_bucket(int first_address, int depth) {
 // double the table of bucket pointers, duplicating the bucket pointers in the
 // first half into the new second half of the table
 static void double_table(Xtndbl1HashTable *table) {
+	uint64_t start = trace_clock();
 	int size = table->size * 2;
 	assert(size < MAX_TABLE_SIZE && "error: table has grown too large!");
 
 	// get a new array of twice as many bucket pointers, and copy pointers down
-	table->buckets = realloc(table->buckets, (sizeof *table->buckets) * size);
+	table->buckets = memory_realloc(&table->stats.memory, table->buckets,
+		(sizeof *table->buckets) * size);
 	assert(table->buckets);
 	int i;
 	for (i = 0; i < table->size; i++) {
@@ -85,6 +97,9 @@ static void double_table(Xtndbl1HashTable *table) {
 	// finally, increase the table size and the depth we are using to hash keys
 	table->size = size;
 	table->depth++;
+
+	// only pointers are copied, no keys move
+	trace_record(TRACE_XTNDBL1_DOUBLE, start, size / 2, size, 0);
 }
 
 // reinsert a key into the hash table after splitting a bucket --- we can assume
@@ -99,6 +114,7 @@ static void reinsert_key(Xtndbl1HashTable *table, int64 key) {
 
 // split the bucket in 'table' at address 'address', growing table if necessary
 static void split_bucket(Xtndbl1HashTable *table, int address) {
+	uint64_t start = trace_clock();
 	
 	// FIRST,
 	// do we need to grow the table?
@@ -120,7 +136,8 @@ static void split_bucket(Xtndbl1HashTable *table, int address) {
 
 	// new bucket's first address will be a 1 bit plus the old first address
 	int new_first_address = 1 << depth | first_address;
-	Bucket *newbucket = new_bucket(new_first_address, new_depth);
+	Bucket *newbucket = new_bucket(&table->stats.memory, new_first_address,
+		new_depth);
 	table->stats.nbuckets++;
 	
 	// THIRD,
@@ -151,10 +168,20 @@ static void split_bucket(Xtndbl1HashTable *table, int address) {
 	// filter the key from the old bucket into its rightful place in the new 
 	// table (which may be the old bucket, or may be the new bucket)
 
-	// remove and reinsert the key
-	int64 key = bucket->key;
-	bucket->full = false;
-	reinsert_key(table, key);
+	// remove and reinsert the key, if there is one (reserving splits empty
+	// buckets too)
+	int moved = 0;
+	if (bucket->full) {
+		int64 key = bucket->key;
+		bucket->full = false;
+		reinsert_key(table, key);
+
+		// the key moved if it now lives in the new bucket
+		moved = table->buckets[rightmostnbits(table->depth, h1(key))]
+			== newbucket;
+	}
+	trace_record(TRACE_XTNDBL1_SPLIT, start, table->stats.nbuckets - 1,
+		table->stats.nbuckets, moved);
 }
 
 
@@ -164,18 +191,23 @@ static void split_bucket(Xtndbl1HashTable *table, int address) {
 
 // initialise a single-key extendible hash table
 Xtndbl1HashTable *new_xtndbl1_hash_table() {
-	Xtndbl1HashTable *table = malloc(sizeof *table);
+	Memory memory;
+	memory_init(&memory);
+	Xtndbl1HashTable *table = memory_malloc(&memory, sizeof *table);
 	assert(table);
+	table->stats.memory = memory;
 
 	table->size = 1;
-	table->buckets = malloc(sizeof *table->buckets);
+	table->buckets = memory_malloc(&table->stats.memory, sizeof *table->buckets);
 	assert(table->buckets);
-	table->buckets[0] = new_bucket(0, 0);
+	table->buckets[0] = new_bucket(&table->stats.memory, 0, 0);
 	table->depth = 0;
 
 	table->stats.nbuckets = 1;
 	table->stats.nkeys = 0;
 	table->stats.time = 0;
+	table->stats.lookup_time = 0;
+	init_histogram(&table->stats.splits, "splits per insert", 1);
 
 	return table;
 }
@@ -191,15 +223,45 @@ void free_xtndbl1_hash_table(Xtndbl1HashTable *table) {
 	int i;
 	for (i = table->size-1; i >= 0; i--) {
 		if (table->buckets[i]->id == i) {
-			free(table->buckets[i]);
+			memory_free(&table->stats.memory, table->buckets[i]);
 		}
 	}
 
 	// free the array of bucket pointers
-	free(table->buckets);
+	memory_free(&table->stats.memory, table->buckets);
 	
 	// free the table struct itself
-	free(table);
+	memory_free(&table->stats.memory, table);
+}
+
+
+// make room for 'nkeys' keys in total by doubling the table to the depth
+// they need and splitting every bucket down to that depth
+// returns false if the table would grow too large
+bool xtndbl1_hash_table_reserve(Xtndbl1HashTable *table, size_t nkeys) {
+	assert(table);
+
+	// enough buckets for the keys at the expected load
+	double needed = nkeys / RESERVE_LOAD_FACTOR;
+	int depth = 0;
+	while ((double)(1 << depth) < needed) {
+		if ((1 << depth) >= MAX_TABLE_SIZE / 2) {
+			return false;
+		}
+		depth++;
+	}
+
+	// FIRST, double the table; THEN split any bucket that is too shallow
+	while (table->depth < depth) {
+		double_table(table);
+	}
+	int i;
+	for (i = 0; i < table->size; i++) {
+		while (table->buckets[i]->depth < depth) {
+			split_bucket(table, i);
+		}
+	}
+	return true;
 }
 
 
@@ -220,8 +282,10 @@ bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key) {
 	}
 
 	// if not, make space in the table until our target bucket has space
+	int nsplits = 0;
 	while (table->buckets[address]->full) {
 		split_bucket(table, address);
+		nsplits++;
 
 		// and recalculate address because we might now need more bits
 		address = rightmostnbits(table->depth, hash);
@@ -231,6 +295,7 @@ bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key) {
 	table->buckets[address]->key = key;
 	table->buckets[address]->full = true;
 	table->stats.nkeys++;
+	histogram_add(&table->stats.splits, nsplits);
 
 	// add time elapsed to total CPU time before returning
 	table->stats.time += clock() - start_time;
@@ -255,7 +320,9 @@ bool xtndbl1_hash_table_lookup(Xtndbl1HashTable *table, int64 key) {
 	}
 
 	// add time elapsed to total CPU time before returning result
-	table->stats.time += clock() - start_time;
+	int elapsed = clock() - start_time;
+	table->stats.time += elapsed;
+	table->stats.lookup_time += elapsed;
 	return found;
 }
 
@@ -307,6 +374,58 @@ void xtndbl1_hash_table_stats(Xtndbl1HashTable *table) {
 	// also calculate CPU usage in seconds and print this
 	float seconds = table->stats.time * 1.0 / CLOCKS_PER_SEC;
 	printf("    CPU time spent: %.6f sec\n", seconds);
+
+	// and how much memory the table holds, in total and per key
+	Memory *memory = &table->stats.memory;
+	printf("      memory usage: %zu bytes (peak %zu bytes)\n",
+		memory->bytes, memory->peak);
+	printf("    memory per key: %.3f bytes\n", table->stats.nkeys
+		? (double)memory->bytes / table->stats.nkeys : 0);
 	
 	printf("--- end stats ---\n");
 }
+
+// fill 'stats' with the statistics this table tracks
+void xtndbl1_hash_table_get_stats(Xtndbl1HashTable *table,
+		HashTableStats *stats) {
+	int insert_time = table->stats.time - table->stats.lookup_time;
+
+	stats->size = table->size;
+	stats->nkeys = table->stats.nkeys;
+	stats->nbuckets = table->stats.nbuckets;
+	stats->bucketsize = 1;
+	stats->load_factor = (double)table->stats.nkeys / table->stats.nbuckets;
+
+	// the directory doubles once per bit of depth, and every bucket but the
+	// first was made by splitting another
+	stats->resizes = table->depth;
+	stats->splits = table->stats.nbuckets - 1;
+
+	stats->insert_time = 1000.0 * insert_time / CLOCKS_PER_SEC;
+	stats->lookup_time = 1000.0 * table->stats.lookup_time / CLOCKS_PER_SEC;
+	stats->memory = table->stats.memory.bytes;
+	stats->peak_memory = table->stats.memory.peak;
+	add_stats_histogram(stats, &table->stats.splits);
+}
+
+// copy the memory currently and at most held by 'table' into 'memory'
+void xtndbl1_hash_table_memory(Xtndbl1HashTable *table, Memory *memory) {
+	*memory = table->stats.memory;
+}
+
+// write the directory and buckets of 'table' to 'writer'
+void xtndbl1_hash_table_save(Xtndbl1HashTable *table, SnapshotWriter *writer) {
+	assert(table);
+	snapshot_begin_directory(writer, 1, table->depth, 1);
+
+	// write each bucket once, at its first reference
+	int i;
+	for (i = 0; i < table->size; i++) {
+		Bucket *bucket = table->buckets[i];
+		if (bucket->id == i) {
+			snapshot_write_bucket(writer, bucket->id, bucket->depth,
+				&bucket->key, bucket->full);
+		}
+	}
+	snapshot_end_directory(writer);
+}
@@ -11,6 +11,9 @@
 
 #include <stdbool.h>
 #include "../inthash.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+#include "../snapshot.h"
 
 typedef struct xtndbl1_table Xtndbl1HashTable;
 
@@ -24,6 +27,10 @@ void free_xtndbl1_hash_table(Xtndbl1HashTable *table);
 // returns true if insertion succeeds, false if it was already in there
 bool xtndbl1_hash_table_insert(Xtndbl1HashTable *table, int64 key);
 
+// make room for 'nkeys' keys in total by growing the table and splitting
+// buckets up front. returns false if the table would grow too large
+bool xtndbl1_hash_table_reserve(Xtndbl1HashTable *table, size_t nkeys);
+
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool xtndbl1_hash_table_lookup(Xtndbl1HashTable *table, int64 key);
@@ -34,4 +41,14 @@ void xtndbl1_hash_table_print(Xtndbl1HashTable *table);
 // print some statistics about 'table' to stdout
 void xtndbl1_hash_table_stats(Xtndbl1HashTable *table);
 
+// fill 'stats' with the statistics this table tracks
+void xtndbl1_hash_table_get_stats(Xtndbl1HashTable *table,
+	HashTableStats *stats);
+
+// write the directory and buckets of 'table' to 'writer'
+void xtndbl1_hash_table_save(Xtndbl1HashTable *table, SnapshotWriter *writer);
+
+// copy the memory currently and at most held by 'table' into 'memory'
+void xtndbl1_hash_table_memory(Xtndbl1HashTable *table, Memory *memory);
+
 #endif
@@ -17,10 +17,9 @@
 #include <time.h>
 
 #include "xtndbln.h"
-
-/* Number of stats there are to print */
-#define NSTATS 5
-#define HEADER_MAX_STR_LENGTH 100
+#include "../memacct.h"
+#include "../tblstats.h"
+#include "../trace.h"
 
 /* Function like macro for getting trailing nbit integer */
 #define get_bit_trail(x, n) (x) & ((1<<n) - 1)
@@ -31,6 +30,10 @@
  * domain is defined as the domain for which the function range is positive) */
 #define pow2(x) (1<<x)
 
+/* Average bucket occupancy xtndbln_hash_table_reserve sizes for. Extendible
+ * hashing settles at around ln(2) full under random keys */
+#define RESERVE_LOAD_FACTOR 0.69
+
 // a bucket stores an array of keys
 // it also knows how many bits are shared between possible keys, and the first 
 // table address that references it
@@ -40,6 +43,9 @@ typedef struct xtndbln_bucket {
 	int depth;		// how many hash value bits are being used by this bucket
 	int nkeys;		// number of keys currently contained in this bucket
 	int64 *keys;	// the keys stored in this bucket
+	unsigned char *values;	// in map mode, the value of each key, or NULL
+	struct xtndbln_bucket *overflow;	// linear hashing: the next bucket of
+										// this bucket's chain, or NULL
 } Bucket;
 
 // a hash table is an array of slots pointing to buckets holding up to 
@@ -50,50 +56,73 @@ struct xtndbln_table {
 	int size;			// how many entries in the table of pointers (2^depth)
 	int depth;			// how many bits of the hash value to use (log2(size))
 	int bucketsize;		// maximum number of keys per bucket
+	int valuesize;		// bytes of value stored with each key (0: no values)
+	PagePolicy pages;	// how the array of pointers is backed
 
     int nitems;
+    int nbuckets;             // Number of distinct buckets
+    Histogram splits;         // How many buckets each insert had to split
     double accum_insert_time;
     long double accum_lookup_time;
     int (*hash)(int64 key);   // Pointer to hash function this table uses
+    Memory memory;            // Heap memory held by the table
 };
 
-static Bucket *get_new_bucket(int id, int bucketsize, int depth); 
-static void free_bucket(Bucket* bucket);
-static void write_to_bucket(Bucket *bucket, int64 key);
+static Bucket *get_new_bucket(Memory *memory, int id, int bucketsize,
+        int depth, int valuesize); 
+static void free_bucket(Memory *memory, Bucket* bucket);
+static void write_to_bucket(Bucket *bucket, int64 key, const void *value,
+        int valuesize);
 static int64 swap_bucket_key(Bucket *bucket, int64 key, int index);
 static bool split_bucket(XtndblNHashTable *table, int address);
 static bool double_table(XtndblNHashTable *table);
-static void reinsert_key(XtndblNHashTable *table, int64 key);
+static void reinsert_key(XtndblNHashTable *table, int64 key,
+        const void *value);
+static int locate_key(XtndblNHashTable *table, int64 key, Bucket **bucket);
 
-static Bucket *get_new_bucket(int id, int bucketsize, int depth) {
+static Bucket *get_new_bucket(Memory *memory, int id, int bucketsize,
+        int depth, int valuesize) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
      * DESC: Initializes a new bucket structure
      *
-     * INPT: int bucketsize
+     * INPT: Memory *memory
+     *          Accounting of the table the bucket belongs to
+     *
+     *       int bucketsize
      *          How many keys the bucket can hold
      *
+     *       int valuesize
+     *          Bytes of value stored with each key, 0 for no values
+     *
      * OTPT: Bucket*
      *          A pointer to the newly initialized bucket
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
     /* Allocate memory for bucket structure */
-    Bucket *bucket = malloc(sizeof(*bucket));
+    Bucket *bucket = memory_malloc(memory, sizeof(*bucket));
     assert(bucket);
 
     /* Allocate memory for bucket keys */
-    bucket->keys = malloc(sizeof(*bucket->keys)*bucketsize);
+    bucket->keys = memory_malloc(memory, sizeof(*bucket->keys)*bucketsize);
     assert(bucket->keys);
+    bucket->values = NULL;
+    if (valuesize) {
+        bucket->values = memory_malloc(memory, (size_t)valuesize*bucketsize);
+        assert(bucket->values);
+    }
     bucket->depth = depth;
     bucket->id = id;
     bucket->nkeys = 0;
+    bucket->overflow = NULL;
     return(bucket);
 }
 
 // Free all memory associated with a bucket structure 
-static void free_bucket(Bucket *bucket) {
-    free(bucket->keys);
-    free(bucket);
+static void free_bucket(Memory *memory, Bucket *bucket) {
+    memory_free(memory, bucket->keys);
+    memory_free(memory, bucket->values);
+    memory_free(memory, bucket);
 }
 
 static int64 swap_bucket_key(Bucket *bucket, int64 key, int index) {
@@ -119,9 +148,37 @@ static int64 swap_bucket_key(Bucket *bucket, int64 key, int index) {
     return(swapped_key);
 }
 
-static void write_to_bucket(Bucket *bucket, int64 key) {
+static int locate_key(XtndblNHashTable *table, int64 key, Bucket **bucket) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Find the slot holding key in the bucket to which it hashes
+     *
+     * INPT: XtndblNHashTable *table
+     *          Pointer to table structure in which to search
+     *
+     *       int64 key
+     *          Key for which to search
+     *
+     * OTPT: int
+     *          Zero based index of the key in *bucket, or -1 if absent
+     *
+     *       Bucket **bucket
+     *          Set to the bucket to which the key hashes
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    int ix;
+    *bucket = table->buckets[get_bit_trail(table->hash(key), table->depth)];
+    for (ix=0; ix<(*bucket)->nkeys; ix++) {
+        if ((*bucket)->keys[ix] == key) {
+            return(ix);
+        }
+    }
+    return(-1);
+}
+
+static void write_to_bucket(Bucket *bucket, int64 key, const void *value,
+        int valuesize) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
-     * DESC: Write key into bucket.
+     * DESC: Write key (and its value) into bucket.
      *
      * INPT: Bucket *bucket
      *          The address of the bucket inwhich the key will be  inserted. 
@@ -129,15 +186,28 @@ static void write_to_bucket(Bucket *bucket, int64 key) {
      * OTPT: key
      *          The key which will be inserted into the magic bucket. 
      *
+     *       const void *value, int valuesize
+     *          The value to store with the key (zeros if NULL), and its size.
+     *          May be the value of a later key in the same bucket.
+     *
      * NOTE: Assumes the bucket has space for the key. If not, behaviour
      *       undefined. 
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    if (valuesize) {
+        unsigned char *to = bucket->values + (size_t)bucket->nkeys*valuesize;
+        if (value) {
+            memmove(to, value, valuesize);
+        } else {
+            memset(to, 0, valuesize);
+        }
+    }
     bucket->keys[bucket->nkeys++] = key;
 }
 
 /* Writes key into table under assumption that the table has space */
-static void reinsert_key(XtndblNHashTable *table, int64 key) {
+static void reinsert_key(XtndblNHashTable *table, int64 key,
+        const void *value) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
      * DESC: Re-insert key into table.
      *
@@ -148,18 +218,21 @@ static void reinsert_key(XtndblNHashTable *table, int64 key) {
      *       int64 key
      *          The key which is to be inserted
      *
+     *       const void *value
+     *          The key's value, if the table is a map
+     *
      * NOTE: Assumes the table has space for the key. If not behaviour is
      *       undefined. 
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
     int index = get_bit_trail(table->hash(key), table->depth);
     Bucket *bucket =table->buckets[index];
-    write_to_bucket(bucket, key);
+    write_to_bucket(bucket, key, value, table->valuesize);
 }
     
 static bool split_bucket(XtndblNHashTable *table, int bucket_index) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
-     * DESC: Takes a bucket that is full and splits it. Will grow the hash table
+     * DESC: Takes a bucket (usually full) and splits it. Will grow the hash table
      *       if necessary. Updates the hash table pointers where appropriate. 
      *       After growing the table and splitting the bucket will re-hash the 
      *       contents of the bucket to ensure they are in the correct location.
@@ -176,6 +249,8 @@ static bool split_bucket(XtndblNHashTable *table, int bucket_index) {
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
     
+    uint64_t start = trace_clock();
+
     /* Double the table if there are no further available pointers */
     if(table->buckets[bucket_index]->depth == table->depth) {
         /* Double the table. Return false if the operation fails. */
@@ -193,8 +268,10 @@ static bool split_bucket(XtndblNHashTable *table, int bucket_index) {
     assert(depth == old_bucket->depth);
 
     /* Create the new bucket */
-    Bucket *new_bucket = get_new_bucket(id, table->bucketsize, depth);
+    Bucket *new_bucket = get_new_bucket(&table->memory, id, table->bucketsize,
+            depth, table->valuesize);
     if (!new_bucket) { return(false); }
+    table->nbuckets++;
 
 
     /* Calculate the number of unused bits in the table for newly split bucket*/
@@ -213,13 +290,19 @@ static bool split_bucket(XtndblNHashTable *table, int bucket_index) {
         table->buckets[(id|prefix)] = new_bucket;
     }
 
-    /* Relocate the keys in the full bucket as appropriate. */
+    /* Relocate the keys in the old bucket as appropriate. */
     /* Overwrite keys as we go. Keys retrieved before overwriting */
+    int nkeys = old_bucket->nkeys;
     old_bucket->nkeys = 0;
-    for(ix=0; ix<table->bucketsize; ix++) {
-        reinsert_key(table, old_bucket->keys[ix]);
+    for(ix=0; ix<nkeys; ix++) {
+        reinsert_key(table, old_bucket->keys[ix], (old_bucket->values)
+                ? old_bucket->values + (size_t)ix*table->valuesize : NULL);
     }
 
+    /* Keys that moved are the ones now in the new bucket */
+    trace_record(TRACE_XTNDBLN_SPLIT, start, table->nbuckets-1,
+            table->nbuckets, new_bucket->nkeys);
+
     return(true);
 }
 
@@ -236,13 +319,16 @@ static bool double_table(XtndblNHashTable *table) {
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
+    uint64_t start = trace_clock();
+
     /* Operation fails if expanding table over max table size.*/
     if ((table->size*2) > MAX_TABLE_SIZE) {
         return(false);}
 
     /* realloc buckets. double size. Increase depth. copy first half to second*/
-    table->buckets = realloc(table->buckets, 
-                             (sizeof(*table->buckets))*2*(table->size));
+    table->buckets = memory_realloc_pages(&table->memory, table->buckets,
+                             (sizeof(*table->buckets))*2*(table->size),
+                             table->pages);
 
     /* Doubling operation fails if cannot get memory */
     if (table->buckets == NULL) {
@@ -256,6 +342,9 @@ static bool double_table(XtndblNHashTable *table) {
 
     table->size*=2;
     table->depth++;
+
+    /* Only pointers are copied, no keys move */
+    trace_record(TRACE_XTNDBLN_DOUBLE, start, table->size/2, table->size, 0);
     return(true);
 }
 
@@ -263,7 +352,8 @@ static bool double_table(XtndblNHashTable *table) {
 int get_xtndbln_table_size(XtndblNHashTable *table) {return(table->size);}
 
 XtndblNHashTable 
-*new_xtndbln_specified_hash_table(int bucketsize, int (*hash)(int64 key)) {
+*new_xtndbln_specified_hash_table(int bucketsize, int valuesize,
+        int (*hash)(int64 key)) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
      * DESC: More general extendable hash table initialization wrapper that
      *       initializes an extendable hash table with a specified hash function
@@ -271,6 +361,9 @@ XtndblNHashTable
      * INPT: int bucketsize
      *          How many keys each bucket of the table can store 
      *
+     *       int valuesize
+     *          Bytes of value stored with each key, 0 for no values
+     *
      *       int *hash(int64 key)
      *          Function pointer to the hash function this table is to
      *          use. 
@@ -279,7 +372,7 @@ XtndblNHashTable
      *          A pointer to the newly initialized hash table
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-    XtndblNHashTable *table = new_xtndbln_hash_table(bucketsize);
+    XtndblNHashTable *table = new_xtndbln_hash_map(bucketsize, valuesize);
 
     /* Set the hash function as per argument */
     table->hash = hash;
@@ -288,25 +381,41 @@ XtndblNHashTable
 
 // initialise an extendible hash table with 'bucketsize' keys per bucket
 XtndblNHashTable *new_xtndbln_hash_table(int bucketsize) {
+    return new_xtndbln_hash_map(bucketsize, 0);
+}
+
+// initialise an extendible hash table with 'bucketsize' keys per bucket,
+// storing 'valuesize' bytes of value with each key
+XtndblNHashTable *new_xtndbln_hash_map(int bucketsize, int valuesize) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
      * DESC: Initializes a new extendable hash table structure
      *
      * INPT: int bucketsize
      *          How many elements each bucket can store
      *
+     *       int valuesize
+     *          Bytes of value stored with each key, 0 for no values
+     *
      * OTPT: XtndblNHashTable*
      *          A pointer to the newly initialized table
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
     
     /* Allocate memory for table */
-    XtndblNHashTable *table = malloc(sizeof(*table));
+    Memory memory;
+    memory_init(&memory);
+    XtndblNHashTable *table = memory_malloc(&memory, sizeof(*table));
     assert(table);
+    table->memory = memory;
 
     table->bucketsize = bucketsize;
+    table->valuesize = valuesize;
+    table->pages = PAGES_DEFAULT;
     table->depth=0;
     table->size=1;
     table->nitems=0;
+    table->nbuckets=1;
+    init_histogram(&table->splits, "splits per insert", 1);
     table->accum_lookup_time=0;
     table->accum_insert_time=0;
 
@@ -314,11 +423,14 @@ XtndblNHashTable *new_xtndbln_hash_table(int bucketsize) {
     table->hash=h1;
 
     /* Allocate memory for bucket pointers */
-    table->buckets = malloc(sizeof(*table->buckets)*table->size);
+    table->buckets = memory_alloc_pages(&table->memory,
+                                   sizeof(*table->buckets)*table->size,
+                                   table->pages);
     assert(table->buckets);
 
     /* Init bucket */
-    table->buckets[0] = get_new_bucket(0, bucketsize, 0);
+    table->buckets[0] = get_new_bucket(&table->memory, 0, bucketsize, 0,
+            valuesize);
 
 	return(table);
 }
@@ -348,11 +460,89 @@ void free_xtndbln_hash_table(XtndblNHashTable *table) {
                 prefix = (jx << bucket->depth);
                 table->buckets[(ix | prefix)]=NULL;
             }
-            free_bucket(bucket);
+            free_bucket(&table->memory, bucket);
         }
     }
-    free(table->buckets);
-    free(table);
+    memory_free_pages(&table->memory, table->buckets);
+    memory_free(&table->memory, table);
+}
+
+bool xtndbln_hash_table_reserve(XtndblNHashTable *table, size_t nkeys) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Grows the table up front to hold 'nkeys' keys, by doubling the
+     *       directory to the depth those keys need and splitting every
+     *       bucket down to that depth, so inserting them rarely splits.
+     *
+     * INPT: XtndblNHashTable *table
+     *          The table to make room in
+     *
+     *       size_t nkeys
+     *          Number of keys expected in the table in total
+     *
+     * OTPT: bool
+     *          False if the directory would grow too large, otherwise true.
+     *
+     * NOTE: Sizes for an average occupancy of RESERVE_LOAD_FACTOR. Buckets
+     *       that hash values crowd into can still split later. Buckets
+     *       already deeper than the expected depth are left as they are.
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+    /* Find the depth at which there are enough buckets */
+    double needed = nkeys / (table->bucketsize * RESERVE_LOAD_FACTOR);
+    int ix, depth = 0;
+    while ((double)pow2(depth) < needed) {
+        if (pow2(depth) >= MAX_TABLE_SIZE) {return(false);}
+        depth++;
+    }
+
+    /* Pre-double the directory, then split every shallower bucket */
+    while (table->depth < depth) {
+        if (!double_table(table)) {return(false);}
+    }
+    for (ix=0; ix<table->size; ix++) {
+        while (table->buckets[ix]->depth < depth) {
+            if (!split_bucket(table, ix)) {return(false);}
+        }
+    }
+    return(true);
+}
+
+// back the array of bucket pointers as 'policy' asks
+void xtndbln_hash_table_set_pages(XtndblNHashTable *table, PagePolicy policy) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Moves the directory to memory backed as 'policy' asks, and keeps
+     *       to that policy as it doubles. Every lookup reads the directory
+     *       at a random index, so in a large table it is where the TLB
+     *       misses are. Buckets are allocated one by one and stay as they
+     *       are.
+     *
+     * INPT: XtndblNHashTable *table
+     *          The table whose directory is moved
+     *
+     *       PagePolicy policy
+     *          How to back it (see memacct.h)
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    table->pages = policy;
+    table->buckets = memory_realloc_pages(&table->memory, table->buckets,
+            sizeof(*table->buckets)*table->size, policy);
+    assert(table->buckets);
+}
+
+// the number of keys in the bucket 'key' hashes to
+int xtndbln_hash_table_bucket_load(XtndblNHashTable *table, int64 key) {
+    int index = get_bit_trail(table->hash(key), table->depth);
+    return(table->buckets[index]->nkeys);
+}
+
+// the 'index'th key of the bucket 'key' hashes to
+int64 xtndbln_hash_table_bucket_key(XtndblNHashTable *table, int64 key,
+        int index) {
+    Bucket *bucket = table->buckets[get_bit_trail(table->hash(key),
+            table->depth)];
+    assert(index>=0 && index<bucket->nkeys);
+    return(bucket->keys[index]);
 }
 
 bool xtndbln_hash_table_has_space(XtndblNHashTable *table, int64 key) {
@@ -372,8 +562,13 @@ bool xtndbln_hash_table_has_space(XtndblNHashTable *table, int64 key) {
 }
 
 bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key) {
+    return xtndbln_hash_table_put(table, key, NULL, false);
+}
+
+bool xtndbln_hash_table_put(XtndblNHashTable *table, int64 key,
+        const void *value, bool replace) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
-     * DESC: Inserts a key into a given extendable hash table 
+     * DESC: Inserts a key (and its value) into a given extendable hash table 
      *
      * INPT: XtndblNHashTable *table
      *          A pointer to the table structure in which the key is to be
@@ -382,9 +577,17 @@ bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key) {
      *       int64 key
      *          Key which is to be inserted.
      *
+     *       const void *value
+     *          In map mode, the value to store with the key (zeros if NULL).
+     *          Ignored otherwise.
+     *
+     *       bool replace
+     *          If the key is already in the table, overwrite its value
+     *
      * OTPT: bool
      *          True if the insertion was sucessful, false if the given key was
-     *          already in the table.
+     *          already in the table, or its bucket could not be split without
+     *          the directory growing past MAX_TABLE_SIZE.
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
@@ -395,11 +598,22 @@ bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key) {
     int start_time = clock();
 
     /* Check to see if the key is already contained in the table */
-    if (xtndbln_hash_table_lookup(table, key)) {return false;}
+    Bucket *bucket;
+    int found = locate_key(table, key, &bucket);
+    if (found >= 0) {
+        if (replace && table->valuesize) {
+            unsigned char *to = bucket->values + (size_t)found*table->valuesize;
+            if (value) {
+                memcpy(to, value, table->valuesize);
+            } else {
+                memset(to, 0, table->valuesize);
+            }
+        }
+        return false;
+    }
 
     /* Store the hash to reduce overhead */
     int key_hash = table->hash(key);
-    Bucket *bucket;
 
     /* Helper. Checks if a bucket is full or not. return true if full */
     bool bucket_full(Bucket *bucket) {
@@ -417,32 +631,48 @@ bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key) {
      * Note that even after a split everything might rehash to the same bucket,
      * and thus a while loop is used to split however many times required to 
      * make space. */
+    int nsplits = 0;
     while (bucket_full(bucket = update_bucket())) {
 
-        /* Split bucket at address where the key belongs for the current table*/
-        split_bucket(table, get_bit_trail(key_hash, table->depth));
+        /* Split bucket at address where the key belongs for the current table.
+         * Give up if the directory cannot double any further */
+        if (!split_bucket(table, get_bit_trail(key_hash, table->depth))) {
+            table->accum_lookup_time = original_accum_lookup_time;
+            return(false);
+        }
+        nsplits++;
     }
 
     /* Put the key in the bucket (At present it is invariant the bucket has
      * space, meeting write_to_bucket()'s condition of invocation)*/
-    write_to_bucket(bucket, key);
+    write_to_bucket(bucket, key, value, table->valuesize);
 
     /* Lookup time counted for insertion, so dont change it */
     table->accum_lookup_time = original_accum_lookup_time;
 
     /* Increment keycount for table */
     table->nitems++;
+    histogram_add(&table->splits, nsplits);
 
     table->accum_insert_time += (clock()-start_time);
 
     return(true);
 }
 
-int64 xtndbln_hash_table_rand_swap(XtndblNHashTable *table, int64 key) {
+int64 xtndbln_hash_table_rand_swap(XtndblNHashTable *table, int64 key,
+        void *value) {
+    /* Swap-out key with one in the bucket at random */
+    int nkeys = xtndbln_hash_table_bucket_load(table, key);
+    assert(nkeys>0);
+    return(xtndbln_hash_table_swap(table, key, value, rand()%nkeys));
+}
+
+int64 xtndbln_hash_table_swap(XtndblNHashTable *table, int64 key,
+        void *value, int index) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
-     * DESC: Swap a key with a another at random from the bucket to which it
+     * DESC: Swap a key with the 'index'th key of the bucket to which it
      *       hashes. Return the key swapped out. Assumes the bucket to which the
-     *       key hashes is not empty.
+     *       key hashes holds more than 'index' keys.
      *
      * INPT: XtndblNHashTable *table
      *          Pointer to the table swap insert. 
@@ -450,24 +680,41 @@ int64 xtndbln_hash_table_rand_swap(XtndblNHashTable *table, int64 key) {
      *       int64 key
      *          Key which to insert
      *
+     *       void *value
+     *          In map mode, the value of the key to insert, which is
+     *          replaced by the value of the key swapped out. May be NULL
+     *          otherwise.
+     *
+     *       int index
+     *          Which key of the bucket to swap out
+     *
      * OTPT: int64
      *          The key which was swapped out. 
      *
-     * NOTE: Asserts that there is a key in the bucket.
+     * NOTE: Asserts that the bucket holds such a key.
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-    int swapkey_bucket_index, key_hash = table->hash(key);
+    int swapkey_bucket_index = index, key_hash = table->hash(key);
 
     /* Get bucket into which the key will be swapped*/
     int bucket_index = get_bit_trail(key_hash, table->depth);
     Bucket *bucket = table->buckets[bucket_index];
 
-    /* There must be at least one key in the bucket to swap*/
-    assert(bucket->nkeys>0);
+    /* There must be a key at 'index' in the bucket to swap*/
+    assert(index>=0 && index<bucket->nkeys);
 
-    /* Swap-out key with one in the bucket at random and return swapped key */
-    swapkey_bucket_index = rand()%(bucket->nkeys);
+    /* Swap-out key with the one at 'index' and return swapped key */
     int64 swapped_key = swap_bucket_key(bucket, key, swapkey_bucket_index);
+
+    /* Swap the values over with the keys */
+    if (table->valuesize && value) {
+        unsigned char held[table->valuesize];
+        unsigned char *slot = bucket->values
+            + (size_t)swapkey_bucket_index*table->valuesize;
+        memcpy(held, slot, table->valuesize);
+        memcpy(slot, value, table->valuesize);
+        memcpy(value, held, table->valuesize);
+    }
     return(swapped_key);
 }
 
@@ -494,20 +741,10 @@ bool xtndbln_hash_table_lookup(XtndblNHashTable *table, int64 key) {
     /* Start timer */
     int start_time = clock();
 
-    /* Find the address of the singular bucket which can contain this key. */
-    int address = get_bit_trail(table->hash(key), table->depth);
-    int ix=0;
-
-    /* Get the bucket address which this key hashed to */
-    Bucket *bucket = table->buckets[address];
-    
-    /* Search for the key inside the bucket */
-    while (ix<bucket->nkeys) {
-
-        /* Return true if key has been found */
-        if (bucket->keys[ix++] == key) {
-            return(true);
-        }
+    /* Search the singular bucket which can contain this key. */
+    Bucket *bucket;
+    if (locate_key(table, key, &bucket) >= 0) {
+        return(true);
     }
 
     /* Add lookup time */
@@ -517,6 +754,35 @@ bool xtndbln_hash_table_lookup(XtndblNHashTable *table, int64 key) {
 	return false;
 }
 
+bool xtndbln_hash_table_get(XtndblNHashTable *table, int64 key, void *value) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Checks for key inside hash table, and copies out its value
+     *
+     * INPT: XtndblNHashTable *table
+     *          Pointer to table structure in which to search
+     *
+     *       int64 key
+     *          Key for which to search
+     *
+     * OTPT: void *value
+     *          In map mode, receives the value of the key if it is found
+     *
+     *       bool
+     *          True to indicate the key is present in the table, false
+     *          otherwise.
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    int start_time = clock();
+    Bucket *bucket;
+    int ix = locate_key(table, key, &bucket);
+    if (ix >= 0 && table->valuesize && value) {
+        memcpy(value, bucket->values + (size_t)ix*table->valuesize,
+                table->valuesize);
+    }
+    table->accum_lookup_time += (clock()-start_time);
+    return(ix >= 0);
+}
+
 // print the contents of 'table' to stdout
 void xtndbln_hash_table_print(XtndblNHashTable *table) {
 	assert(table);
@@ -617,86 +883,429 @@ void xtndbln_hash_table_print_sparse(XtndblNHashTable *table) {
     }
 }
 
-// print some statistics about 'table' to stdout
-void xtndbln_hash_table_stats(XtndblNHashTable *table) {
-	fprintf(stderr, "Please see the print csv data functions.\n");
-    fprintf(stderr, "Press h for additional csv stat print commands\n");
-    return;
+// fill 'stats' with the statistics this table tracks
+void xtndbln_hash_table_get_stats(XtndblNHashTable *table,
+                                  HashTableStats *stats) {
+    stats->size = table->size;
+    stats->nkeys = table->nitems;
+    stats->nbuckets = table->nbuckets;
+    stats->bucketsize = table->bucketsize;
+    stats->load_factor = 
+        (double)table->nitems/(table->nbuckets*table->bucketsize);
+
+    /* The directory doubles once per bit of depth, and every bucket but the
+     * first was made by splitting another */
+    stats->resizes = table->depth;
+    stats->splits = table->nbuckets - 1;
+
+    stats->insert_time = 1000*table->accum_insert_time/CLOCKS_PER_SEC;
+    stats->lookup_time = 1000*table->accum_lookup_time/CLOCKS_PER_SEC;
+    stats->memory = table->memory.bytes;
+    stats->peak_memory = table->memory.peak;
+    add_stats_histogram(stats, &table->splits);
+}
+
+// copy the memory currently and at most held by 'table' into 'memory'
+void xtndbln_hash_table_memory(XtndblNHashTable *table, Memory *memory) {
+    *memory = table->memory;
+}
+
+// write the directory and buckets of 'table' to 'writer'
+void xtndbln_hash_table_save(XtndblNHashTable *table, SnapshotWriter *writer) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Writes the table as a directory section, addressed with the hash
+     *       function the table uses (h1 unless specified otherwise)
+     *
+     * INPT: XtndblNHashTable *table
+     *          The table to save
+     *
+     *       SnapshotWriter *writer
+     *          The snapshot being written
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    int ix;
+    Bucket *bucket;
+
+    snapshot_begin_directory(writer, hash_number(table->hash),
+            table->depth, table->bucketsize);
+
+    /* Write each bucket once, at the first address that references it */
+    for (ix=0; ix<table->size; ix++) {
+        bucket = table->buckets[ix];
+        if (bucket->id == ix) {
+            snapshot_write_bucket(writer, bucket->id, bucket->depth,
+                    bucket->keys, bucket->nkeys);
+        }
+    }
+    snapshot_end_directory(writer);
+}
+
+/* * * *
+ * linear hashing (Litwin): the same buckets, split in a fixed round robin
+ * order instead of when full, so no directory is needed
+ */
+
+struct linhash_table {
+    Bucket **segments[LINHASH_MAX_SEGMENTS];    // segment 0 holds bucket 0,
+                                // segment k > 0 buckets [2^(k-1), 2^k)
+    int nsegments;      // segments allocated so far
+    int level;          // buckets [0, 2^level) were there at the round start
+    int split;          // the next bucket to split in this round
+    int nbuckets;       // buckets in the table (2^level + split)
+    int noverflow;      // overflow buckets chained on to them
+    int bucketsize;     // maximum number of keys per bucket
+    int valuesize;      // bytes of value stored with each key (0: no values)
+    int nitems;
+    Histogram chains;   // buckets of its chain each lookup (or insert) read
+    Memory memory;      // heap memory held by the table
+};
+
+/* The segment holding bucket 'address', and the bucket's place within it */
+static int linhash_segment(int address) {
+    return address ? 32 - __builtin_clz((unsigned)address) : 0;
+}
+static int linhash_offset(int address, int segment) {
+    return segment ? address - pow2((segment - 1)) : address;
 }
 
-// Returns csv stat header 
-static char** get_stat_header() {
-    int ix, n_columns = NSTATS;
-    char** header= malloc(sizeof(char*)*n_columns);
+static Bucket **linhash_slot(LinhashHashTable *table, int address) {
+    int segment = linhash_segment(address);
+    return &table->segments[segment][linhash_offset(address, segment)];
+}
 
-    /* Allocate memory for header strings */
-    for (ix=0; ix<n_columns; ix++) {
-        header[ix]=malloc(sizeof(char)*HEADER_MAX_STR_LENGTH);
+static int linhash_address(LinhashHashTable *table, int64 key) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: The bucket a key belongs in: the last 'level' bits of its hash,
+     *       or one bit more if that bucket has been split this round
+     *
+     * INPT: LinhashHashTable *table
+     *          The table the key is in (or to go in)
+     *
+     *       int64 key
+     *          The key
+     *
+     * OTPT: int
+     *          Address of the first bucket of the key's chain
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    int hash = h1(key);
+    int address = get_bit_trail(hash, table->level);
+    if (address < table->split) {
+        address = get_bit_trail(hash, (table->level + 1));
     }
+    return(address);
+}
 
-    strcpy(header[0],"bucket count [buckets]");
-    strcpy(header[1],"bucket size [slots]");
-    strcpy(header[2],"key count [keys]");
-    strcpy(header[3],"lookup time [ms]");
-    strcpy(header[4],"insert time [ms]");
+/* Put a key (and its value) at the end of the chain starting at 'bucket',
+ * chaining on an overflow bucket if the last one is full */
+static void linhash_append(LinhashHashTable *table, Bucket *bucket,
+        int64 key, const void *value) {
+    while (bucket->nkeys == table->bucketsize) {
+        if (!bucket->overflow) {
+            bucket->overflow = get_new_bucket(&table->memory, bucket->id,
+                    table->bucketsize, bucket->depth, table->valuesize);
+            table->noverflow++;
+        }
+        bucket = bucket->overflow;
+    }
+    write_to_bucket(bucket, key, value, table->valuesize);
+}
+
+static void linhash_split(LinhashHashTable *table) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Splits the bucket at the split pointer (full or not) into itself
+     *       and a new bucket 2^level further on, moving the keys of its
+     *       chain whose next hash bit is set, then advances the pointer.
+     *       Once every bucket of the round has split, the level goes up.
+     *
+     * INPT: LinhashHashTable *table
+     *          The table to grow by one bucket
+     *
+     * NOTE: Only this chain is touched. When the new bucket starts a new
+     *       segment, that segment's pointer array is allocated, but nothing
+     *       is copied into it.
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    uint64_t start = trace_clock();
+    int id = table->split + pow2(table->level);
+    int segment = linhash_segment(id);
+    assert(id < MAX_TABLE_SIZE && "error: table has grown too large!");
+
+    /* The first bucket of a segment brings the segment with it */
+    if (segment == table->nsegments) {
+        table->segments[segment] = memory_malloc(&table->memory,
+                sizeof(Bucket *) * (segment ? pow2((segment - 1)) : 1));
+        assert(table->segments[segment]);
+        table->nsegments++;
+    }
 
-    return(header);
+    Bucket *old_bucket = *linhash_slot(table, table->split);
+    Bucket *new_bucket = get_new_bucket(&table->memory, id, table->bucketsize,
+            table->level + 1, table->valuesize);
+    *linhash_slot(table, id) = new_bucket;
+    old_bucket->depth++;
+
+    /* Keys that stay are packed back into the front of the chain as it is
+     * read. The write position never passes the read position, so keys and
+     * values are retrieved before being overwritten */
+    Bucket *bucket, *to = old_bucket;
+    int ix, nkeys, moved = 0;
+    for (bucket = old_bucket; bucket; bucket = bucket->overflow) {
+        nkeys = bucket->nkeys;
+        bucket->nkeys = 0;
+        for (ix=0; ix<nkeys; ix++) {
+            int64 key = bucket->keys[ix];
+            const void *value = (bucket->values)
+                ? bucket->values + (size_t)ix*table->valuesize : NULL;
+            if ((get_bit_trail(h1(key), (table->level + 1))) == id) {
+                linhash_append(table, new_bucket, key, value);
+                moved++;
+            } else {
+                if (to->nkeys == table->bucketsize) {
+                    to = to->overflow;
+                }
+                write_to_bucket(to, key, value, table->valuesize);
+            }
+        }
+    }
+
+    /* Free the overflow buckets the chain no longer needs */
+    bucket = to->overflow;
+    to->overflow = NULL;
+    while (bucket) {
+        Bucket *next = bucket->overflow;
+        free_bucket(&table->memory, bucket);
+        table->noverflow--;
+        bucket = next;
+    }
+
+    /* Advance the split pointer, starting a new round after the last */
+    table->nbuckets++;
+    if (++table->split == pow2(table->level)) {
+        table->level++;
+        table->split = 0;
+    }
+
+    trace_record(TRACE_LINHASH_SPLIT, start, table->nbuckets-1,
+            table->nbuckets, moved);
+}
+
+LinhashHashTable *new_linhash_hash_table(int bucketsize) {
+    return new_linhash_hash_map(bucketsize, 0);
 }
 
-// Print csv stat header to stdout
-static void print_stat_header(char** header) {
-    int ix, n_columns=NSTATS;
-    char seperator=',';
-    for (ix=0; ix<n_columns; ix++) {
-        printf("%s", header[ix]);
-        if (ix!=(n_columns-1)) {
-            printf("%c", seperator);
+LinhashHashTable *new_linhash_hash_map(int bucketsize, int valuesize) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Initializes a new linear hashing table of one empty bucket
+     *
+     * INPT: int bucketsize
+     *          How many keys each bucket (and overflow bucket) can store
+     *
+     *       int valuesize
+     *          Bytes of value stored with each key, 0 for no values
+     *
+     * OTPT: LinhashHashTable*
+     *          A pointer to the newly initialized table
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    Memory memory;
+    memory_init(&memory);
+    LinhashHashTable *table = memory_malloc(&memory, sizeof(*table));
+    assert(table);
+    table->memory = memory;
+
+    table->bucketsize = bucketsize;
+    table->valuesize = valuesize;
+    table->level = 0;
+    table->split = 0;
+    table->nbuckets = 1;
+    table->noverflow = 0;
+    table->nitems = 0;
+    init_histogram(&table->chains, "chain buckets read", 1);
+
+    table->segments[0] = memory_malloc(&table->memory, sizeof(Bucket *));
+    assert(table->segments[0]);
+    table->segments[0][0] = get_new_bucket(&table->memory, 0, bucketsize, 0,
+            valuesize);
+    table->nsegments = 1;
+    return(table);
+}
+
+void free_linhash_hash_table(LinhashHashTable *table) {
+    int ix;
+    for (ix=0; ix<table->nbuckets; ix++) {
+        Bucket *bucket = *linhash_slot(table, ix);
+        while (bucket) {
+            Bucket *next = bucket->overflow;
+            free_bucket(&table->memory, bucket);
+            bucket = next;
         }
     }
-    printf("\n");
+    for (ix=0; ix<table->nsegments; ix++) {
+        memory_free(&table->memory, table->segments[ix]);
+    }
+    memory_free(&table->memory, table);
 }
 
-// Get a csv row of statistics for the table 
-static double* get_stat_row(XtndblNHashTable *table) {
-    int n_columns = NSTATS;
-    double* statrow = malloc(sizeof(double) * n_columns);
+/* Find the bucket of the table holding 'key' and its index in there, or -1
+ * (and the last bucket of its chain) if it is not in the table */
+static int linhash_locate(LinhashHashTable *table, int64 key,
+        Bucket **bucket) {
+    int ix, nchained = 0;
+    *bucket = *linhash_slot(table, linhash_address(table, key));
+    while (true) {
+        nchained++;
+        for (ix=0; ix<(*bucket)->nkeys; ix++) {
+            if ((*bucket)->keys[ix] == key) {
+                histogram_add(&table->chains, nchained);
+                return(ix);
+            }
+        }
+        if (!(*bucket)->overflow) {
+            histogram_add(&table->chains, nchained);
+            return(-1);
+        }
+        *bucket = (*bucket)->overflow;
+    }
+}
+
+bool linhash_hash_table_insert(LinhashHashTable *table, int64 key) {
+    return linhash_hash_table_put(table, key, NULL, false);
+}
+
+bool linhash_hash_table_put(LinhashHashTable *table, int64 key,
+        const void *value, bool replace) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Inserts a key (and its value) into a linear hashing table, then
+     *       splits the next bucket if the table is fuller than
+     *       LINHASH_MAX_LOAD
+     *
+     * INPT: LinhashHashTable *table
+     *          The table in which the key is to be inserted
+     *
+     *       int64 key
+     *          Key which is to be inserted
+     *
+     *       const void *value
+     *          In map mode, the value to store with the key (zeros if NULL)
+     *
+     *       bool replace
+     *          If the key is already in the table, overwrite its value
+     *
+     * OTPT: bool
+     *          True if the key was inserted, false if it was already there
+     *
+     * NOTE: An insert splits at most one bucket, the one at the split
+     *       pointer, whichever bucket the key went into. A full bucket takes
+     *       an overflow bucket instead.
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    Bucket *bucket;
+    int found = linhash_locate(table, key, &bucket);
+    if (found >= 0) {
+        if (replace && table->valuesize) {
+            unsigned char *to = bucket->values + (size_t)found*table->valuesize;
+            if (value) {
+                memcpy(to, value, table->valuesize);
+            } else {
+                memset(to, 0, table->valuesize);
+            }
+        }
+        return false;
+    }
+
+    /* 'bucket' is the last of the key's chain */
+    linhash_append(table, bucket, key, value);
+    table->nitems++;
 
-    double insert_time = 1000*table->accum_insert_time/CLOCKS_PER_SEC;
-    long double lookup_time = 1000*table->accum_lookup_time/CLOCKS_PER_SEC;
+    if (table->nitems > LINHASH_MAX_LOAD*table->nbuckets*table->bucketsize) {
+        linhash_split(table);
+    }
+    return true;
+}
 
+bool linhash_hash_table_reserve(LinhashHashTable *table, size_t nkeys) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Splits buckets up front until 'nkeys' keys fit within
+     *       LINHASH_MAX_LOAD, so inserting them splits no more
+     *
+     * OTPT: bool
+     *          False if the table would grow too large, otherwise true
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    double needed = nkeys / (LINHASH_MAX_LOAD * table->bucketsize);
+    if (needed >= MAX_TABLE_SIZE) {
+        return(false);
+    }
+    while (table->nbuckets < needed) {
+        linhash_split(table);
+    }
+    return(true);
+}
 
-    statrow[0] = table->size;
-    statrow[1] = table->bucketsize;
-    statrow[2] = table->nitems;
-    statrow[3] = lookup_time;
-    statrow[4] = insert_time;
+bool linhash_hash_table_lookup(LinhashHashTable *table, int64 key) {
+    Bucket *bucket;
+    return(linhash_locate(table, key, &bucket) >= 0);
+}
 
-    return(statrow);
+bool linhash_hash_table_get(LinhashHashTable *table, int64 key, void *value) {
+    Bucket *bucket;
+    int ix = linhash_locate(table, key, &bucket);
+    if (ix >= 0 && table->valuesize && value) {
+        memcpy(value, bucket->values + (size_t)ix*table->valuesize,
+                table->valuesize);
+    }
+    return(ix >= 0);
 }
 
-// Print statistics to stdout
-static void print_stat_row(double *statrow) {
-    char seperator = ',';
-    int ix, n_columns=NSTATS;
-    for (ix=0; ix<n_columns;ix++) {
-        printf("%3.9f", statrow[ix]);
-        if (ix!=(n_columns-1)) {
-            printf("%c", seperator);
+// print the contents of 'table' to stdout, one chain per line
+void linhash_hash_table_print(LinhashHashTable *table) {
+    assert(table);
+    printf("--- table size: %d (level %d, split %d)\n", table->nbuckets,
+            table->level, table->split);
+    printf("  address | [key] -> [overflow key]\n");
+
+    int i, j;
+    for (i = 0; i < table->nbuckets; i++) {
+        printf("%9d |", i);
+        Bucket *bucket;
+        for (bucket = *linhash_slot(table, i); bucket;
+                bucket = bucket->overflow) {
+            printf(" [");
+            for (j = 0; j < table->bucketsize; j++) {
+                if (j < bucket->nkeys) {
+                    printf(" %llu", bucket->keys[j]);
+                } else {
+                    printf(" -");
+                }
+            }
+            printf(" ]%s", bucket->overflow ? " ->" : "");
         }
+        printf("\n");
     }
-    printf("\n");
+    printf("--- end table ---\n");
 }
 
-// Get stats and print to stdout
-void xtndbln_hash_table_csv_stats(XtndblNHashTable *table) {
-    double* stats = get_stat_row(table);
-    print_stat_row(stats);
-    free(stats);
+// fill 'stats' with the statistics this table tracks
+void linhash_hash_table_get_stats(LinhashHashTable *table,
+                                  HashTableStats *stats) {
+    stats->size = table->nbuckets;
+    stats->nkeys = table->nitems;
+    stats->nbuckets = table->nbuckets + table->noverflow;
+    stats->bucketsize = table->bucketsize;
+    stats->load_factor =
+        (double)table->nitems/(table->nbuckets*table->bucketsize);
+
+    /* Every bucket but the first was made by a split, and a round of splits
+     * doubles the table */
+    stats->resizes = table->level;
+    stats->splits = table->nbuckets - 1;
+    stats->memory = table->memory.bytes;
+    stats->peak_memory = table->memory.peak;
+    add_stats_histogram(stats, &table->chains);
 }
 
-// Get stats header and print to stdout
-void xtndbln_hash_table_csv_stats_header (XtndblNHashTable *table) {
-    char** header =get_stat_header();
-    print_stat_header(header);
-    free(header);
+// copy the memory currently and at most held by 'table' into 'memory'
+void linhash_hash_table_memory(LinhashHashTable *table, Memory *memory) {
+    *memory = table->memory;
 }
@@ -8,6 +8,14 @@
  * Ben Tomlin
  * SN: 834198
  * btomlin@student.unimelb.edu.au
+ *
+ * Also a linear hashing table (Litwin) built from the same buckets. Rather
+ * than splitting whichever bucket fills, it splits the bucket at a split
+ * pointer each time the table passes LINHASH_MAX_LOAD, in address order, so
+ * every insert splits at most one bucket and there is no directory to double.
+ * A bucket that fills before its turn chains on overflow buckets. Keys go in
+ * bucket h1 mod 2^level, or h1 mod 2^(level+1) if that bucket has already
+ * split this round.
  */
 
 #ifndef XTNDBLN_H
@@ -15,15 +23,32 @@
 
 #include <stdbool.h>
 #include "../inthash.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+#include "../snapshot.h"
 
 typedef struct xtndbln_table XtndblNHashTable;
+typedef struct linhash_table LinhashHashTable;
+
+// load (keys / bucket capacity, overflow buckets aside) past which an insert
+// into a linear hashing table splits a bucket
+#define LINHASH_MAX_LOAD 0.8
+// the bucket array is held in segments of doubling size (none copied as the
+// table grows): enough for MAX_TABLE_SIZE buckets
+#define LINHASH_MAX_SEGMENTS 28
 
 // initialise an extendible hash table with 'bucketsize' keys per bucket
 XtndblNHashTable *new_xtndbln_hash_table(int bucketsize);
 
-// Init a new hash table that uses a specified hash function 
+// initialise an extendible hash table with 'bucketsize' keys per bucket,
+// storing a value of 'valuesize' bytes with each key
+XtndblNHashTable *new_xtndbln_hash_map(int bucketsize, int valuesize);
+
+// Init a new hash table that uses a specified hash function (and stores
+// 'valuesize' bytes of value with each key, if not 0)
 XtndblNHashTable*
-new_xtndbln_specified_hash_table(int bucketsize, int (*hash)(int64 key));
+new_xtndbln_specified_hash_table(int bucketsize, int valuesize,
+                                 int (*hash)(int64 key));
 
 // Get size of XtndblNHashTable
 int get_xtndbln_table_size(XtndblNHashTable *table); 
@@ -35,29 +60,76 @@ void free_xtndbln_hash_table(XtndblNHashTable *table);
 // returns true if insertion succeeds, false if it was already in there
 bool xtndbln_hash_table_insert(XtndblNHashTable *table, int64 key);
 
+// insert 'key' with 'value' (zeros if NULL) into 'table'. if 'key' is already
+// in there, its value is overwritten only if 'replace'
+// returns true if 'key' was inserted, false if it was already in there (or
+// the directory would grow past MAX_TABLE_SIZE)
+bool xtndbln_hash_table_put(XtndblNHashTable *table, int64 key,
+                            const void *value, bool replace);
+
+// make room for 'nkeys' keys in total by growing the directory and splitting
+// buckets up front. returns false if the table would grow too large
+bool xtndbln_hash_table_reserve(XtndblNHashTable *table, size_t nkeys);
+
+// back the directory of 'table' as 'policy' asks (moving it if need be), now
+// and whenever it doubles
+void xtndbln_hash_table_set_pages(XtndblNHashTable *table, PagePolicy policy);
+
 // Swap key with a random one from the bucket to which it hashes.*/ 
-int64 xtndbln_hash_table_rand_swap(XtndblNHashTable *table, int64 key);
+// In map mode 'value' holds the key's value, and receives the swapped one's
+int64 xtndbln_hash_table_rand_swap(XtndblNHashTable *table, int64 key,
+                                   void *value);
+
+// Swap key with the 'index'th one of the bucket to which it hashes, as above
+int64 xtndbln_hash_table_swap(XtndblNHashTable *table, int64 key,
+                              void *value, int index);
 
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool xtndbln_hash_table_lookup(XtndblNHashTable *table, int64 key);
 
+// lookup 'key' in 'table', copying its value into 'value' (unless NULL)
+// returns true if found, false if not
+bool xtndbln_hash_table_get(XtndblNHashTable *table, int64 key, void *value);
+
 /* Checks whether table has space for a key */
 bool xtndbln_hash_table_has_space(XtndblNHashTable *table, int64 key);
 
+/* Number of keys in the bucket to which a key hashes, and the 'index'th of
+ * them (0 <= index < that number) */
+int xtndbln_hash_table_bucket_load(XtndblNHashTable *table, int64 key);
+int64 xtndbln_hash_table_bucket_key(XtndblNHashTable *table, int64 key,
+                                    int index);
+
 // print the contents of 'table' to stdout
 void xtndbln_hash_table_print(XtndblNHashTable *table);
 
 // print the contents of 'table' to stdout without header or footer
 void xtndbln_hash_table_print_sparse(XtndblNHashTable *table);
 
-// print some statistics about 'table' to stdout
-void xtndbln_hash_table_stats(XtndblNHashTable *table);
-
-// print a csv row of stats
-void xtndbln_hash_table_csv_stats(XtndblNHashTable *table);
-
-// print a csv header for stats
-void xtndbln_hash_table_csv_stats_header (XtndblNHashTable *table);
+// fill 'stats' with the statistics this table tracks
+void xtndbln_hash_table_get_stats(XtndblNHashTable *table,
+                                  HashTableStats *stats);
+
+// write the directory and buckets of 'table' to 'writer'
+void xtndbln_hash_table_save(XtndblNHashTable *table, SnapshotWriter *writer);
+
+// copy the memory currently and at most held by 'table' into 'memory'
+void xtndbln_hash_table_memory(XtndblNHashTable *table, Memory *memory);
+
+// linear hashing counterparts of the functions above
+LinhashHashTable *new_linhash_hash_table(int bucketsize);
+LinhashHashTable *new_linhash_hash_map(int bucketsize, int valuesize);
+void free_linhash_hash_table(LinhashHashTable *table);
+bool linhash_hash_table_insert(LinhashHashTable *table, int64 key);
+bool linhash_hash_table_put(LinhashHashTable *table, int64 key,
+                            const void *value, bool replace);
+bool linhash_hash_table_reserve(LinhashHashTable *table, size_t nkeys);
+bool linhash_hash_table_lookup(LinhashHashTable *table, int64 key);
+bool linhash_hash_table_get(LinhashHashTable *table, int64 key, void *value);
+void linhash_hash_table_print(LinhashHashTable *table);
+void linhash_hash_table_get_stats(LinhashHashTable *table,
+                                  HashTableStats *stats);
+void linhash_hash_table_memory(LinhashHashTable *table, Memory *memory);
 
 #endif
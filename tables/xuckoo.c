@@ -1,8 +1,8 @@
 /* * * * * * * * *
 * Dynamic hash table using a combination of extendible hashing and cuckoo
 * hashing with a single keys per bucket, resolving collisions by switching keys 
-* between two tables with two separate hash functions and growing the tables 
-* incrementally in response to cycles
+* between two (up to four) tables with separate hash functions and growing the
+* tables incrementally in response to cycles
 *
 * created for COMP20007 Design of Algorithms - Assignment 2, 2017
 * 14/05/17
@@ -21,9 +21,9 @@
 /* The code for xtndbln.h can be reused */
 #include "xtndbln.h"
 #include "xuckoo.h"
+#include "../memacct.h"
+#include "../tblstats.h"
 
-#define NSTATS 5
-#define HEADER_MAX_STR_LENGTH 100
 
 // an inner table is an extendible hash table with an array of slots pointing 
 // to buckets holding up to 1 key, along with some information about the number 
@@ -33,23 +33,36 @@ typedef struct inner_table {
 	int keycount;			 // how many keys are being stored in the table
 } InnerTable;
 
-// a xuckoo hash table is just two inner tables for storing inserted keys
+// a xuckoo hash table is just two (or more) inner tables for storing inserted
+// keys, inner table t addressing its keys with hash function t+1
 struct xuckoo_table {
-	InnerTable *table1;
-	InnerTable *table2;
+	InnerTable *tables[XUCKOO_MAX_TABLES];
+	int ntables;
 
     int bucketsize;
+    int valuesize;  // bytes of value stored with each key (0: no values)
     double accum_insert_time; 
     double accum_lookup_time;
+
+    long nkicks;    // keys swapped out of a bucket to make room for another
+    Histogram chains;   // kicks made by each insert
+    Memory memory;  // heap memory held outside of the inner xtndbln tables
 };
 
-static InnerTable *new_inner_table(int bucketsize, int (*hash)(int64 key)) {
+static InnerTable *new_inner_table(Memory *memory, int bucketsize,
+        int valuesize, int (*hash)(int64 key)) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
      * DESC: Initializes a new xuckoo inner table
      *
-     * INPT: int bucketsize
+     * INPT: Memory *memory
+     *          Accounting of the xuckoo table the inner table belongs to
+     *
+     *       int bucketsize
      *          How many keys buckets of this inner table should hold.
      *
+     *       int valuesize
+     *          Bytes of value stored with each key, 0 for no values
+     *
      *       int (*hash)(int64 key)
      *          A function pointer to the hash function to be used for this
      *          inner table
@@ -58,8 +71,9 @@ static InnerTable *new_inner_table(int bucketsize, int (*hash)(int64 key)) {
      *          A pointer to the newly initialized inner table
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-    InnerTable *table = malloc(sizeof(*table));
-    table->xtable = new_xtndbln_specified_hash_table(bucketsize, hash);
+    InnerTable *table = memory_malloc(memory, sizeof(*table));
+    table->xtable = new_xtndbln_specified_hash_table(bucketsize, valuesize,
+            hash);
     table->keycount = 0;
     return(table);
 }
@@ -73,18 +87,7 @@ XuckooHashTable *new_xuckoo_hash_table() {
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
     /* Default bucket size for extendable xuckoo table */
-    int bucketsize = 1;
-    XuckooHashTable *table = malloc(sizeof(*table));
-    
-    /* Create inner tables, with hash functions as per assignment spec */
-    table->table1 = new_inner_table(bucketsize, h1); 
-    table->table2 = new_inner_table(bucketsize, h2);
-
-    table->bucketsize = bucketsize;
-    table->accum_insert_time = 0;
-    table->accum_lookup_time = 0;
-
-	return table;
+    return new_xuckoo_hash_map(1, 0);
 }
 
 XuckooHashTable *new_xuckoo_hash_table_with_bucketsize(int bucketsize) {
@@ -98,34 +101,105 @@ XuckooHashTable *new_xuckoo_hash_table_with_bucketsize(int bucketsize) {
      *          A pointer to the new table
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+    return new_xuckoo_hash_map(bucketsize, 0);
+}
 
-    XuckooHashTable *table = malloc(sizeof(*table));
-    table->table1 = new_inner_table(bucketsize, h1); 
-    table->table2 = new_inner_table(bucketsize, h2);
+XuckooHashTable *new_xuckoo_hash_map(int bucketsize, int valuesize) {
+    return new_xuckoo_dary_hash_map(bucketsize, valuesize, 2);
+}
+
+XuckooHashTable *new_xuckoo_dary_hash_map(int bucketsize, int valuesize,
+        int ntables) {
+    /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
+     * DESC: Initializes a new xuckoo table storing a value with each key
+     *
+     * INPT: int bucketsize
+     *          How many keys buckets of this table should hold.
+     *
+     *       int valuesize
+     *          Bytes of value stored with each key, 0 for no values
+     *
+     *       int ntables
+     *          How many inner tables (and hash functions) to use, 2 to
+     *          XUCKOO_MAX_TABLES
+     *
+     * OTPT: XuckooHashTable*
+     *          A pointer to the new table, or NULL if ntables is out of range
+     *
+     * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
+
+    if (ntables < 2 || ntables > XUCKOO_MAX_TABLES) {
+        return NULL;
+    }
+
+    Memory memory;
+    memory_init(&memory);
+    XuckooHashTable *table = memory_malloc(&memory, sizeof(*table));
+    table->memory = memory;
+
+    /* Create inner tables, with hash functions h1, h2 as per assignment spec
+     * (then h3, h4) */
+    int t;
+    table->ntables = ntables;
+    for (t = 0; t < ntables; t++) {
+        table->tables[t] = new_inner_table(&table->memory, bucketsize,
+                valuesize, hash_function(t+1));
+    }
 
     table->bucketsize = bucketsize;
+    table->valuesize = valuesize;
     table->accum_insert_time = 0;
     table->accum_lookup_time = 0;
+    table->nkicks = 0;
+    init_histogram(&table->chains, "kick chain length", 1);
 
     return table;
 }
 
 /* Free all memory associated with an inner table */
-void free_inner_table(InnerTable *table) {
+void free_inner_table(Memory *memory, InnerTable *table) {
     free_xtndbln_hash_table(table->xtable);
-    free(table);
+    memory_free(memory, table);
 }
 
 // free all memory associated with 'table'
 void free_xuckoo_hash_table(XuckooHashTable *table) {
-    free_inner_table(table->table1);
-    free_inner_table(table->table2);
-    free(table);
+    int t;
+    for (t = 0; t < table->ntables; t++) {
+        free_inner_table(&table->memory, table->tables[t]);
+    }
+    memory_free(&table->memory, table);
+}
+
+// make room for 'nkeys' keys in total, growing every inner table up front
+bool xuckoo_hash_table_reserve(XuckooHashTable *table, size_t nkeys) {
+    /* Keys spread about evenly between the inner tables */
+    size_t share = (nkeys + table->ntables - 1)/table->ntables;
+    int t;
+    for (t = 0; t < table->ntables; t++) {
+        if (!xtndbln_hash_table_reserve(table->tables[t]->xtable, share)) {
+            return(false);
+        }
+    }
+    return(true);
+}
+
+// back the directory of every inner table as 'policy' asks
+void xuckoo_hash_table_set_pages(XuckooHashTable *table, PagePolicy policy) {
+    int t;
+    for (t = 0; t < table->ntables; t++) {
+        xtndbln_hash_table_set_pages(table->tables[t]->xtable, policy);
+    }
 }
 
 bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
+    return xuckoo_hash_table_put(table, key, NULL, false);
+}
+
+bool xuckoo_hash_table_put(XuckooHashTable *table, int64 key,
+        const void *value, bool replace) {
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * *
-     * DESC: Insert key to an extendible cuckoo hash table
+     * DESC: Insert key (and its value) to an extendible cuckoo hash table
      *
      * INPT: XuckooHashTable*
      *          Table in which to insert the key
@@ -133,8 +207,17 @@ bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
      *       int64 key
      *          Key to be inserted into the table
      *
-     * OTPT: none
-     *          Mutates table structure
+     *       const void *value
+     *          In map mode, the value to store with the key (zeros if NULL).
+     *          Ignored otherwise.
+     *
+     *       bool replace
+     *          If the key is already in the table, overwrite its value
+     *
+     * OTPT: bool
+     *          True if the key was inserted, false if it was already in the
+     *          table or could not be placed without a directory growing past
+     *          MAX_TABLE_SIZE.
      *
      * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
@@ -146,15 +229,27 @@ bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
      * insertion time)*/
     double original_accum_lookup_time = table->accum_lookup_time;
 
-    /* Return false if key already in the table */
-    if (xuckoo_hash_table_lookup(table, key)) { return(false); }
+    /* Return false if key already in the table, replacing its value in
+     * whichever inner table holds it if asked to */
+    int t;
+    for (t = 0; t < table->ntables; t++) {
+        if (xtndbln_hash_table_lookup(table->tables[t]->xtable, key)) {
+            xtndbln_hash_table_put(table->tables[t]->xtable, key, value,
+                    replace);
+            table->accum_lookup_time = original_accum_lookup_time;
+            return(false);
+        }
+    }
 
-    /* Helper function selects first inner table if 'first_table' else 2nd*/
-    InnerTable *get_inner_table(bool first_table) {
-        if (first_table) {
-            return(table->table1);
+    /* The value travels with the key as it is kicked between tables */
+    unsigned char carried[table->valuesize ? table->valuesize : 1];
+    void *carry = NULL;
+    if (table->valuesize) {
+        carry = carried;
+        if (value) {
+            memcpy(carried, value, table->valuesize);
         } else {
-            return(table->table2);
+            memset(carried, 0, table->valuesize);
         }
     }
 
@@ -162,17 +257,59 @@ bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
      * call. Kick threshold is log2(mean inner table size) + 1 */
     int get_kick_threshold() {
 
-        /* Find the total size of both extendable N tables */
-        int total_size = get_xtndbln_table_size(table->table1->xtable);
-        total_size += get_xtndbln_table_size(table->table2->xtable);
+        /* Find the total size of all extendable N tables */
+        int i, total_size = 0;
+        for (i = 0; i < table->ntables; i++) {
+            total_size += get_xtndbln_table_size(table->tables[i]->xtable);
+        }
 
         /* Calculate & return the kick threshold. */
         return(log2(total_size));
     }
 
-    /* Find which table has the least keys in it, Attempt to insert here first*/
-    bool first_slim = (table->table1->keycount <= table->table2->keycount);
-    InnerTable *inner_table = get_inner_table(first_slim);
+    /* Helper function finds the inner table (other than 'except', -1 for
+     * none) whose bucket for 'key' holds the fewest keys, the table with the
+     * fewer keys overall on ties */
+    int least_loaded(int64 key, int except) {
+        int i, load, best = -1, best_load = 0;
+        for (i = 0; i < table->ntables; i++) {
+            if (i == except) {continue;}
+            load = xtndbln_hash_table_bucket_load(table->tables[i]->xtable,
+                    key);
+            if (best < 0 || load < best_load || (load == best_load
+                    && table->tables[i]->keycount
+                        < table->tables[best]->keycount)) {
+                best = i;
+                best_load = load;
+            }
+        }
+        return(best);
+    }
+
+    /* Helper function finds a key of the (full) bucket for 'key' in inner
+     * table 'from' that has space in its bucket of another inner table,
+     * setting 'to' to that table. Returns its index in the bucket, or -1 if
+     * every key's other buckets are full too */
+    int find_movable(int64 key, int from, int *to) {
+        XtndblNHashTable *xtable = table->tables[from]->xtable;
+        int i, other, nkeys = xtndbln_hash_table_bucket_load(xtable, key);
+        for (i = 0; i < nkeys; i++) {
+            int64 victim = xtndbln_hash_table_bucket_key(xtable, key, i);
+            for (other = 0; other < table->ntables; other++) {
+                if (other != from && xtndbln_hash_table_has_space(
+                            table->tables[other]->xtable, victim)) {
+                    *to = other;
+                    return(i);
+                }
+            }
+        }
+        return(-1);
+    }
+
+    /* Insert where the key's bucket is emptiest, not merely into the table
+     * with fewer keys: any free space is used, and the tables fill evenly */
+    int slim = least_loaded(key, -1);
+    InnerTable *inner_table = table->tables[slim];
 
     int kick_count = 0;
     int kick_threshold = get_kick_threshold();
@@ -182,20 +319,51 @@ bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key) {
     while ( (kick_count != kick_threshold) &&
             !xtndbln_hash_table_has_space(inner_table->xtable, key) ) {
 
-        /* Swap(cuckoo) key a random key from the bucket to which key belongs*/
-        key = xtndbln_hash_table_rand_swap(inner_table->xtable, key);
+        /* Swap(cuckoo) out a key that can move straight into a bucket with
+         * space if there is one, ending the chain, otherwise a random key
+         * from the bucket to which key belongs */
+        int to, victim = find_movable(key, slim, &to);
+        if (victim >= 0) {
+            key = xtndbln_hash_table_swap(inner_table->xtable, key, carry,
+                    victim);
+            slim = to;
+        } else {
+            key = xtndbln_hash_table_rand_swap(inner_table->xtable, key,
+                    carry);
+            slim = least_loaded(key, slim);
+        }
+        inner_table = table->tables[slim];
 
         /* Increase the kick count. */
         kick_count++;
+        table->nkicks++;
+    }
 
-        /* Swap insert target table */
-        first_slim = !first_slim;
-        inner_table = get_inner_table(first_slim);
+    /* Out of kicks, a bucket must split: split the key's bucket in the
+     * table with fewer keys, so the tables stay balanced, rather than
+     * wherever the chain happened to stop */
+    if (!xtndbln_hash_table_has_space(inner_table->xtable, key)) {
+        slim = least_loaded(key, -1);
+        inner_table = table->tables[slim];
     }
-    
+
     /* If there is space, perform standard insert operation */
-    /* If there is not space, split the bucket as necessary */
-    xtndbln_hash_table_insert(inner_table->xtable, key);
+    /* If there is not space, split the bucket as necessary, or failing that
+     * (the directory is as large as it can be), try the other tables */
+    for (t = 0; t < table->ntables; t++) {
+        inner_table = table->tables[(slim + t) % table->ntables];
+        if (xtndbln_hash_table_put(inner_table->xtable, key, carry, false)) {
+            break;
+        }
+    }
+    histogram_add(&table->chains, kick_count);
+    if (t == table->ntables) {
+        /* The key in hand (maybe not the one being inserted) is dropped, as
+         * when a cuckoo table cannot upsize */
+        table->accum_lookup_time = original_accum_lookup_time;
+        table->accum_insert_time += clock() - start_time;
+        return false;
+    }
     inner_table->keycount++;
 
     /* Dont double count lookup time (reset it)*/
@@ -228,117 +396,104 @@ bool xuckoo_hash_table_lookup(XuckooHashTable *table, int64 key) {
     int start_time = clock();
 
     /* Search for key */
-    bool status = xtndbln_hash_table_lookup(table->table1->xtable, key);
-    status = (status || xtndbln_hash_table_lookup(table->table2->xtable, key));
+    bool status = false;
+    int t;
+    for (t = 0; t < table->ntables && !status; t++) {
+        status = xtndbln_hash_table_lookup(table->tables[t]->xtable, key);
+    }
 
     /* Save lookup time and return search status */
     table->accum_lookup_time += clock()-start_time;
     return(status);
 }
 
+// lookup 'key' in 'table', copying its value into 'value' (unless NULL)
+bool xuckoo_hash_table_get(XuckooHashTable *table, int64 key, void *value) {
+    int start_time = clock();
+    bool status = false;
+    int t;
+    for (t = 0; t < table->ntables && !status; t++) {
+        status = xtndbln_hash_table_get(table->tables[t]->xtable, key, value);
+    }
+    table->accum_lookup_time += clock()-start_time;
+    return(status);
+}
+
 // print the contents of 'table' to stdout
 void xuckoo_hash_table_print(XuckooHashTable *table) {
 	assert(table != NULL);
 
 	printf("--- table ---\n");
 
-	// loop through the two tables, printing them
-	InnerTable *innertables[2] = {table->table1, table->table2};
+	// loop through the inner tables, printing them
 	int t;
-	for (t = 0; t < 2; t++) {
+	for (t = 0; t < table->ntables; t++) {
 		// print header
 		printf("table %d\n", t+1);
 
         // print table
-        xtndbln_hash_table_print_sparse(innertables[t]->xtable);
+        xtndbln_hash_table_print_sparse(table->tables[t]->xtable);
 	}
 	printf("--- end table ---\n");
 }
 
-// print some statistics about 'table' to stdout
-void xuckoo_hash_table_stats(XuckooHashTable *table) {
-	fprintf(stderr, "Please see the print csv data functions.\n");
-    fprintf(stderr, "Press h for additional csv stat print commands\n");
-	return;
-}
-
-// Returns csv stat header 
-static char** get_stat_header() {
-    int ix, n_columns = NSTATS;
-    char** header= malloc(sizeof(char*)*n_columns);
-
-    /* Allocate memory for header strings */
-    for (ix=0; ix<n_columns; ix++) {
-        header[ix]=malloc(sizeof(char)*HEADER_MAX_STR_LENGTH);
-    }
-
-    strcpy(header[0],"bucket count [buckets]");
-    strcpy(header[1],"bucket size [slots]");
-    strcpy(header[2],"key count [keys]");
-    strcpy(header[3],"lookup time [ms]");
-    strcpy(header[4],"insert time [ms]");
-
-    return(header);
-}
-
-// Print csv stat header to stdout
-static void print_stat_header(char** header) {
-    int ix, n_columns=NSTATS;
-    char seperator=',';
-    for (ix=0; ix<n_columns; ix++) {
-        printf("%s", header[ix]);
-        if (ix!=(n_columns-1)) {
-            printf("%c", seperator);
+// fill 'stats' with the statistics this table tracks
+void xuckoo_hash_table_get_stats(XuckooHashTable *table, HashTableStats *stats) {
+    HashTableStats inner;
+    Histogram splits;
+    int t;
+
+    /* Structure is the sum of all inner tables, and splits are those of all
+     * inner tables together */
+    stats->size = stats->nkeys = stats->nbuckets = 0;
+    stats->resizes = stats->splits = 0;
+    for (t = 0; t < table->ntables; t++) {
+        init_hash_table_stats(&inner);
+        xtndbln_hash_table_get_stats(table->tables[t]->xtable, &inner);
+        stats->size += inner.size;
+        stats->nkeys += table->tables[t]->keycount;
+        stats->nbuckets += inner.nbuckets;
+        stats->resizes += inner.resizes;
+        stats->splits += inner.splits;
+        if (t == 0) {
+            splits = inner.histograms[0];
+        } else {
+            histogram_merge(&splits, &inner.histograms[0]);
         }
     }
-    printf("\n");
-}
-
-// Get a csv row of statistics for the table 
-static double* get_stat_row(XuckooHashTable* table) {
-    int n_columns = NSTATS;
-    double* statrow = malloc(sizeof(double) * n_columns);
-
-    double insert_time = 1000*table->accum_insert_time/CLOCKS_PER_SEC;
-    long double lookup_time = 1000*table->accum_lookup_time/CLOCKS_PER_SEC;
-    int size = get_xtndbln_table_size(table->table1->xtable);
-    size+=get_xtndbln_table_size(table->table2->xtable);
+    stats->bucketsize = table->bucketsize;
+    stats->load_factor = (double)stats->nkeys/(stats->nbuckets*table->bucketsize);
+    stats->kicks = table->nkicks;
 
-    int nkeys = table->table1->keycount;
-    nkeys+= table->table2->keycount;
+    add_stats_histogram(stats, &table->chains);
+    add_stats_histogram(stats, &splits);
 
-    statrow[0] = size;
-    statrow[1] = table->bucketsize;
-    statrow[2] = nkeys;
-    statrow[3] = lookup_time;
-    statrow[4] = insert_time;
+    /* Inner table timings are included in the xuckoo table's own */
+    stats->insert_time = 1000*table->accum_insert_time/CLOCKS_PER_SEC;
+    stats->lookup_time = 1000*table->accum_lookup_time/CLOCKS_PER_SEC;
 
-    return(statrow);
+    Memory memory;
+    xuckoo_hash_table_memory(table, &memory);
+    stats->memory = memory.bytes;
+    stats->peak_memory = memory.peak;
 }
 
-// Print statistics to stdout
-static void print_stat_row(double *statrow) {
-    char seperator = ',';
-    int ix, n_columns=NSTATS;
-    for (ix=0; ix<n_columns;ix++) {
-        printf("%3.9f", statrow[ix]);
-        if (ix!=(n_columns-1)) {
-            printf("%c", seperator);
-        }
+// copy the memory currently and at most held by 'table' into 'memory'. the
+// inner tables grow independently, so the peak is an upper bound
+void xuckoo_hash_table_memory(XuckooHashTable *table, Memory *memory) {
+    Memory inner;
+    int t;
+    *memory = table->memory;
+    for (t = 0; t < table->ntables; t++) {
+        xtndbln_hash_table_memory(table->tables[t]->xtable, &inner);
+        memory_add(memory, &inner);
     }
-    printf("\n");
-}
-
-// Get stats and print to stdout
-void xuckoo_hash_table_csv_stats(XuckooHashTable *table) {
-    double* stats = get_stat_row(table);
-    print_stat_row(stats);
-    free(stats);
 }
 
-// Get stats header and print to stdout
-void xuckoo_hash_table_csv_stats_header (XuckooHashTable *table) {
-    char** header =get_stat_header();
-    print_stat_header(header);
-    free(header);
+// write every inner table of 'table' to 'writer' as directory sections
+void xuckoo_hash_table_save(XuckooHashTable *table, SnapshotWriter *writer) {
+    int t;
+    for (t = 0; t < table->ntables; t++) {
+        xtndbln_hash_table_save(table->tables[t]->xtable, writer);
+    }
 }
@@ -2,7 +2,8 @@
 * Dynamic hash table using a combination of extendible hashing and cuckoo
 * hashing with a single keys per bucket, resolving collisions by switching keys 
 * between two tables with two separate hash functions and growing the tables 
-* incrementally in response to cycles
+* incrementally in response to cycles. Up to XUCKOO_MAX_TABLES tables (and hash
+* functions) can be used instead of two
 *
 * created for COMP20007 Design of Algorithms - Assignment 2, 2017
 * 14/05/17
@@ -16,6 +17,14 @@
 
 #include <stdbool.h>
 #include "../inthash.h"
+#include "../memacct.h"
+#include "../tblstats.h"
+#include "../snapshot.h"
+
+// the most inner tables a xuckoo table can have. more tables give each key
+// more buckets to go to, so fewer inserts kick or split a bucket, at the cost
+// of more buckets to check per lookup
+#define XUCKOO_MAX_TABLES 4
 
 typedef struct xuckoo_table XuckooHashTable;
 
@@ -25,6 +34,15 @@ XuckooHashTable *new_xuckoo_hash_table();
 XuckooHashTable 
 *new_xuckoo_hash_table_with_bucketsize(int bucketsize);
 
+// initialise an extendible cuckoo hash table with 'bucketsize' keys per
+// bucket, storing a value of 'valuesize' bytes with each key
+XuckooHashTable *new_xuckoo_hash_map(int bucketsize, int valuesize);
+
+// as new_xuckoo_hash_map, but with 'ntables' inner tables (2 to
+// XUCKOO_MAX_TABLES) instead of two. returns NULL if 'ntables' is out of range
+XuckooHashTable *new_xuckoo_dary_hash_map(int bucketsize, int valuesize,
+	int ntables);
+
 // free all memory associated with 'table'
 void free_xuckoo_hash_table(XuckooHashTable *table);
 
@@ -32,20 +50,39 @@ void free_xuckoo_hash_table(XuckooHashTable *table);
 // returns true if insertion succeeds, false if it was already in there
 bool xuckoo_hash_table_insert(XuckooHashTable *table, int64 key);
 
+// insert 'key' with 'value' (zeros if NULL) into 'table'. if 'key' is already
+// in there, its value is overwritten only if 'replace'
+// returns true if 'key' was inserted, false if it was already in there (or
+// the tables would grow past MAX_TABLE_SIZE, when a kicked key may be lost)
+bool xuckoo_hash_table_put(XuckooHashTable *table, int64 key,
+	const void *value, bool replace);
+
+// make room for 'nkeys' keys in total by growing every inner table up front.
+// returns false if the table would grow too large
+bool xuckoo_hash_table_reserve(XuckooHashTable *table, size_t nkeys);
+
+// back the directories of the inner tables of 'table' as 'policy' asks, now
+// and whenever they double
+void xuckoo_hash_table_set_pages(XuckooHashTable *table, PagePolicy policy);
+
 // lookup whether 'key' is inside 'table'
 // returns true if found, false if not
 bool xuckoo_hash_table_lookup(XuckooHashTable *table, int64 key);
 
+// lookup 'key' in 'table', copying its value into 'value' (unless NULL)
+// returns true if found, false if not
+bool xuckoo_hash_table_get(XuckooHashTable *table, int64 key, void *value);
+
 // print the contents of 'table' to stdout
 void xuckoo_hash_table_print(XuckooHashTable *table);
 
-// print some statistics about 'table' to stdout
-void xuckoo_hash_table_stats(XuckooHashTable *table);
+// fill 'stats' with the statistics this table tracks
+void xuckoo_hash_table_get_stats(XuckooHashTable *table, HashTableStats *stats);
 
-// print some statistics about 'table' to stdout in csv form
-void xuckoo_hash_table_csv_stats(XuckooHashTable *table);
+// write every inner table of 'table' to 'writer' as directory sections
+void xuckoo_hash_table_save(XuckooHashTable *table, SnapshotWriter *writer);
 
-// print csv statistics header
-void xuckoo_hash_table_csv_stats_header (XuckooHashTable *table);
+// copy the memory currently and at most held by 'table' into 'memory'
+void xuckoo_hash_table_memory(XuckooHashTable *table, Memory *memory);
 
 #endif
@@ -0,0 +1,221 @@
+/* * * * * * * * *
+ * Common statistics record filled in by every table type, with emitters for
+ * csv, json and plain text, so every type can be reported (and scraped) the
+ * same way
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+
+#include "tblstats.h"
+
+// how a field is stored in HashTableStats
+typedef enum kind { COUNT, REAL } Kind;
+
+// one numeric field of HashTableStats, with the names it is emitted under
+typedef struct field {
+	const char *key;	// json key
+	const char *label;	// csv header and text label
+	const char *unit;	// unit, for the csv header and text
+	Kind kind;
+	size_t offset;		// where it is in HashTableStats
+} Field;
+
+// every numeric field, in the order they are emitted
+static const Field fields[] = {
+	{"size", "size", "slots", COUNT, offsetof(HashTableStats, size)},
+	{"nkeys", "key count", "keys", COUNT, offsetof(HashTableStats, nkeys)},
+	{"nbuckets", "bucket count", "buckets", COUNT,
+		offsetof(HashTableStats, nbuckets)},
+	{"bucketsize", "bucket size", "keys", COUNT,
+		offsetof(HashTableStats, bucketsize)},
+	{"load_factor", "load factor", "-", REAL,
+		offsetof(HashTableStats, load_factor)},
+	{"collisions", "collision count", "inserts", COUNT,
+		offsetof(HashTableStats, collisions)},
+	{"probe_length", "average probe length", "slots", REAL,
+		offsetof(HashTableStats, probe_length)},
+	{"resizes", "resizes", "-", COUNT, offsetof(HashTableStats, resizes)},
+	{"kicks", "kicks", "keys", COUNT, offsetof(HashTableStats, kicks)},
+	{"splits", "splits", "buckets", COUNT, offsetof(HashTableStats, splits)},
+	{"filtered", "filtered lookups", "lookups", COUNT,
+		offsetof(HashTableStats, filtered)},
+	{"insert_time", "insert time", "ms", REAL,
+		offsetof(HashTableStats, insert_time)},
+	{"lookup_time", "lookup time", "ms", REAL,
+		offsetof(HashTableStats, lookup_time)},
+	{"memory", "memory", "bytes", COUNT, offsetof(HashTableStats, memory)},
+	{"peak_memory", "peak memory", "bytes", COUNT,
+		offsetof(HashTableStats, peak_memory)},
+	{"memory_per_key", "memory per key", "bytes", REAL,
+		offsetof(HashTableStats, memory_per_key)},
+};
+#define NFIELDS (int)(sizeof fields / sizeof *fields)
+
+// the value of 'field' in 'stats', and whether it is tracked
+static bool get_field(const HashTableStats *stats, const Field *field,
+		double *value) {
+	const char *base = (const char *)stats + field->offset;
+	if (field->kind == COUNT) {
+		*value = *(const long *)base;
+	} else {
+		*value = *(const double *)base;
+	}
+	return *value != UNTRACKED;
+}
+
+// print a tracked value: counts as integers, everything else to 3 places
+static void fprint_value(FILE *file, const Field *field, double value) {
+	if (field->kind == COUNT) {
+		fprintf(file, "%.0f", value);
+	} else {
+		fprintf(file, "%.3f", value);
+	}
+}
+
+void init_hash_table_stats(HashTableStats *stats) {
+	int i;
+	stats->type = "unknown";
+	for (i = 0; i < NFIELDS; i++) {
+		char *base = (char *)stats + fields[i].offset;
+		if (fields[i].kind == COUNT) {
+			*(long *)base = UNTRACKED;
+		} else {
+			*(double *)base = UNTRACKED;
+		}
+	}
+	stats->nhistograms = 0;
+}
+
+void add_stats_histogram(HashTableStats *stats, const Histogram *histogram) {
+	assert(stats->nhistograms < MAX_HISTOGRAMS);
+	stats->histograms[stats->nhistograms++] = *histogram;
+}
+
+void finish_hash_table_stats(HashTableStats *stats) {
+	if (stats->memory != UNTRACKED && stats->nkeys != UNTRACKED) {
+		stats->memory_per_key = stats->nkeys
+			? (double)stats->memory / stats->nkeys : 0;
+	}
+}
+
+void fprint_stats_csv_header(FILE *file) {
+	int i;
+	fprintf(file, "table");
+	for (i = 0; i < NFIELDS; i++) {
+		fprintf(file, ",%s [%s]", fields[i].label, fields[i].unit);
+	}
+	fprintf(file, "\n");
+}
+
+void fprint_stats_csv(FILE *file, const HashTableStats *stats) {
+	int i;
+	double value;
+	fprintf(file, "%s", stats->type);
+	for (i = 0; i < NFIELDS; i++) {
+		fprintf(file, ",");
+		if (get_field(stats, &fields[i], &value)) {
+			fprint_value(file, &fields[i], value);
+		}
+	}
+	fprintf(file, "\n");
+}
+
+void fprint_histograms_csv_header(FILE *file) {
+	fprintf(file, "table,histogram,from,to,count\n");
+}
+
+void fprint_histograms_csv(FILE *file, const HashTableStats *stats) {
+	int h, i;
+	long low, high;
+	for (h = 0; h < stats->nhistograms; h++) {
+		const Histogram *histogram = &stats->histograms[h];
+		for (i = 0; i < HIST_BINS; i++) {
+			if (histogram->bins[i] == 0) {
+				continue;
+			}
+			// the open ended bin has an empty 'to' column
+			fprintf(file, "%s,%s,", stats->type, histogram->name);
+			if (histogram_bin_range(histogram, i, &low, &high)) {
+				fprintf(file, "%ld,%ld", low, high);
+			} else {
+				fprintf(file, "%ld,", low);
+			}
+			fprintf(file, ",%ld\n", histogram->bins[i]);
+		}
+	}
+}
+
+// write 'histogram' as a json object, bins as [from, to, count] triples
+static void fprint_histogram_json(FILE *file, const Histogram *histogram) {
+	int i;
+	long low, high;
+	bool first = true;
+	fprintf(file, "{\"n\": %ld, \"mean\": %.3f, \"max\": %ld, \"bins\": [",
+		histogram->n, histogram->n ? histogram->sum / histogram->n : 0,
+		histogram->max);
+	for (i = 0; i < HIST_BINS; i++) {
+		if (histogram->bins[i] == 0) {
+			continue;
+		}
+		fprintf(file, "%s[", first ? "" : ", ");
+		if (histogram_bin_range(histogram, i, &low, &high)) {
+			fprintf(file, "%ld, %ld", low, high);
+		} else {
+			fprintf(file, "%ld, null", low);
+		}
+		fprintf(file, ", %ld]", histogram->bins[i]);
+		first = false;
+	}
+	fprintf(file, "]}");
+}
+
+void fprint_stats_json(FILE *file, const HashTableStats *stats) {
+	int i;
+	double value;
+	// type names are plain identifiers, so need no escaping
+	fprintf(file, "{\"type\": \"%s\"", stats->type);
+	for (i = 0; i < NFIELDS; i++) {
+		fprintf(file, ", \"%s\": ", fields[i].key);
+		if (get_field(stats, &fields[i], &value)) {
+			fprint_value(file, &fields[i], value);
+		} else {
+			fprintf(file, "null");
+		}
+	}
+	// histogram names are fixed strings without quotes or backslashes
+	fprintf(file, ", \"histograms\": {");
+	for (i = 0; i < stats->nhistograms; i++) {
+		fprintf(file, "%s\"%s\": ", i ? ", " : "", stats->histograms[i].name);
+		fprint_histogram_json(file, &stats->histograms[i]);
+	}
+	fprintf(file, "}}\n");
+}
+
+void fprint_stats_text(FILE *file, const HashTableStats *stats) {
+	int i;
+	double value;
+	fprintf(file, "--- table stats ---\n");
+	fprintf(file, "%20s: %s\n", "table type", stats->type);
+	for (i = 0; i < NFIELDS; i++) {
+		if (get_field(stats, &fields[i], &value)) {
+			fprintf(file, "%20s: ", fields[i].label);
+			fprint_value(file, &fields[i], value);
+			fprintf(file, " [%s]\n", fields[i].unit);
+		}
+	}
+	for (i = 0; i < stats->nhistograms; i++) {
+		const Histogram *histogram = &stats->histograms[i];
+		fprintf(file, "%20s: mean %.3f, max %ld (of %ld)\n", histogram->name,
+			histogram->n ? histogram->sum / histogram->n : 0, histogram->max,
+			histogram->n);
+	}
+	fprintf(file, "--- end stats ---\n");
+}
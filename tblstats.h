@@ -0,0 +1,83 @@
+/* * * * * * * * *
+ * Common statistics record filled in by every table type, with emitters for
+ * csv, json and plain text, so every type can be reported (and scraped) the
+ * same way
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * Fields that a table type does not track (or that do not apply to it, like
+ * kicks in a linear probing table) are set to UNTRACKED, and come out as an
+ * empty csv column, json null, or are left out of the text.
+ */
+
+#ifndef TBLSTATS_H
+#define TBLSTATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "histogram.h"
+
+// value of a field a table does not track
+#define UNTRACKED -1
+
+// most histograms a single table reports
+#define MAX_HISTOGRAMS 4
+
+typedef struct hash_table_stats {
+	const char *type;		// name of the table type
+	long size;				// slots, or directory entries for extendible types
+	long nkeys;				// keys currently stored
+	long nbuckets;			// distinct buckets (extendible types)
+	long bucketsize;		// keys per bucket
+	double load_factor;		// keys / key capacity
+	long collisions;		// inserts that could not use their first slot
+	double probe_length;	// average probe length of inserts
+	long resizes;			// times the table (or its directory) has grown
+	long kicks;				// keys evicted to make room for another (cuckoo)
+	long splits;			// buckets split to make room (extendible)
+	long filtered;			// lookups answered by the filter (see filter.h)
+	double insert_time;		// cpu time spent inserting [ms]
+	double lookup_time;		// cpu time spent looking up [ms]
+	long memory;			// heap memory held [bytes]
+	long peak_memory;		// most heap memory ever held [bytes]
+	double memory_per_key;	// memory / nkeys [bytes]
+
+	// distributions of per-operation quantities (probe lengths, kicks, ...)
+	int nhistograms;
+	Histogram histograms[MAX_HISTOGRAMS];
+} HashTableStats;
+
+// mark every field of 'stats' untracked, ready to be filled in by a table
+void init_hash_table_stats(HashTableStats *stats);
+
+// add a copy of 'histogram' to those reported in 'stats'
+void add_stats_histogram(HashTableStats *stats, const Histogram *histogram);
+
+// derive memory_per_key from memory and nkeys, if both are known
+void finish_hash_table_stats(HashTableStats *stats);
+
+// write the csv header matching fprint_stats_csv to 'file'
+void fprint_stats_csv_header(FILE *file);
+
+// write 'stats' as one csv row to 'file'
+void fprint_stats_csv(FILE *file, const HashTableStats *stats);
+
+// write the csv header matching fprint_histograms_csv to 'file'
+void fprint_histograms_csv_header(FILE *file);
+
+// write one csv row per non-empty histogram bin in 'stats' to 'file'
+void fprint_histograms_csv(FILE *file, const HashTableStats *stats);
+
+// write 'stats' (histograms included) as one json object on a single line
+// to 'file'
+void fprint_stats_json(FILE *file, const HashTableStats *stats);
+
+// write the tracked fields of 'stats', and a summary of each histogram, in
+// the text format of the 's' command
+void fprint_stats_text(FILE *file, const HashTableStats *stats);
+
+#endif
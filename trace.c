@@ -0,0 +1,159 @@
+/* * * * * * * * *
+ * Module for tracing structural changes to tables (doublings, upsizes and
+ * bucket splits) as a stream of timestamped events, so that latency spikes
+ * can be matched with the resize that caused them
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ */
+
+#define _POSIX_C_SOURCE 200809L	// for clock_gettime
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+#define TRACE_MAGIC "HTTRACE"
+#define TRACE_VERSION 1
+#define TRACE_EVENT_LEN 41
+
+// the ring buffer: event i (counting from the first) is at i % capacity
+static TraceEvent *events = NULL;
+static size_t capacity = 0;
+static uint64_t nrecorded = 0;	// events recorded since tracing started
+
+bool trace_start(size_t size) {
+	trace_stop();
+	if (size == 0) {
+		return false;
+	}
+	events = malloc(sizeof *events * size);
+	if (!events) {
+		return false;
+	}
+	capacity = size;
+	return true;
+}
+
+void trace_stop(void) {
+	free(events);
+	events = NULL;
+	capacity = 0;
+	nrecorded = 0;
+}
+
+uint64_t trace_clock(void) {
+	if (!events) {
+		return 0;
+	}
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void trace_record(TraceKind kind, uint64_t start, int64_t before,
+		int64_t after, int64_t moved) {
+	if (!events) {
+		return;
+	}
+	TraceEvent *event = &events[nrecorded++ % capacity];
+	event->start = start;
+	event->elapsed = trace_clock() - start;
+	event->before = before;
+	event->after = after;
+	event->moved = moved;
+	event->kind = kind;
+}
+
+const char *trace_kind_name(TraceKind kind) {
+	switch (kind) {
+		case TRACE_LINEAR_DOUBLE:
+			return "linear double";
+		case TRACE_CUCKOO_UPSIZE:
+			return "cuckoo upsize";
+		case TRACE_XTNDBL1_DOUBLE:
+			return "xtndbl1 double";
+		case TRACE_XTNDBL1_SPLIT:
+			return "xtndbl1 split";
+		case TRACE_XTNDBLN_DOUBLE:
+			return "xtndbln double";
+		case TRACE_XTNDBLN_SPLIT:
+			return "xtndbln split";
+		case TRACE_LINEAR_RESERVE:
+			return "linear reserve";
+		case TRACE_HOPSCOTCH_DOUBLE:
+			return "hopscotch double";
+		case TRACE_HOPSCOTCH_RESERVE:
+			return "hopscotch reserve";
+		case TRACE_LINHASH_SPLIT:
+			return "linhash split";
+		default:
+			return "unknown";
+	}
+}
+
+// number of events held, and the position of the oldest
+static size_t held(size_t *first) {
+	if (nrecorded > capacity) {
+		*first = nrecorded % capacity;
+		return capacity;
+	}
+	*first = 0;
+	return nrecorded;
+}
+
+void trace_print_csv(FILE *file) {
+	size_t i, first, n = held(&first);
+	fprintf(file, "event,start [ns],elapsed [ns],before,after,moved [keys]\n");
+	for (i = 0; i < n; i++) {
+		TraceEvent *event = &events[(first + i) % capacity];
+		fprintf(file, "%s,%llu,%llu,%lld,%lld,%lld\n",
+			trace_kind_name(event->kind),
+			(unsigned long long)event->start,
+			(unsigned long long)event->elapsed,
+			(long long)event->before, (long long)event->after,
+			(long long)event->moved);
+	}
+}
+
+// store 'value' in the 'len' bytes at 'bytes', least significant first
+static unsigned char *put_le(unsigned char *bytes, uint64_t value, int len) {
+	int i;
+	for (i = 0; i < len; i++) {
+		*bytes++ = (unsigned char)(value >> (8 * i));
+	}
+	return bytes;
+}
+
+bool trace_dump(FILE *file) {
+	size_t i, first, n = held(&first);
+	unsigned char header[32], record[TRACE_EVENT_LEN], *p;
+
+	memcpy(header, TRACE_MAGIC, 8);
+	p = put_le(header + 8, TRACE_VERSION, 4);
+	p = put_le(p, TRACE_EVENT_LEN, 4);
+	p = put_le(p, n, 8);
+	put_le(p, nrecorded - n, 8);
+	if (fwrite(header, sizeof header, 1, file) != 1) {
+		return false;
+	}
+
+	for (i = 0; i < n; i++) {
+		TraceEvent *event = &events[(first + i) % capacity];
+		p = put_le(record, event->start, 8);
+		p = put_le(p, event->elapsed, 8);
+		p = put_le(p, (uint64_t)event->before, 8);
+		p = put_le(p, (uint64_t)event->after, 8);
+		p = put_le(p, (uint64_t)event->moved, 8);
+		put_le(p, event->kind, 1);
+		if (fwrite(record, sizeof record, 1, file) != 1) {
+			return false;
+		}
+	}
+	return fflush(file) == 0;
+}
@@ -0,0 +1,85 @@
+/* * * * * * * * *
+ * Module for tracing structural changes to tables (doublings, upsizes and
+ * bucket splits) as a stream of timestamped events, so that latency spikes
+ * can be matched with the resize that caused them
+ *
+ * 14/05/17
+ * Ben Tomlin
+ * SN: 834198
+ * btomlin@student.unimelb.edu.au
+ *
+ * Events go into a ring buffer allocated by trace_start, so recording never
+ * allocates; once full, the oldest events are overwritten. While tracing is
+ * off, recording does nothing. Events are held in the order they finish, so a
+ * split that had to double the directory comes after that doubling.
+ *
+ * Binary dump format (all integers little-endian):
+ *   header:  "HTTRACE" and a NUL byte, le32 version (1), le32 event size (41),
+ *            le64 events in the dump, le64 older events overwritten
+ *   events:  oldest first, each le64 start [ns], le64 elapsed [ns],
+ *            le64 before, le64 after, le64 moved, u8 kind (TraceKind)
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// ring buffer size used by a2 -T
+#define TRACE_DEFAULT_EVENTS 65536
+
+// what changed. for doublings, upsizes and reserves 'before' and 'after' are
+// the table size in slots (directory entries for extendible types), for splits
+// they are the number of buckets
+typedef enum trace_kind {
+	TRACE_LINEAR_DOUBLE,
+	TRACE_CUCKOO_UPSIZE,
+	TRACE_XTNDBL1_DOUBLE,
+	TRACE_XTNDBL1_SPLIT,
+	TRACE_XTNDBLN_DOUBLE,
+	TRACE_XTNDBLN_SPLIT,
+	TRACE_LINEAR_RESERVE,
+	TRACE_HOPSCOTCH_DOUBLE,
+	TRACE_HOPSCOTCH_RESERVE,
+	TRACE_LINHASH_SPLIT,
+	TRACE_NKINDS
+} TraceKind;
+
+typedef struct trace_event {
+	uint64_t start;		// monotonic clock when the change began [ns]
+	uint64_t elapsed;	// how long it took [ns]
+	int64_t before;		// size before the change (see TraceKind)
+	int64_t after;		// size after the change
+	int64_t moved;		// keys that changed slot or bucket
+	TraceKind kind;
+} TraceEvent;
+
+// start tracing into a ring buffer of 'capacity' events, discarding any
+// events recorded before. returns false if the buffer cannot be allocated
+bool trace_start(size_t capacity);
+
+// stop tracing and free the ring buffer
+void trace_stop(void);
+
+// the monotonic clock in ns, to pass to trace_record as 'start'. 0 (without
+// reading the clock) when tracing is off
+uint64_t trace_clock(void);
+
+// record an event that began at 'start' (from trace_clock) and ends now
+void trace_record(TraceKind kind, uint64_t start, int64_t before,
+	int64_t after, int64_t moved);
+
+// short name of a kind of event, eg. "cuckoo upsize"
+const char *trace_kind_name(TraceKind kind);
+
+// print the events held, oldest first, as csv with a header
+void trace_print_csv(FILE *file);
+
+// write the events held, oldest first, in the binary format above. returns
+// false if writing fails
+bool trace_dump(FILE *file);
+
+#endif